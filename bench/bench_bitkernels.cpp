@@ -0,0 +1,107 @@
+//Throughput of the bulk bitwise kernels in bitkernels.h for every SIMD level that the CPU supports.
+//Usage: bench_bitkernels [bytes ...]
+//Without arguments, a buffer that fits into L1 (16 KiB) and one that is bound by memory bandwidth (64 MiB) are used.
+//GB/s count all bytes a kernel reads and writes, e.g. 3 * len for xor (dst and src read, dst written).
+
+#include "ENCRYPTO_utils/bitkernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+struct kernel {
+	const char* name;
+	//number of len byte streams that are read or written
+	uint32_t streams;
+	std::function<void(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len)> run;
+};
+
+volatile std::size_t sink;
+
+const std::vector<kernel> kernels = {
+	{"xor", 3, [] (BYTE* dst, const BYTE* a, const BYTE*, std::size_t len) { xor_bytes(dst, a, len); }},
+	{"and", 3, [] (BYTE* dst, const BYTE* a, const BYTE*, std::size_t len) { and_bytes(dst, a, len); }},
+	{"or", 3, [] (BYTE* dst, const BYTE* a, const BYTE*, std::size_t len) { or_bytes(dst, a, len); }},
+	{"setxor", 3, [] (BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len) { set_xor_bytes(dst, a, b, len); }},
+	{"setand", 3, [] (BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len) { set_and_bytes(dst, a, b, len); }},
+	{"setor", 3, [] (BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len) { set_or_bytes(dst, a, b, len); }},
+	{"invert", 2, [] (BYTE* dst, const BYTE*, const BYTE*, std::size_t len) { invert_bytes(dst, len); }},
+	{"equal", 2, [] (BYTE*, const BYTE* a, const BYTE* b, std::size_t len) { sink = sink + equal_bytes(a, b, len); }},
+	{"popcount", 1, [] (BYTE*, const BYTE* a, const BYTE*, std::size_t len) { sink = sink + popcount_bytes(a, len); }},
+	{"hamming", 2, [] (BYTE*, const BYTE* a, const BYTE* b, std::size_t len) { sink = sink + hamming_bytes(a, b, len); }},
+};
+
+const char* level_name(simd_level level) {
+	switch(level) {
+	case simd_level::avx2:
+		return "avx2";
+	case simd_level::avx512:
+		return "avx512";
+	default:
+		return "scalar";
+	}
+}
+
+double gbps(const kernel& k, std::vector<BYTE>& dst, const std::vector<BYTE>& a, const std::vector<BYTE>& b) {
+	std::size_t len = dst.size();
+	//about 1 GB of traffic per measurement, at least 3 calls
+	uint64_t rounds = std::max<uint64_t>((uint64_t(1) << 30) / (k.streams * len), 3);
+	k.run(dst.data(), a.data(), b.data(), len);
+	auto start = bench_clock::now();
+	for(uint64_t i = 0; i < rounds; i++) {
+		k.run(dst.data(), a.data(), b.data(), len);
+	}
+	std::chrono::duration<double, std::nano> elapsed = bench_clock::now() - start;
+	return (double) k.streams * len * rounds / elapsed.count();
+}
+
+}
+
+int main(int argc, char** argv) {
+	std::vector<std::size_t> sizes;
+	for(int i = 1; i < argc; i++) {
+		sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+	}
+	if(sizes.empty()) {
+		sizes = {16 << 10, 64 << 20};
+	}
+	std::vector<simd_level> levels;
+	for(simd_level level : {simd_level::scalar, simd_level::avx2, simd_level::avx512}) {
+		if(level <= get_max_simd_level()) {
+			levels.push_back(level);
+		}
+	}
+
+	simd_level default_level = get_simd_level();
+	for(std::size_t len : sizes) {
+		std::vector<BYTE> dst(len), a(len), b(len);
+		for(std::size_t i = 0; i < len; i++) {
+			a[i] = (BYTE) (i * 31 + 7);
+			b[i] = a[i];
+		}
+		std::printf("GB/s at %lu bytes\n%10s", (unsigned long) len, "kernel");
+		for(simd_level level : levels) {
+			std::printf("  %8s", level_name(level));
+		}
+		std::printf("\n");
+		for(const kernel& k : kernels) {
+			std::printf("%10s", k.name);
+			for(simd_level level : levels) {
+				set_simd_level(level);
+				std::printf("  %8.1f", gbps(k, dst, a, b));
+				std::fflush(stdout);
+			}
+			std::printf("\n");
+		}
+		std::printf("\n");
+	}
+	set_simd_level(default_level);
+	return 0;
+}
@@ -0,0 +1,138 @@
+//Ping-pong latency of CEvent for a range of spin counts, used to tune the spin budget in thread.cpp.
+//Usage: bench_event [rounds] [cpu_ping cpu_pong]
+//A round trip is one Set()/Wait() handoff in each direction. The responder can busy-wait for a delay before it
+//answers, which models the time a protocol computes before it sends the next message. Spinning pays off if the
+//delay is shorter than the spin window and only burns CPU time otherwise.
+
+#include "ENCRYPTO_utils/thread.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <immintrin.h>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+void busy_wait(std::chrono::nanoseconds delay) {
+	if(delay.count() == 0) {
+		return;
+	}
+	auto end = bench_clock::now() + delay;
+	while(bench_clock::now() < end) {
+	}
+}
+
+//Answers every ping after the delay
+class pong_thread : public CThread {
+public:
+	pong_thread(CEvent& ping, CEvent& pong, uint64_t rounds, std::chrono::nanoseconds delay)
+		: m_ePing(ping), m_ePong(pong), m_nRounds(rounds), m_nDelay(delay) {}
+	~pong_thread() {
+		Wait();
+	}
+
+protected:
+	void ThreadMain() {
+		for(uint64_t i = 0; i < m_nRounds; i++) {
+			m_ePing.Wait();
+			busy_wait(m_nDelay);
+			m_ePong.Set();
+		}
+	}
+
+private:
+	CEvent& m_ePing;
+	CEvent& m_ePong;
+	uint64_t m_nRounds;
+	std::chrono::nanoseconds m_nDelay;
+};
+
+//Sends the pings and measures the round trips
+class ping_thread : public CThread {
+public:
+	ping_thread(CEvent& ping, CEvent& pong, uint64_t rounds)
+		: m_ePing(ping), m_ePong(pong), m_nRounds(rounds) {}
+	~ping_thread() {
+		Wait();
+	}
+
+	double us_per_round = 0;
+
+protected:
+	void ThreadMain() {
+		auto start = bench_clock::now();
+		for(uint64_t i = 0; i < m_nRounds; i++) {
+			m_ePing.Set();
+			m_ePong.Wait();
+		}
+		std::chrono::duration<double, std::micro> elapsed = bench_clock::now() - start;
+		us_per_round = elapsed.count() / m_nRounds;
+	}
+
+private:
+	CEvent& m_ePing;
+	CEvent& m_ePong;
+	uint64_t m_nRounds;
+};
+
+double ping_pong(uint64_t rounds, std::chrono::nanoseconds delay, const std::vector<int>& cpus) {
+	CEvent ping, pong;
+	ping_thread pinger(ping, pong, rounds);
+	pong_thread ponger(ping, pong, rounds, delay);
+	if(cpus.size() == 2) {
+		pinger.SetAffinity({cpus[0]});
+		ponger.SetAffinity({cpus[1]});
+	}
+	ponger.Start();
+	pinger.Start();
+	pinger.Wait();
+	ponger.Wait();
+	return pinger.us_per_round;
+}
+
+double ns_per_pause() {
+	const int npause = 1 << 16;
+	auto start = bench_clock::now();
+	for(int i = 0; i < npause; i++) {
+		_mm_pause();
+	}
+	std::chrono::duration<double, std::nano> elapsed = bench_clock::now() - start;
+	return elapsed.count() / npause;
+}
+
+}
+
+int main(int argc, char** argv) {
+	uint64_t rounds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+	std::vector<int> cpus;
+	if(argc > 3) {
+		cpus = {std::atoi(argv[2]), std::atoi(argv[3])};
+	}
+	const uint32_t spins[] = {0, 16, 64, 256, 1024, 4096};
+	const uint32_t delays_ns[] = {0, 1000, 5000, 20000};
+
+	std::printf("%.1f ns per pause, default spin count %u\n", ns_per_pause(), CEvent::GetSpinCount());
+	std::printf("us per round trip, %lu rounds\n%10s", (unsigned long) rounds, "spin");
+	for(uint32_t delay : delays_ns) {
+		std::printf("  delay %5uns", delay);
+	}
+	std::printf("\n");
+
+	uint32_t default_spin = CEvent::GetSpinCount();
+	for(uint32_t spin : spins) {
+		CEvent::SetSpinCount(spin);
+		std::printf("%10u", spin);
+		for(uint32_t delay : delays_ns) {
+			//fewer rounds for long delays, which are dominated by the delay anyway
+			uint64_t n = delay >= 5000 ? rounds / 10 : rounds;
+			std::printf("  %13.2f", ping_pong(n, std::chrono::nanoseconds(delay), cpus));
+			std::fflush(stdout);
+		}
+		std::printf("\n");
+	}
+	CEvent::SetSpinCount(default_spin);
+	return 0;
+}
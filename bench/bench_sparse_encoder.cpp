@@ -0,0 +1,53 @@
+//Time of SparseGF2Encoder::Encode() on bits and of EncodeRows() on rows of rowbytes bytes.
+//Usage: bench_sparse_encoder [inlen outlen weight rowbytes nthreads rounds]
+//The defaults are inlen 2^20, outlen 2^24, weight 10, 16 byte rows (OT blocks) and one thread, 0 threads uses all
+//hardware threads. The inputs are random, the encoder is set up outside of the timed part.
+
+#include "ENCRYPTO_utils/cbitvector.h"
+#include "ENCRYPTO_utils/constants.h"
+#include "ENCRYPTO_utils/crypto/crypto.h"
+#include "ENCRYPTO_utils/sparse_encoder.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+double ms_per_call(uint64_t rounds, const std::function<void()>& encode) {
+	//the first call allocates the output
+	encode();
+	auto start = bench_clock::now();
+	for(uint64_t i = 0; i < rounds; i++) {
+		encode();
+	}
+	std::chrono::duration<double, std::milli> elapsed = bench_clock::now() - start;
+	return elapsed.count() / rounds;
+}
+
+}
+
+int main(int argc, char** argv) {
+	std::size_t inlen = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 20;
+	std::size_t outlen = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1 << 24;
+	std::size_t weight = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 10;
+	std::size_t rowbytes = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 16;
+	uint32_t nthreads = argc > 5 ? std::atoi(argv[5]) : 1;
+	uint64_t rounds = argc > 6 ? std::strtoull(argv[6], nullptr, 10) : 3;
+
+	uint8_t seed[AES_BYTES] = {1}, matrix_seed[AES_BYTES] = {2};
+	crypto crypt(128, seed);
+	SparseGF2Encoder enc(inlen, outlen, weight, &crypt, matrix_seed);
+	CBitVector x(inlen, &crypt), rows(inlen * rowbytes * 8, &crypt), y, yrows;
+
+	std::printf("inlen %lu, outlen %lu, weight %lu, %u threads, ms per call over %lu rounds\n", (unsigned long) inlen,
+			(unsigned long) outlen, (unsigned long) weight, nthreads, (unsigned long) rounds);
+	std::printf("%-12s  %10.1f\n", "Encode", ms_per_call(rounds, [&] { enc.Encode(y, x, nthreads); }));
+	std::fflush(stdout);
+	std::printf("%-12s  %10.1f  (%lu byte rows)\n", "EncodeRows",
+			ms_per_call(rounds, [&] { enc.EncodeRows(yrows, rows, rowbytes, nthreads); }), (unsigned long) rowbytes);
+	return 0;
+}
@@ -0,0 +1,83 @@
+//Time per bit-matrix transposition of Eklundh's algorithm and of the tiled SIMD transposition at every SIMD level that
+//the CPU supports, i.e., the choices of CBitVector::Transpose() with and without EKLUNDH_TRANSPOSE in constants.h.
+//Usage: bench_transpose [rounds] [nthreads]
+//nthreads only applies to the tiled transposition, 0 uses all hardware threads.
+
+#include "ENCRYPTO_utils/bitkernels.h"
+#include "ENCRYPTO_utils/cbitvector.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+const char* level_name(simd_level level) {
+	switch(level) {
+	case simd_level::avx2:
+		return "avx2";
+	case simd_level::avx512:
+		return "avx512";
+	default:
+		return "scalar";
+	}
+}
+
+//Average ms of transpose on a fresh copy of src, the copies are not timed
+double ms_per_call(const CBitVector& src, CBitVector& vec, uint64_t rounds, const std::function<void()>& transpose) {
+	double total = 0;
+	for(uint64_t i = 0; i < rounds; i++) {
+		memcpy(vec.GetArr(), src.GetArr(), src.GetSize());
+		auto start = bench_clock::now();
+		transpose();
+		std::chrono::duration<double, std::milli> elapsed = bench_clock::now() - start;
+		total += elapsed.count();
+	}
+	return total / rounds;
+}
+
+}
+
+int main(int argc, char** argv) {
+	uint64_t rounds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20;
+	uint32_t nthreads = argc > 2 ? std::atoi(argv[2]) : 1;
+	const std::size_t shapes[][2] = {{128, 65536}, {65536, 128}, {1024, 1024}, {4096, 4096}};
+	std::vector<simd_level> levels;
+	for(simd_level level : {simd_level::scalar, simd_level::avx2, simd_level::avx512}) {
+		if(level <= get_max_simd_level()) {
+			levels.push_back(level);
+		}
+	}
+
+	std::printf("ms per call, %lu rounds, %u threads for the tiled transposition\n%14s  %8s", (unsigned long) rounds,
+			nthreads, "shape", "eklundh");
+	for(simd_level level : levels) {
+		std::printf("  %8s", level_name(level));
+	}
+	std::printf("\n");
+
+	simd_level default_level = get_simd_level();
+	for(const auto& shape : shapes) {
+		std::size_t rows = shape[0], columns = shape[1];
+		CBitVector src(rows * columns), vec(rows * columns);
+		for(std::size_t i = 0; i < src.GetSize(); i++) {
+			src.GetArr()[i] = (BYTE) (i * 131 + (i >> 8) * 7 + 3);
+		}
+		std::printf("%6lu x %5lu", (unsigned long) rows, (unsigned long) columns);
+		std::printf("  %8.3f", ms_per_call(src, vec, rounds, [&] { vec.EklundhBitTranspose(rows, columns); }));
+		std::fflush(stdout);
+		for(simd_level level : levels) {
+			set_simd_level(level);
+			std::printf("  %8.3f", ms_per_call(src, vec, rounds, [&] { vec.TiledTranspose(rows, columns, nthreads); }));
+			std::fflush(stdout);
+		}
+		std::printf("\n");
+	}
+	set_simd_level(default_level);
+	return 0;
+}
@@ -0,0 +1,1576 @@
+/**
+ \file 		bitkernels.cpp
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Bulk bitwise kernels on byte arrays with runtime SIMD dispatch
+ */
+
+#include "bitkernels.h"
+#include "thread.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BITKERNELS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+
+namespace {
+
+enum class arith_op {
+	add, sub, mul
+};
+
+struct kernel_table {
+	void (*xor_bytes)(BYTE*, const BYTE*, std::size_t);
+	void (*and_bytes)(BYTE*, const BYTE*, std::size_t);
+	void (*set_xor_bytes)(BYTE*, const BYTE*, const BYTE*, std::size_t);
+	void (*set_and_bytes)(BYTE*, const BYTE*, const BYTE*, std::size_t);
+	void (*or_bytes)(BYTE*, const BYTE*, std::size_t);
+	void (*set_or_bytes)(BYTE*, const BYTE*, const BYTE*, std::size_t);
+	void (*invert_bytes)(BYTE*, std::size_t);
+	bool (*equal_bytes)(const BYTE*, const BYTE*, std::size_t);
+	void (*funnel_copy)(BYTE*, const BYTE*, unsigned, std::size_t);
+	void (*funnel_xor)(BYTE*, const BYTE*, unsigned, std::size_t);
+	void (*transpose)(BYTE*, std::size_t, const BYTE*, std::size_t, std::size_t, std::size_t);
+	void (*transpose64)(uint64_t*, const uint64_t*);
+	std::size_t (*popcount)(const BYTE*, std::size_t);
+	std::size_t (*hamming)(const BYTE*, const BYTE*, std::size_t);
+	void (*unpack)(void*, std::size_t, const BYTE*, std::size_t, std::size_t, std::size_t);
+	void (*pack)(BYTE*, std::size_t, const void*, std::size_t, std::size_t, std::size_t);
+	void (*xor_rows)(BYTE*, std::size_t, const BYTE*, std::size_t, const uint32_t*, std::size_t);
+	void (*arith)(arith_op, BYTE*, const BYTE*, const BYTE*, uint64_t, std::size_t, std::size_t);
+};
+
+//Portable kernels on REGSIZE words with a bytewise tail, memcpy keeps unaligned accesses well-defined
+inline REGSIZE load_word(const BYTE* p) {
+	REGSIZE w;
+	memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+inline void store_word(BYTE* p, REGSIZE w) {
+	memcpy(p, &w, sizeof(w));
+}
+
+void xor_bytes_scalar(BYTE* dst, const BYTE* src, std::size_t len) {
+	std::size_t i = 0;
+	for (; i + sizeof(REGSIZE) <= len; i += sizeof(REGSIZE)) {
+		store_word(dst + i, load_word(dst + i) ^ load_word(src + i));
+	}
+	for (; i < len; i++) {
+		dst[i] ^= src[i];
+	}
+}
+
+void and_bytes_scalar(BYTE* dst, const BYTE* src, std::size_t len) {
+	std::size_t i = 0;
+	for (; i + sizeof(REGSIZE) <= len; i += sizeof(REGSIZE)) {
+		store_word(dst + i, load_word(dst + i) & load_word(src + i));
+	}
+	for (; i < len; i++) {
+		dst[i] &= src[i];
+	}
+}
+
+void set_xor_bytes_scalar(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len) {
+	std::size_t i = 0;
+	for (; i + sizeof(REGSIZE) <= len; i += sizeof(REGSIZE)) {
+		store_word(dst + i, load_word(a + i) ^ load_word(b + i));
+	}
+	for (; i < len; i++) {
+		dst[i] = a[i] ^ b[i];
+	}
+}
+
+void set_and_bytes_scalar(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len) {
+	std::size_t i = 0;
+	for (; i + sizeof(REGSIZE) <= len; i += sizeof(REGSIZE)) {
+		store_word(dst + i, load_word(a + i) & load_word(b + i));
+	}
+	for (; i < len; i++) {
+		dst[i] = a[i] & b[i];
+	}
+}
+
+void or_bytes_scalar(BYTE* dst, const BYTE* src, std::size_t len) {
+	std::size_t i = 0;
+	for (; i + sizeof(REGSIZE) <= len; i += sizeof(REGSIZE)) {
+		store_word(dst + i, load_word(dst + i) | load_word(src + i));
+	}
+	for (; i < len; i++) {
+		dst[i] |= src[i];
+	}
+}
+
+void set_or_bytes_scalar(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len) {
+	std::size_t i = 0;
+	for (; i + sizeof(REGSIZE) <= len; i += sizeof(REGSIZE)) {
+		store_word(dst + i, load_word(a + i) | load_word(b + i));
+	}
+	for (; i < len; i++) {
+		dst[i] = a[i] | b[i];
+	}
+}
+
+void invert_bytes_scalar(BYTE* dst, std::size_t len) {
+	std::size_t i = 0;
+	for (; i + sizeof(REGSIZE) <= len; i += sizeof(REGSIZE)) {
+		store_word(dst + i, ~load_word(dst + i));
+	}
+	for (; i < len; i++) {
+		dst[i] = ~dst[i];
+	}
+}
+
+//memcmp of glibc is already vectorized and faster than a plain SIMD loop, hence it is used on all levels
+bool equal_bytes_scalar(const BYTE* a, const BYTE* b, std::size_t len) {
+	return memcmp(a, b, len) == 0;
+}
+
+/*
+	Funnel shift kernels: word i of dst is set to (or XORed with) the 64 bits of src that start at bit off of byte 8*i,
+	for 0 < off < 8. The word is combined from the loads at byte 8*i and 8*i+1, hence only the src bytes
+	[0, 8*nwords] are read.
+*/
+template<bool XOR> inline void funnel_scalar(BYTE* dst, const BYTE* src, unsigned off, std::size_t nwords) {
+	for (std::size_t i = 0; i < nwords; i++) {
+		REGSIZE w = (load_word(src + 8 * i) >> off) | (load_word(src + 8 * i + 1) << (8 - off));
+		if (XOR) {
+			w ^= load_word(dst + 8 * i);
+		}
+		store_word(dst + 8 * i, w);
+	}
+}
+
+void funnel_copy_scalar(BYTE* dst, const BYTE* src, unsigned off, std::size_t nwords) {
+	funnel_scalar<false>(dst, src, off, nwords);
+}
+
+void funnel_xor_scalar(BYTE* dst, const BYTE* src, unsigned off, std::size_t nwords) {
+	funnel_scalar<true>(dst, src, off, nwords);
+}
+
+/*
+	Transpose kernels for bit matrices in GetBit() order, i.e., column j of a row is bit 7-(j%8) of byte j/8.
+	A block kernel transposes a block of rows x 64 columns: src points to the first of the 8 bytes in the first row
+	of the block, dst to the byte of the first row of the block in the first output row.
+*/
+//8 x 8 block, the rows are loaded in reverse byte order such that the LSB-first delta swaps apply
+inline void transpose_8x8(BYTE* dst, std::size_t dststride, const BYTE* src, std::size_t srcstride) {
+	uint64_t x = 0;
+	for (std::size_t k = 0; k < 8; k++) {
+		x |= ((uint64_t) src[k * srcstride]) << (8 * (7 - k));
+	}
+	uint64_t t;
+	t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+	x ^= t ^ (t << 28);
+	for (std::size_t j = 0; j < 8; j++) {
+		dst[j * dststride] = x >> (8 * (7 - j));
+	}
+}
+
+inline void transpose_8x64(BYTE* dst, std::size_t dststride, const BYTE* src, std::size_t srcstride) {
+	for (std::size_t j = 0; j < 8; j++) {
+		transpose_8x8(dst + 8 * j * dststride, dststride, src + j, srcstride);
+	}
+}
+
+//Transpose the rows x columns region of src with a row stride of srcstride bytes into dst, all blocks of BLOCKROWS x 64
+//with kernel, the remaining rows and columns with 8 x 8 blocks
+template<std::size_t BLOCKROWS, void (*kernel)(BYTE*, std::size_t, const BYTE*, std::size_t)>
+void transpose_blocks(BYTE* dst, std::size_t dststride, const BYTE* src, std::size_t srcstride, std::size_t rows,
+		std::size_t columns) {
+	std::size_t colbytes = columns / 8;
+	std::size_t r = 0;
+	for (; r + BLOCKROWS <= rows; r += BLOCKROWS) {
+		std::size_t cb = 0;
+		for (; cb + 8 <= colbytes; cb += 8) {
+			kernel(dst + 8 * cb * dststride + r / 8, dststride, src + r * srcstride + cb, srcstride);
+		}
+		for (; cb < colbytes; cb++) {
+			for (std::size_t rr = r; rr < r + BLOCKROWS; rr += 8) {
+				transpose_8x8(dst + 8 * cb * dststride + rr / 8, dststride, src + rr * srcstride + cb, srcstride);
+			}
+		}
+	}
+	for (; r < rows; r += 8) {
+		for (std::size_t cb = 0; cb < colbytes; cb++) {
+			transpose_8x8(dst + 8 * cb * dststride + r / 8, dststride, src + r * srcstride + cb, srcstride);
+		}
+	}
+}
+
+void transpose_scalar(BYTE* dst, std::size_t dststride, const BYTE* src, std::size_t srcstride, std::size_t rows,
+		std::size_t columns) {
+	transpose_blocks<8, transpose_8x64>(dst, dststride, src, srcstride, rows, columns);
+}
+
+/*
+	Transpose kernels for 64 x 64 bit matrices in GetBitNoMask() order, i.e., bit c of dst[r] is bit r of src[c]. The
+	scalar kernel swaps the off-diagonal j x j blocks of all 2j x 2j blocks for j = 32, 16, ..., 1.
+*/
+void transpose64_scalar(uint64_t* dst, const uint64_t* src) {
+	memcpy(dst, src, 64 * sizeof(uint64_t));
+	uint64_t m = 0x00000000FFFFFFFFULL;
+	for (std::size_t j = 32; j > 0; j >>= 1, m ^= m << j) {
+		for (std::size_t k = 0; k < 64; k = (k + j + 1) & ~j) {
+			uint64_t t = ((dst[k] >> j) ^ dst[k + j]) & m;
+			dst[k] ^= t << j;
+			dst[k + j] ^= t;
+		}
+	}
+}
+
+/*
+	XOR of the rows idx[0], ..., idx[n-1] of a matrix with a row stride of stride bytes onto the len bytes of dst. The
+	rows are added strip by strip, such that the sum of a strip stays in registers.
+*/
+void xor_rows_scalar(BYTE* dst, std::size_t len, const BYTE* rows, std::size_t stride, const uint32_t* idx,
+		std::size_t n) {
+	std::size_t i = 0;
+	for (; i + 4 * sizeof(REGSIZE) <= len; i += 4 * sizeof(REGSIZE)) {
+		REGSIZE a0 = load_word(dst + i), a1 = load_word(dst + i + sizeof(REGSIZE));
+		REGSIZE a2 = load_word(dst + i + 2 * sizeof(REGSIZE)), a3 = load_word(dst + i + 3 * sizeof(REGSIZE));
+		for (std::size_t k = 0; k < n; k++) {
+			const BYTE* row = rows + idx[k] * stride + i;
+			a0 ^= load_word(row);
+			a1 ^= load_word(row + sizeof(REGSIZE));
+			a2 ^= load_word(row + 2 * sizeof(REGSIZE));
+			a3 ^= load_word(row + 3 * sizeof(REGSIZE));
+		}
+		store_word(dst + i, a0);
+		store_word(dst + i + sizeof(REGSIZE), a1);
+		store_word(dst + i + 2 * sizeof(REGSIZE), a2);
+		store_word(dst + i + 3 * sizeof(REGSIZE), a3);
+	}
+	for (; i < len; i++) {
+		BYTE a = dst[i];
+		for (std::size_t k = 0; k < n; k++) {
+			a ^= rows[idx[k] * stride + i];
+		}
+		dst[i] = a;
+	}
+}
+
+//Population count of a, or of a ^ b for the Hamming distance
+template<bool HAMMING> std::size_t popcount_scalar(const BYTE* a, const BYTE* b, std::size_t len) {
+	std::size_t count = 0;
+	std::size_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		REGSIZE w = load_word(a + i);
+		if (HAMMING) {
+			w ^= load_word(b + i);
+		}
+		count += __builtin_popcountll(w);
+	}
+	for (; i < len; i++) {
+		count += __builtin_popcount(HAMMING ? a[i] ^ b[i] : a[i]);
+	}
+	return count;
+}
+
+std::size_t popcount_bytes_scalar(const BYTE* p, std::size_t len) {
+	return popcount_scalar<false>(p, NULL, len);
+}
+
+std::size_t hamming_bytes_scalar(const BYTE* a, const BYTE* b, std::size_t len) {
+	return popcount_scalar<true>(a, b, len);
+}
+
+/*
+	Packed elements are read through unaligned 64-bit words. A word is only loaded if it ends within the bytes of the
+	elements, the last bytes are read individually.
+*/
+inline uint64_t load_u64(const void* p) {
+	uint64_t w;
+	memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+inline void store_u64(void* p, uint64_t w) {
+	memcpy(p, &w, sizeof(w));
+}
+
+inline uint64_t element_mask(std::size_t bitlen) {
+	return bitlen >= 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << bitlen) - 1;
+}
+
+//bitlen <= 64 bits of src from bit pos, bytes from end on are not accessed
+inline uint64_t load_element(const BYTE* src, std::size_t end, std::size_t pos, std::size_t bitlen) {
+	std::size_t b = pos >> 3;
+	unsigned s = pos & 0x07;
+	uint64_t w = 0;
+	if (b + sizeof(w) <= end) {
+		w = load_u64(src + b);
+	} else {
+		memcpy(&w, src + b, end - b);
+	}
+	w >>= s;
+	if (s + bitlen > 64) {
+		w |= (uint64_t) src[b + 8] << (64 - s);
+	}
+	return w & element_mask(bitlen);
+}
+
+//Appends bits to dst from bit pos on, the bits before pos in the first byte and after the end in the last byte are kept
+class bit_writer {
+public:
+	bit_writer(BYTE* dst, std::size_t pos) : m_pOut(dst + (pos >> 3)), m_nAcc(pos & 0x07) {
+		m_nWord = m_nAcc ? *m_pOut & ((1u << m_nAcc) - 1) : 0;
+	}
+
+	//v holds len <= 64 bits
+	void put(uint64_t v, std::size_t len) {
+		m_nWord |= v << m_nAcc;
+		m_nAcc += len;
+		if (m_nAcc >= 64) {
+			store_u64(m_pOut, m_nWord);
+			m_pOut += 8;
+			m_nAcc -= 64;
+			m_nWord = m_nAcc ? v >> (len - m_nAcc) : 0;
+		}
+	}
+
+	void finish() {
+		std::size_t full = m_nAcc >> 3;
+		memcpy(m_pOut, &m_nWord, full);
+		if (m_nAcc & 0x07) {
+			BYTE mask = (1u << (m_nAcc & 0x07)) - 1;
+			m_pOut[full] = (m_pOut[full] & ~mask) | ((m_nWord >> (full << 3)) & mask);
+		}
+	}
+
+private:
+	BYTE* m_pOut;
+	std::size_t m_nAcc;
+	uint64_t m_nWord;
+};
+
+template<class T> void unpack_scalar(void* dst, const BYTE* src, std::size_t pos, std::size_t bitlen, std::size_t n) {
+	T* out = (T*) dst;
+	std::size_t end = (pos + n * bitlen + 7) >> 3;
+	for (std::size_t i = 0; i < n; i++, pos += bitlen) {
+		out[i] = load_element(src, end, pos, bitlen);
+	}
+}
+
+template<class T> void pack_scalar(BYTE* dst, std::size_t pos, const void* src, std::size_t bitlen, std::size_t n) {
+	const T* in = (const T*) src;
+	uint64_t mask = element_mask(bitlen);
+	bit_writer w(dst, pos);
+	for (std::size_t i = 0; i < n; i++) {
+		w.put(in[i] & mask, bitlen);
+	}
+	w.finish();
+}
+
+//Instantiates kernel<T> for the element width in bytes
+#define ELEMENT_WIDTH_SWITCH(width, kernel, ...)		\
+	switch (width) {									\
+	case 1: kernel<uint8_t>(__VA_ARGS__); break;		\
+	case 2: kernel<uint16_t>(__VA_ARGS__); break;		\
+	case 4: kernel<uint32_t>(__VA_ARGS__); break;		\
+	default: kernel<uint64_t>(__VA_ARGS__); break;		\
+	}
+
+void unpack_bits_scalar(void* dst, std::size_t width, const BYTE* src, std::size_t pos, std::size_t bitlen, std::size_t n) {
+	ELEMENT_WIDTH_SWITCH(width, unpack_scalar, dst, src, pos, bitlen, n)
+}
+
+void pack_bits_scalar(BYTE* dst, std::size_t pos, const void* src, std::size_t width, std::size_t bitlen, std::size_t n) {
+	ELEMENT_WIDTH_SWITCH(width, pack_scalar, dst, pos, src, bitlen, n)
+}
+
+/*
+	Elementwise arithmetic on n integers T of sizeof(T) = width bytes, i.e., modulo 2^(8 * width). The second operand
+	is b or, if b is NULL, the scalar s. The same code serves integers and GCC vectors of integers.
+*/
+template<arith_op OP, class V> inline void arith(V& x, const V& y) {
+	if (OP == arith_op::add) {
+		x += y;
+	} else if (OP == arith_op::sub) {
+		x -= y;
+	} else {
+		x *= y;
+	}
+}
+
+template<class T, arith_op OP> void arith_scalar(BYTE* dst, const BYTE* a, const BYTE* b, uint64_t s, std::size_t n) {
+	typedef decltype((T) 0 + 0u) U; //small types are not promoted to int, which could overflow in a multiplication
+	T x, y = (T) s;
+	for (std::size_t i = 0; i < n * sizeof(T); i += sizeof(T)) {
+		memcpy(&x, a + i, sizeof(T));
+		if (b) {
+			memcpy(&y, b + i, sizeof(T));
+		}
+		U r = x;
+		arith<OP>(r, (U) y);
+		x = (T) r;
+		memcpy(dst + i, &x, sizeof(T));
+	}
+}
+
+//Kernel sets for arith_width(), K::run<T, OP> processes n elements
+struct scalar_arith {
+	template<class T, arith_op OP> static void run(BYTE* dst, const BYTE* a, const BYTE* b, uint64_t s, std::size_t n) {
+		arith_scalar<T, OP>(dst, a, b, s, n);
+	}
+};
+
+template<class T, class K> void arith_width(K, arith_op op, BYTE* dst, const BYTE* a, const BYTE* b, uint64_t s, std::size_t n) {
+	switch (op) {
+	case arith_op::add:
+		K::template run<T, arith_op::add>(dst, a, b, s, n);
+		break;
+	case arith_op::sub:
+		K::template run<T, arith_op::sub>(dst, a, b, s, n);
+		break;
+	default:
+		K::template run<T, arith_op::mul>(dst, a, b, s, n);
+		break;
+	}
+}
+
+template<class K> void arith_elements(arith_op op, BYTE* dst, const BYTE* a, const BYTE* b, uint64_t s, std::size_t width,
+		std::size_t n) {
+	ELEMENT_WIDTH_SWITCH(width, arith_width, K(), op, dst, a, b, s, n)
+}
+
+constexpr kernel_table SCALAR_KERNELS = { xor_bytes_scalar, and_bytes_scalar, set_xor_bytes_scalar,
+		set_and_bytes_scalar, or_bytes_scalar, set_or_bytes_scalar, invert_bytes_scalar, equal_bytes_scalar,
+		funnel_copy_scalar, funnel_xor_scalar, transpose_scalar, transpose64_scalar, popcount_bytes_scalar,
+		hamming_bytes_scalar, unpack_bits_scalar, pack_bits_scalar, xor_rows_scalar, arith_elements<scalar_arith> };
+
+#ifdef BITKERNELS_X86_SIMD
+
+//AVX2 kernels process two 32 byte vectors per iteration and leave the tail to the scalar kernels
+#define AVX2_BINARY_KERNEL(name, op)															\
+__attribute__((target("avx2"))) void name##_avx2(BYTE* dst, const BYTE* src, std::size_t len) {	\
+	std::size_t i = 0;																			\
+	for (; i + 64 <= len; i += 64) {															\
+		__m256i d0 = _mm256_loadu_si256((const __m256i*) (dst + i));							\
+		__m256i d1 = _mm256_loadu_si256((const __m256i*) (dst + i + 32));						\
+		__m256i s0 = _mm256_loadu_si256((const __m256i*) (src + i));							\
+		__m256i s1 = _mm256_loadu_si256((const __m256i*) (src + i + 32));						\
+		_mm256_storeu_si256((__m256i*) (dst + i), op(d0, s0));									\
+		_mm256_storeu_si256((__m256i*) (dst + i + 32), op(d1, s1));								\
+	}																							\
+	for (; i + 32 <= len; i += 32) {															\
+		__m256i d0 = _mm256_loadu_si256((const __m256i*) (dst + i));							\
+		__m256i s0 = _mm256_loadu_si256((const __m256i*) (src + i));							\
+		_mm256_storeu_si256((__m256i*) (dst + i), op(d0, s0));									\
+	}																							\
+	name##_scalar(dst + i, src + i, len - i);													\
+}
+
+#define AVX2_TERNARY_KERNEL(name, op)																	\
+__attribute__((target("avx2"))) void name##_avx2(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len) {	\
+	std::size_t i = 0;																					\
+	for (; i + 64 <= len; i += 64) {																	\
+		__m256i a0 = _mm256_loadu_si256((const __m256i*) (a + i));										\
+		__m256i a1 = _mm256_loadu_si256((const __m256i*) (a + i + 32));								\
+		__m256i b0 = _mm256_loadu_si256((const __m256i*) (b + i));										\
+		__m256i b1 = _mm256_loadu_si256((const __m256i*) (b + i + 32));								\
+		_mm256_storeu_si256((__m256i*) (dst + i), op(a0, b0));											\
+		_mm256_storeu_si256((__m256i*) (dst + i + 32), op(a1, b1));										\
+	}																									\
+	for (; i + 32 <= len; i += 32) {																	\
+		__m256i a0 = _mm256_loadu_si256((const __m256i*) (a + i));										\
+		__m256i b0 = _mm256_loadu_si256((const __m256i*) (b + i));										\
+		_mm256_storeu_si256((__m256i*) (dst + i), op(a0, b0));											\
+	}																									\
+	name##_scalar(dst + i, a + i, b + i, len - i);														\
+}
+
+AVX2_BINARY_KERNEL(xor_bytes, _mm256_xor_si256)
+AVX2_BINARY_KERNEL(and_bytes, _mm256_and_si256)
+AVX2_TERNARY_KERNEL(set_xor_bytes, _mm256_xor_si256)
+AVX2_TERNARY_KERNEL(set_and_bytes, _mm256_and_si256)
+AVX2_BINARY_KERNEL(or_bytes, _mm256_or_si256)
+AVX2_TERNARY_KERNEL(set_or_bytes, _mm256_or_si256)
+
+__attribute__((target("avx2"))) void invert_bytes_avx2(BYTE* dst, std::size_t len) {
+	const __m256i ones = _mm256_set1_epi8(-1);
+	std::size_t i = 0;
+	for (; i + 32 <= len; i += 32) {
+		__m256i d0 = _mm256_loadu_si256((const __m256i*) (dst + i));
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_xor_si256(d0, ones));
+	}
+	invert_bytes_scalar(dst + i, len - i);
+}
+
+template<bool XOR> __attribute__((target("avx2"))) void funnel_avx2(BYTE* dst, const BYTE* src, unsigned off, std::size_t nwords) {
+	const __m128i loshift = _mm_cvtsi32_si128(off);
+	const __m128i hishift = _mm_cvtsi32_si128(8 - off);
+	std::size_t i = 0;
+	for (; i + 4 <= nwords; i += 4) {
+		__m256i lo = _mm256_loadu_si256((const __m256i*) (src + 8 * i));
+		__m256i hi = _mm256_loadu_si256((const __m256i*) (src + 8 * i + 1));
+		__m256i w = _mm256_or_si256(_mm256_srl_epi64(lo, loshift), _mm256_sll_epi64(hi, hishift));
+		if (XOR) {
+			w = _mm256_xor_si256(w, _mm256_loadu_si256((const __m256i*) (dst + 8 * i)));
+		}
+		_mm256_storeu_si256((__m256i*) (dst + 8 * i), w);
+	}
+	funnel_scalar<XOR>(dst + 8 * i, src + 8 * i, off, nwords - i);
+}
+
+void funnel_copy_avx2(BYTE* dst, const BYTE* src, unsigned off, std::size_t nwords) {
+	funnel_avx2<false>(dst, src, off, nwords);
+}
+
+void funnel_xor_avx2(BYTE* dst, const BYTE* src, unsigned off, std::size_t nwords) {
+	funnel_avx2<true>(dst, src, off, nwords);
+}
+
+/*
+	SIMD transpose of 16 rows x 8 bytes per 128-bit lane: a network of byte, word, dword and qword unpacks gathers the
+	k-th byte of all 16 rows in one lane, movemask then extracts one column of 16 bits at a time, starting with the
+	MSB of each byte. For GetBit() order the rows are loaded in reverse order within each group of 8, such that the
+	LSB-first movemask yields MSB-first rows. For LSB-first bit order (LSB = true) the rows are loaded in order and the
+	columns of a byte are written in reverse.
+*/
+#define TRANSPOSE_LANE_ROW(k) (((k) & 8) | (7 - ((k) & 7)))
+
+template<bool LSB> constexpr std::size_t transpose_lane_row(std::size_t k) {
+	return LSB ? k : TRANSPOSE_LANE_ROW(k);
+}
+
+template<bool LSB> constexpr std::size_t transpose_column(std::size_t byte, std::size_t bit) {
+	return 8 * byte + (LSB ? 7 - bit : bit);
+}
+
+template<bool LSB = false> __attribute__((target("avx2"))) void transpose_32x64_avx2(BYTE* dst, std::size_t dststride,
+		const BYTE* src, std::size_t srcstride) {
+	__m256i in[16], a[8], b[8], c[8];
+	for (std::size_t k = 0; k < 16; k++) {
+		const BYTE* row = src + transpose_lane_row<LSB>(k) * srcstride;
+		__m128i lo = _mm_loadl_epi64((const __m128i*) row);
+		__m128i hi = _mm_loadl_epi64((const __m128i*) (row + 16 * srcstride));
+		in[k] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+	}
+	for (std::size_t i = 0; i < 8; i++) {
+		a[i] = _mm256_unpacklo_epi8(in[2 * i], in[2 * i + 1]);
+	}
+	for (std::size_t g = 0; g < 4; g++) {
+		b[2 * g] = _mm256_unpacklo_epi16(a[2 * g], a[2 * g + 1]);
+		b[2 * g + 1] = _mm256_unpackhi_epi16(a[2 * g], a[2 * g + 1]);
+	}
+	for (std::size_t h = 0; h < 2; h++) {
+		c[4 * h] = _mm256_unpacklo_epi32(b[4 * h], b[4 * h + 2]);
+		c[4 * h + 1] = _mm256_unpackhi_epi32(b[4 * h], b[4 * h + 2]);
+		c[4 * h + 2] = _mm256_unpacklo_epi32(b[4 * h + 1], b[4 * h + 3]);
+		c[4 * h + 3] = _mm256_unpackhi_epi32(b[4 * h + 1], b[4 * h + 3]);
+	}
+	for (std::size_t m = 0; m < 4; m++) {
+		__m256i col[2] = { _mm256_unpacklo_epi64(c[m], c[4 + m]), _mm256_unpackhi_epi64(c[m], c[4 + m]) };
+		for (std::size_t h = 0; h < 2; h++) {
+			for (std::size_t bit = 0; bit < 8; bit++) {
+				uint32_t mask = _mm256_movemask_epi8(col[h]);
+				memcpy(dst + transpose_column<LSB>(2 * m + h, bit) * dststride, &mask, sizeof(mask));
+				col[h] = _mm256_add_epi8(col[h], col[h]);
+			}
+		}
+	}
+}
+
+void transpose_avx2(BYTE* dst, std::size_t dststride, const BYTE* src, std::size_t srcstride, std::size_t rows,
+		std::size_t columns) {
+	transpose_blocks<32, transpose_32x64_avx2<false>>(dst, dststride, src, srcstride, rows, columns);
+}
+
+//XOR of the rows onto a strip of REGS vectors at dst
+template<std::size_t REGS> __attribute__((target("avx2"))) void xor_rows_strip_avx2(BYTE* dst, const BYTE* rows,
+		std::size_t stride, const uint32_t* idx, std::size_t n) {
+	__m256i acc[REGS];
+	for (std::size_t j = 0; j < REGS; j++) {
+		acc[j] = _mm256_loadu_si256((const __m256i*) (dst + 32 * j));
+	}
+	for (std::size_t k = 0; k < n; k++) {
+		const BYTE* row = rows + idx[k] * stride;
+#pragma GCC unroll 8
+		for (std::size_t j = 0; j < REGS; j++) {
+			acc[j] = _mm256_xor_si256(acc[j], _mm256_loadu_si256((const __m256i*) (row + 32 * j)));
+		}
+	}
+	for (std::size_t j = 0; j < REGS; j++) {
+		_mm256_storeu_si256((__m256i*) (dst + 32 * j), acc[j]);
+	}
+}
+
+//Strips of 8 vectors, then at most one of 4 and 2 each and single vectors, such that short rows are read only once
+void xor_rows_avx2(BYTE* dst, std::size_t len, const BYTE* rows, std::size_t stride, const uint32_t* idx, std::size_t n) {
+	std::size_t i = 0;
+	for (; i + 256 <= len; i += 256) {
+		xor_rows_strip_avx2<8>(dst + i, rows + i, stride, idx, n);
+	}
+	if (i + 128 <= len) {
+		xor_rows_strip_avx2<4>(dst + i, rows + i, stride, idx, n);
+		i += 128;
+	}
+	if (i + 64 <= len) {
+		xor_rows_strip_avx2<2>(dst + i, rows + i, stride, idx, n);
+		i += 64;
+	}
+	if (i + 32 <= len) {
+		xor_rows_strip_avx2<1>(dst + i, rows + i, stride, idx, n);
+		i += 32;
+	}
+	xor_rows_scalar(dst + i, len - i, rows + i, stride, idx, n);
+}
+
+//the rows 0..31 and 32..63 give the lower and upper halves of the output rows
+void transpose64_avx2(uint64_t* dst, const uint64_t* src) {
+	transpose_32x64_avx2<true>((BYTE*) dst, sizeof(uint64_t), (const BYTE*) src, sizeof(uint64_t));
+	transpose_32x64_avx2<true>((BYTE*) dst + 4, sizeof(uint64_t), (const BYTE*) (src + 32), sizeof(uint64_t));
+}
+
+/*
+	Vectorized population count: the counts of both nibbles of every byte are looked up with a byte shuffle and the
+	bytes of each 64-bit lane are summed with sad against zero.
+*/
+template<bool HAMMING> __attribute__((target("avx2"))) std::size_t popcount_avx2(const BYTE* a, const BYTE* b, std::size_t len) {
+	const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i lownibbles = _mm256_set1_epi8(0x0F);
+	__m256i acc = _mm256_setzero_si256();
+	std::size_t i = 0;
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (a + i));
+		if (HAMMING) {
+			v = _mm256_xor_si256(v, _mm256_loadu_si256((const __m256i*) (b + i)));
+		}
+		__m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, lownibbles));
+		__m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), lownibbles));
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+	}
+	uint64_t lanes[4];
+	_mm256_storeu_si256((__m256i*) lanes, acc);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + popcount_scalar<HAMMING>(a + i, b + i, len - i);
+}
+
+std::size_t popcount_bytes_avx2(const BYTE* p, std::size_t len) {
+	return popcount_avx2<false>(p, NULL, len);
+}
+
+std::size_t hamming_bytes_avx2(const BYTE* a, const BYTE* b, std::size_t len) {
+	return popcount_avx2<true>(a, b, len);
+}
+
+/*
+	BMI2 moves several elements at once between a window of the packed bits and the lanes of a 64-bit word with
+	pdep / pext. After the shift to the bit offset, 57 bits of the loaded word are valid. Every step stores or loads
+	the 8 bytes of all lanes, also if fewer elements fit into the window, so it stays 8 bytes away from the end of the
+	element array.
+*/
+template<class T> __attribute__((target("bmi2"))) void unpack_bmi2(void* dst, const BYTE* src, std::size_t pos, std::size_t bitlen,
+		std::size_t n) {
+	constexpr std::size_t LANES = sizeof(uint64_t) / sizeof(T);
+	T* out = (T*) dst;
+	std::size_t end = (pos + n * bitlen + 7) >> 3;
+	std::size_t k = std::min(LANES, 57 / bitlen);
+	std::size_t i = 0;
+	if (k > 1) {
+		uint64_t lanes = 0;
+		for (std::size_t j = 0; j < k; j++) {
+			lanes |= element_mask(bitlen) << (j * 8 * sizeof(T));
+		}
+		for (; i + LANES <= n && (pos >> 3) + 8 <= end; i += k, pos += k * bitlen) {
+			store_u64(out + i, _pdep_u64(load_u64(src + (pos >> 3)) >> (pos & 0x07), lanes));
+		}
+	}
+	for (; i < n; i++, pos += bitlen) {
+		out[i] = load_element(src, end, pos, bitlen);
+	}
+}
+
+template<class T> __attribute__((target("bmi2"))) void pack_bmi2(BYTE* dst, std::size_t pos, const void* src, std::size_t bitlen,
+		std::size_t n) {
+	constexpr std::size_t LANES = sizeof(uint64_t) / sizeof(T);
+	const T* in = (const T*) src;
+	uint64_t mask = element_mask(bitlen);
+	std::size_t k = std::min(LANES, 57 / bitlen);
+	bit_writer w(dst, pos);
+	std::size_t i = 0;
+	if (k > 1) {
+		uint64_t lanes = 0;
+		for (std::size_t j = 0; j < k; j++) {
+			lanes |= mask << (j * 8 * sizeof(T));
+		}
+		for (; i + LANES <= n; i += k) {
+			w.put(_pext_u64(load_u64(in + i), lanes), k * bitlen);
+		}
+	}
+	for (; i < n; i++) {
+		w.put(in[i] & mask, bitlen);
+	}
+	w.finish();
+}
+
+void unpack_bits_bmi2(void* dst, std::size_t width, const BYTE* src, std::size_t pos, std::size_t bitlen, std::size_t n) {
+	ELEMENT_WIDTH_SWITCH(width, unpack_bmi2, dst, src, pos, bitlen, n)
+}
+
+void pack_bits_bmi2(BYTE* dst, std::size_t pos, const void* src, std::size_t width, std::size_t bitlen, std::size_t n) {
+	ELEMENT_WIDTH_SWITCH(width, pack_bmi2, dst, pos, src, bitlen, n)
+}
+
+//GCC lowers the vector arithmetic to the instruction set of the target, e.g., 8 and 64-bit multiplications are composed
+struct avx2_arith {
+	template<class T, arith_op OP> __attribute__((target("avx2"))) static void run(BYTE* dst, const BYTE* a, const BYTE* b,
+			uint64_t s, std::size_t n) {
+		typedef T vec __attribute__((vector_size(32)));
+		vec x, y = (vec) {} + (T) s;
+		std::size_t i = 0;
+		for (; i + sizeof(vec) <= n * sizeof(T); i += sizeof(vec)) {
+			memcpy(&x, a + i, sizeof(vec));
+			if (b) {
+				memcpy(&y, b + i, sizeof(vec));
+			}
+			arith<OP>(x, y);
+			memcpy(dst + i, &x, sizeof(vec));
+		}
+		arith_scalar<T, OP>(dst + i, a + i, b ? b + i : NULL, s, n - i / sizeof(T));
+	}
+};
+
+constexpr kernel_table AVX2_KERNELS = { xor_bytes_avx2, and_bytes_avx2, set_xor_bytes_avx2, set_and_bytes_avx2,
+		or_bytes_avx2, set_or_bytes_avx2, invert_bytes_avx2, equal_bytes_scalar, funnel_copy_avx2, funnel_xor_avx2,
+		transpose_avx2, transpose64_avx2, popcount_bytes_avx2, hamming_bytes_avx2, unpack_bits_bmi2, pack_bits_bmi2,
+		xor_rows_avx2, arith_elements<avx2_arith> };
+
+//AVX-512 kernels handle the tail with byte-masked loads and stores
+#define AVX512_TARGET __attribute__((target("avx512f,avx512bw")))
+
+AVX512_TARGET inline __mmask64 tail_mask(std::size_t len) {
+	return len >= 64 ? ~(__mmask64) 0 : (((__mmask64) 1) << len) - 1;
+}
+
+#define AVX512_BINARY_KERNEL(name, op)														\
+AVX512_TARGET void name##_avx512(BYTE* dst, const BYTE* src, std::size_t len) {				\
+	std::size_t i = 0;																		\
+	for (; i + 128 <= len; i += 128) {														\
+		__m512i d0 = _mm512_loadu_si512(dst + i);											\
+		__m512i d1 = _mm512_loadu_si512(dst + i + 64);										\
+		__m512i s0 = _mm512_loadu_si512(src + i);											\
+		__m512i s1 = _mm512_loadu_si512(src + i + 64);										\
+		_mm512_storeu_si512(dst + i, op(d0, s0));											\
+		_mm512_storeu_si512(dst + i + 64, op(d1, s1));										\
+	}																						\
+	for (; i < len; i += 64) {																\
+		__mmask64 m = tail_mask(len - i);													\
+		__m512i d0 = _mm512_maskz_loadu_epi8(m, dst + i);									\
+		__m512i s0 = _mm512_maskz_loadu_epi8(m, src + i);									\
+		_mm512_mask_storeu_epi8(dst + i, m, op(d0, s0));									\
+	}																						\
+}
+
+#define AVX512_TERNARY_KERNEL(name, op)														\
+AVX512_TARGET void name##_avx512(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len) {	\
+	std::size_t i = 0;																		\
+	for (; i + 128 <= len; i += 128) {														\
+		__m512i a0 = _mm512_loadu_si512(a + i);												\
+		__m512i a1 = _mm512_loadu_si512(a + i + 64);										\
+		__m512i b0 = _mm512_loadu_si512(b + i);												\
+		__m512i b1 = _mm512_loadu_si512(b + i + 64);										\
+		_mm512_storeu_si512(dst + i, op(a0, b0));											\
+		_mm512_storeu_si512(dst + i + 64, op(a1, b1));										\
+	}																						\
+	for (; i < len; i += 64) {																\
+		__mmask64 m = tail_mask(len - i);													\
+		__m512i a0 = _mm512_maskz_loadu_epi8(m, a + i);										\
+		__m512i b0 = _mm512_maskz_loadu_epi8(m, b + i);										\
+		_mm512_mask_storeu_epi8(dst + i, m, op(a0, b0));									\
+	}																						\
+}
+
+AVX512_BINARY_KERNEL(xor_bytes, _mm512_xor_si512)
+AVX512_BINARY_KERNEL(and_bytes, _mm512_and_si512)
+AVX512_TERNARY_KERNEL(set_xor_bytes, _mm512_xor_si512)
+AVX512_TERNARY_KERNEL(set_and_bytes, _mm512_and_si512)
+AVX512_BINARY_KERNEL(or_bytes, _mm512_or_si512)
+AVX512_TERNARY_KERNEL(set_or_bytes, _mm512_or_si512)
+
+AVX512_TARGET void invert_bytes_avx512(BYTE* dst, std::size_t len) {
+	const __m512i ones = _mm512_set1_epi8(-1);
+	for (std::size_t i = 0; i < len; i += 64) {
+		__mmask64 m = tail_mask(len - i);
+		__m512i d0 = _mm512_maskz_loadu_epi8(m, dst + i);
+		_mm512_mask_storeu_epi8(dst + i, m, _mm512_xor_si512(d0, ones));
+	}
+}
+
+//the shifts use vector extensions, the shift intrinsics of GCC 12 trigger -Wmaybe-uninitialized in target functions
+typedef uint64_t v8u64 __attribute__((vector_size(64)));
+
+template<bool XOR> AVX512_TARGET void funnel_avx512(BYTE* dst, const BYTE* src, unsigned off, std::size_t nwords) {
+	std::size_t i = 0;
+	for (; i + 8 <= nwords; i += 8) {
+		v8u64 lo = (v8u64) _mm512_loadu_si512(src + 8 * i);
+		v8u64 hi = (v8u64) _mm512_loadu_si512(src + 8 * i + 1);
+		__m512i w = (__m512i) ((lo >> off) | (hi << (8 - off)));
+		if (XOR) {
+			w = _mm512_xor_si512(w, _mm512_loadu_si512(dst + 8 * i));
+		}
+		_mm512_storeu_si512(dst + 8 * i, w);
+	}
+	funnel_scalar<XOR>(dst + 8 * i, src + 8 * i, off, nwords - i);
+}
+
+void funnel_copy_avx512(BYTE* dst, const BYTE* src, unsigned off, std::size_t nwords) {
+	funnel_avx512<false>(dst, src, off, nwords);
+}
+
+void funnel_xor_avx512(BYTE* dst, const BYTE* src, unsigned off, std::size_t nwords) {
+	funnel_avx512<true>(dst, src, off, nwords);
+}
+
+//the zero-masked unpacks avoid GCC's spurious uninitialized warnings for the unmasked dword and qword forms
+constexpr __mmask16 ALL_LANES32 = 0xFFFF;
+constexpr __mmask8 ALL_LANES64 = 0xFF;
+
+template<bool LSB = false> AVX512_TARGET void transpose_64x64_avx512(BYTE* dst, std::size_t dststride, const BYTE* src,
+		std::size_t srcstride) {
+	__m512i in[16], a[8], b[8], c[8];
+	for (std::size_t k = 0; k < 16; k++) {
+		const BYTE* row = src + transpose_lane_row<LSB>(k) * srcstride;
+		__m512i v = _mm512_castsi128_si512(_mm_loadl_epi64((const __m128i*) row));
+		v = _mm512_inserti32x4(v, _mm_loadl_epi64((const __m128i*) (row + 16 * srcstride)), 1);
+		v = _mm512_inserti32x4(v, _mm_loadl_epi64((const __m128i*) (row + 32 * srcstride)), 2);
+		in[k] = _mm512_inserti32x4(v, _mm_loadl_epi64((const __m128i*) (row + 48 * srcstride)), 3);
+	}
+	for (std::size_t i = 0; i < 8; i++) {
+		a[i] = _mm512_unpacklo_epi8(in[2 * i], in[2 * i + 1]);
+	}
+	for (std::size_t g = 0; g < 4; g++) {
+		b[2 * g] = _mm512_unpacklo_epi16(a[2 * g], a[2 * g + 1]);
+		b[2 * g + 1] = _mm512_unpackhi_epi16(a[2 * g], a[2 * g + 1]);
+	}
+	for (std::size_t h = 0; h < 2; h++) {
+		c[4 * h] = _mm512_maskz_unpacklo_epi32(ALL_LANES32, b[4 * h], b[4 * h + 2]);
+		c[4 * h + 1] = _mm512_maskz_unpackhi_epi32(ALL_LANES32, b[4 * h], b[4 * h + 2]);
+		c[4 * h + 2] = _mm512_maskz_unpacklo_epi32(ALL_LANES32, b[4 * h + 1], b[4 * h + 3]);
+		c[4 * h + 3] = _mm512_maskz_unpackhi_epi32(ALL_LANES32, b[4 * h + 1], b[4 * h + 3]);
+	}
+	for (std::size_t m = 0; m < 4; m++) {
+		__m512i col[2] = { _mm512_maskz_unpacklo_epi64(ALL_LANES64, c[m], c[4 + m]), _mm512_maskz_unpackhi_epi64(ALL_LANES64, c[m], c[4 + m]) };
+		for (std::size_t h = 0; h < 2; h++) {
+			for (std::size_t bit = 0; bit < 8; bit++) {
+				uint64_t mask = _mm512_movepi8_mask(col[h]);
+				memcpy(dst + transpose_column<LSB>(2 * m + h, bit) * dststride, &mask, sizeof(mask));
+				col[h] = _mm512_add_epi8(col[h], col[h]);
+			}
+		}
+	}
+}
+
+void transpose_avx512(BYTE* dst, std::size_t dststride, const BYTE* src, std::size_t srcstride, std::size_t rows,
+		std::size_t columns) {
+	transpose_blocks<64, transpose_64x64_avx512<false>>(dst, dststride, src, srcstride, rows, columns);
+}
+
+//XOR of the rows onto a strip of REGS vectors at dst, of which the last one is masked by m
+template<std::size_t REGS> AVX512_TARGET void xor_rows_strip_avx512(BYTE* dst, const BYTE* rows, std::size_t stride,
+		const uint32_t* idx, std::size_t n, __mmask64 m) {
+	__m512i acc[REGS];
+	for (std::size_t j = 0; j + 1 < REGS; j++) {
+		acc[j] = _mm512_loadu_si512(dst + 64 * j);
+	}
+	acc[REGS - 1] = _mm512_maskz_loadu_epi8(m, dst + 64 * (REGS - 1));
+	for (std::size_t k = 0; k < n; k++) {
+		const BYTE* row = rows + idx[k] * stride;
+#pragma GCC unroll 8
+		for (std::size_t j = 0; j + 1 < REGS; j++) {
+			acc[j] = _mm512_xor_si512(acc[j], _mm512_loadu_si512(row + 64 * j));
+		}
+		acc[REGS - 1] = _mm512_xor_si512(acc[REGS - 1], _mm512_maskz_loadu_epi8(m, row + 64 * (REGS - 1)));
+	}
+	for (std::size_t j = 0; j + 1 < REGS; j++) {
+		_mm512_storeu_si512(dst + 64 * j, acc[j]);
+	}
+	_mm512_mask_storeu_epi8(dst + 64 * (REGS - 1), m, acc[REGS - 1]);
+}
+
+//Strips of 8 vectors, then one strip of the remaining vectors with a masked last one, such that rows are read only once
+AVX512_TARGET void xor_rows_avx512(BYTE* dst, std::size_t len, const BYTE* rows, std::size_t stride,
+		const uint32_t* idx, std::size_t n) {
+	std::size_t i = 0;
+	for (; i + 512 <= len; i += 512) {
+		xor_rows_strip_avx512<8>(dst + i, rows + i, stride, idx, n, ~(__mmask64) 0);
+	}
+	if (i == len) {
+		return;
+	}
+	__mmask64 m = tail_mask((len - i - 1) % 64 + 1);
+	switch ((len - i + 63) / 64) {
+	case 1:
+		return xor_rows_strip_avx512<1>(dst + i, rows + i, stride, idx, n, m);
+	case 2:
+		return xor_rows_strip_avx512<2>(dst + i, rows + i, stride, idx, n, m);
+	case 3:
+		return xor_rows_strip_avx512<3>(dst + i, rows + i, stride, idx, n, m);
+	case 4:
+		return xor_rows_strip_avx512<4>(dst + i, rows + i, stride, idx, n, m);
+	case 5:
+		return xor_rows_strip_avx512<5>(dst + i, rows + i, stride, idx, n, m);
+	case 6:
+		return xor_rows_strip_avx512<6>(dst + i, rows + i, stride, idx, n, m);
+	case 7:
+		return xor_rows_strip_avx512<7>(dst + i, rows + i, stride, idx, n, m);
+	default:
+		return xor_rows_strip_avx512<8>(dst + i, rows + i, stride, idx, n, m);
+	}
+}
+
+void transpose64_avx512(uint64_t* dst, const uint64_t* src) {
+	transpose_64x64_avx512<true>((BYTE*) dst, sizeof(uint64_t), (const BYTE*) src, sizeof(uint64_t));
+}
+
+template<bool HAMMING> AVX512_TARGET std::size_t popcount_avx512(const BYTE* a, const BYTE* b, std::size_t len) {
+	//popcounts of the nibbles 0..15 in each 128 bit lane
+	const __m512i lut = _mm512_set4_epi64(0x0403030203020201, 0x0302020102010100, 0x0403030203020201, 0x0302020102010100);
+	const __m512i lownibbles = _mm512_set1_epi8(0x0F);
+	__m512i acc = _mm512_setzero_si512();
+	for (std::size_t i = 0; i < len; i += 64) {
+		__mmask64 m = tail_mask(len - i);
+		__m512i v = _mm512_maskz_loadu_epi8(m, a + i);
+		if (HAMMING) {
+			v = _mm512_xor_si512(v, _mm512_maskz_loadu_epi8(m, b + i));
+		}
+		__m512i lo = _mm512_shuffle_epi8(lut, _mm512_and_si512(v, lownibbles));
+		__m512i hi = _mm512_shuffle_epi8(lut, _mm512_and_si512((__m512i) ((v8u64) v >> 4), lownibbles));
+		acc = _mm512_add_epi64(acc, _mm512_sad_epu8(_mm512_add_epi8(lo, hi), _mm512_setzero_si512()));
+	}
+	v8u64 sums = (v8u64) acc;
+	return sums[0] + sums[1] + sums[2] + sums[3] + sums[4] + sums[5] + sums[6] + sums[7];
+}
+
+std::size_t popcount_bytes_avx512(const BYTE* p, std::size_t len) {
+	return popcount_avx512<false>(p, NULL, len);
+}
+
+std::size_t hamming_bytes_avx512(const BYTE* a, const BYTE* b, std::size_t len) {
+	return popcount_avx512<true>(a, b, len);
+}
+
+struct avx512_arith {
+	template<class T, arith_op OP> AVX512_TARGET static void run(BYTE* dst, const BYTE* a, const BYTE* b, uint64_t s,
+			std::size_t n) {
+		typedef T vec __attribute__((vector_size(64)));
+		vec x, y = (vec) {} + (T) s;
+		for (std::size_t i = 0; i < n * sizeof(T); i += sizeof(vec)) {
+			__mmask64 m = tail_mask(n * sizeof(T) - i);
+			x = (vec) _mm512_maskz_loadu_epi8(m, a + i);
+			if (b) {
+				y = (vec) _mm512_maskz_loadu_epi8(m, b + i);
+			}
+			arith<OP>(x, y);
+			_mm512_mask_storeu_epi8(dst + i, m, (__m512i) x);
+		}
+	}
+};
+
+constexpr kernel_table AVX512_KERNELS = { xor_bytes_avx512, and_bytes_avx512, set_xor_bytes_avx512,
+		set_and_bytes_avx512, or_bytes_avx512, set_or_bytes_avx512, invert_bytes_avx512, equal_bytes_scalar,
+		funnel_copy_avx512, funnel_xor_avx512, transpose_avx512, transpose64_avx512, popcount_bytes_avx512,
+		hamming_bytes_avx512, unpack_bits_bmi2, pack_bits_bmi2, xor_rows_avx512, arith_elements<avx512_arith> };
+
+#endif /* BITKERNELS_X86_SIMD */
+
+simd_level detect_simd_level() {
+#ifdef BITKERNELS_X86_SIMD
+	__builtin_cpu_init();
+	//the packed element kernels of both levels use BMI2
+	if (!__builtin_cpu_supports("bmi2")) {
+		return simd_level::scalar;
+	}
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+		return simd_level::avx512;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		return simd_level::avx2;
+	}
+#endif
+	return simd_level::scalar;
+}
+
+const kernel_table& table_for(simd_level level) {
+	switch (level) {
+#ifdef BITKERNELS_X86_SIMD
+	case simd_level::avx512:
+		return AVX512_KERNELS;
+	case simd_level::avx2:
+		return AVX2_KERNELS;
+#endif
+	default:
+		return SCALAR_KERNELS;
+	}
+}
+
+struct dispatch_state {
+	simd_level max_level;
+	simd_level level;
+	const kernel_table* kernels;
+};
+
+dispatch_state& dispatch() {
+	static dispatch_state state = [] {
+		simd_level level = detect_simd_level();
+		return dispatch_state { level, level, &table_for(level) };
+	}();
+	return state;
+}
+
+//len <= 8 bits of src starting at bit off < 8, reads the second byte only if the range reaches into it
+inline unsigned load_bits(const BYTE* src, unsigned off, unsigned len) {
+	unsigned bits = src[0] >> off;
+	if (off + len > 8) {
+		bits |= ((unsigned) src[1]) << (8 - off);
+	}
+	return bits & ((1u << len) - 1);
+}
+
+template<bool XOR> inline void merge_byte(BYTE* dst, unsigned bits, unsigned mask) {
+	if (XOR) {
+		*dst ^= bits;
+	} else {
+		*dst = (*dst & ~mask) | bits;
+	}
+}
+
+template<bool XOR> void bit_op(BYTE* dst, std::size_t dstpos, const BYTE* src, std::size_t srcpos, std::size_t len) {
+	if (len == 0) {
+		return;
+	}
+	dst += dstpos >> 3;
+	src += srcpos >> 3;
+	unsigned dstoff = dstpos & 7;
+	unsigned srcoff = srcpos & 7;
+
+	//bring dst to a byte boundary
+	if (dstoff) {
+		unsigned n = std::min<std::size_t>(len, 8 - dstoff);
+		merge_byte<XOR>(dst, load_bits(src, srcoff, n) << dstoff, ((1u << n) - 1) << dstoff);
+		dst++;
+		srcoff += n;
+		src += srcoff >> 3;
+		srcoff &= 7;
+		len -= n;
+	}
+
+	//whole 64-bit words
+	std::size_t nwords = len >> 6;
+	if (srcoff == 0) {
+		if (XOR) {
+			xor_bytes(dst, src, nwords * 8);
+		} else {
+			memcpy(dst, src, nwords * 8);
+		}
+	} else if (XOR) {
+		dispatch().kernels->funnel_xor(dst, src, srcoff, nwords);
+	} else {
+		dispatch().kernels->funnel_copy(dst, src, srcoff, nwords);
+	}
+	dst += nwords * 8;
+	src += nwords * 8;
+	len -= nwords * 64;
+
+	//remaining bytes, the last one possibly partial
+	while (len > 0) {
+		unsigned n = std::min<std::size_t>(len, 8);
+		merge_byte<XOR>(dst, load_bits(src, srcoff, n), (1u << n) - 1);
+		dst++;
+		src++;
+		len -= n;
+	}
+}
+
+//Overlapping ranges are moved through a stack block of this many bits
+constexpr std::size_t MOVE_BLOCK_BITS = 1 << 15;
+
+//bit_copy() of possibly overlapping ranges of p. The block gets the bit offset of the destination, such that storing it
+//is a memcpy, and blocks are moved from the end if the destination lies behind the source.
+void bit_move(BYTE* p, std::size_t dstpos, std::size_t srcpos, std::size_t len) {
+	if (dstpos == srcpos) {
+		return;
+	}
+	BYTE block[MOVE_BLOCK_BITS / 8 + 1];
+	unsigned off = dstpos & 7;
+	for (std::size_t done = 0; done < len; done += MOVE_BLOCK_BITS) {
+		std::size_t n = std::min(MOVE_BLOCK_BITS, len - done);
+		std::size_t i = dstpos > srcpos ? len - done - n : done;
+		bit_op<false>(block, off, p, srcpos + i, n);
+		bit_op<false>(p, dstpos + i, block, off, n);
+	}
+}
+
+void bit_zero(BYTE* p, std::size_t pos, std::size_t len) {
+	if ((pos & 7) && len > 0) {
+		unsigned n = std::min<std::size_t>(len, 8 - (pos & 7));
+		merge_byte<false>(p + (pos >> 3), 0, ((1u << n) - 1) << (pos & 7));
+		pos += n;
+		len -= n;
+	}
+	memset(p + (pos >> 3), 0, len >> 3);
+	if (len & 7) {
+		merge_byte<false>(p + ((pos + len) >> 3), 0, (1u << (len & 7)) - 1);
+	}
+}
+
+/*
+	Tiled transposition of bit matrices of arbitrary shape. Tiles of byte-aligned matrices are transposed by the
+	kernels in place of the matrix, other tiles are gathered into a zero-padded buffer first and their rows are
+	scattered bitwise afterwards. Both buffers are a TRANSPOSE_TILE x TRANSPOSE_TILE bit matrix.
+*/
+constexpr std::size_t TRANSPOSE_TILE = 256;
+constexpr std::size_t TILE_STRIDE = TRANSPOSE_TILE / 8;
+constexpr std::size_t TILE_BYTES = TRANSPOSE_TILE * TILE_STRIDE;
+
+//Elements per chunk of bit slicing, a multiple of 64
+constexpr std::size_t SLICE_GRAIN = 1024;
+
+//Bytes of the row blocks of xor_selected_rows(), which are read once per selection and should stay in the L2 cache
+constexpr std::size_t SELECT_BLOCK_BYTES = 1 << 18;
+
+//len bits of src starting at bit pos in GetBit() order to the byte-aligned dst, the last byte is zero-padded
+void gather_bits(BYTE* dst, const BYTE* src, std::size_t pos, std::size_t len) {
+	src += pos >> 3;
+	unsigned off = pos & 7;
+	std::size_t nbytes = (len + 7) / 8;
+	std::size_t last = (off + len - 1) / 8;
+	std::size_t i = 0;
+	if (off == 0) {
+		memcpy(dst, src, nbytes);
+		i = nbytes;
+	}
+	//big-endian words as long as the byte after them belongs to the range
+	for (; i + 8 <= nbytes && i + 8 <= last; i += 8) {
+		REGSIZE w = (__builtin_bswap64(load_word(src + i)) << off) | (src[i + 8] >> (8 - off));
+		store_word(dst + i, __builtin_bswap64(w));
+	}
+	for (; i < nbytes; i++) {
+		BYTE v = src[i] << off;
+		if (off && i + 1 <= last) {
+			v |= src[i + 1] >> (8 - off);
+		}
+		dst[i] = v;
+	}
+	if (len & 7) {
+		dst[nbytes - 1] &= (BYTE) (0xFF << (8 - (len & 7)));
+	}
+}
+
+//len bits of the byte-aligned src to dst starting at bit pos in GetBit() order, other bits of dst are left untouched
+void scatter_bits(BYTE* dst, std::size_t pos, const BYTE* src, std::size_t len) {
+	dst += pos >> 3;
+	unsigned off = pos & 7;
+	std::size_t i = 0;
+	if (off == 0) {
+		memcpy(dst, src, len / 8);
+		i = len / 8;
+		len &= 7;
+	}
+	for (; len >= 64; i += 8, len -= 64) {
+		REGSIZE v = __builtin_bswap64(load_word(src + i));
+		REGSIZE d = __builtin_bswap64(load_word(dst + i));
+		d = (d & ~(~(REGSIZE) 0 >> off)) | (v >> off);
+		store_word(dst + i, __builtin_bswap64(d));
+		dst[i + 8] = (dst[i + 8] & (0xFF >> off)) | (BYTE) (v << (8 - off));
+	}
+	for (; len > 0; i++) {
+		unsigned n = std::min<std::size_t>(len, 8);
+		BYTE mask = 0xFF << (8 - n);
+		BYTE v = src[i] & mask;
+		dst[i] = (dst[i] & ~(mask >> off)) | (v >> off);
+		if (off + n > 8) {
+			dst[i + 1] = (dst[i + 1] & ~(BYTE) (mask << (8 - off))) | (BYTE) (v << (8 - off));
+		}
+		len -= n;
+	}
+}
+
+//Transpose the h x w tile at (r0, c0) of the matrix with the given number of columns into tile, gather is scratch space
+void load_tile_transposed(BYTE* tile, const BYTE* mat, std::size_t columns, std::size_t r0, std::size_t c0,
+		std::size_t h, std::size_t w, BYTE* gather) {
+	const kernel_table* kernels = dispatch().kernels;
+	if ((columns & 7) == 0 && (h & 7) == 0) {
+		kernels->transpose(tile, TILE_STRIDE, mat + r0 * (columns / 8) + c0 / 8, columns / 8, h, w);
+		return;
+	}
+	std::size_t hpad = (h + 7) & ~((std::size_t) 7);
+	for (std::size_t k = 0; k < h; k++) {
+		gather_bits(gather + k * TILE_STRIDE, mat, (r0 + k) * columns + c0, w);
+	}
+	memset(gather + h * TILE_STRIDE, 0, (hpad - h) * TILE_STRIDE);
+	kernels->transpose(tile, TILE_STRIDE, gather, TILE_STRIDE, hpad, (w + 7) & ~((std::size_t) 7));
+}
+
+//Write the h x w bits of tile to position (r0, c0) of the matrix with the given number of columns
+void store_tile(BYTE* mat, std::size_t columns, std::size_t r0, std::size_t c0, std::size_t h, std::size_t w,
+		const BYTE* tile) {
+	for (std::size_t k = 0; k < h; k++) {
+		if ((columns & 7) == 0) {
+			memcpy(mat + (r0 + k) * (columns / 8) + c0 / 8, tile + k * TILE_STRIDE, w / 8);
+		} else {
+			scatter_bits(mat, (r0 + k) * columns + c0, tile + k * TILE_STRIDE, w);
+		}
+	}
+}
+
+//Out of place, every chunk of columns of src writes a distinct byte range of dst
+void transpose_columns(BYTE* dst, const BYTE* src, std::size_t rows, std::size_t columns, std::size_t c0, std::size_t c1) {
+	bool aligned = (rows & 7) == 0 && (columns & 7) == 0;
+	std::vector<BYTE> buf(aligned ? 0 : 2 * TILE_BYTES);
+	for (std::size_t c = c0; c < c1; c += TRANSPOSE_TILE) {
+		std::size_t w = std::min(TRANSPOSE_TILE, c1 - c);
+		for (std::size_t r = 0; r < rows; r += TRANSPOSE_TILE) {
+			std::size_t h = std::min(TRANSPOSE_TILE, rows - r);
+			if (aligned) {
+				dispatch().kernels->transpose(dst + c * (rows / 8) + r / 8, rows / 8, src + r * (columns / 8) + c / 8,
+						columns / 8, h, w);
+			} else {
+				load_tile_transposed(buf.data(), src, columns, r, c, h, w, buf.data() + TILE_BYTES);
+				store_tile(dst, rows, c, r, w, h, buf.data());
+			}
+		}
+	}
+}
+
+//In place for n x n matrices, swaps the tiles (i, j) and (j, i) for the tile pairs [p0, p1) of the upper triangle
+void transpose_square_tiles(BYTE* mat, std::size_t n, std::size_t p0, std::size_t p1) {
+	std::size_t ntiles = (n + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+	std::vector<BYTE> buf(3 * TILE_BYTES);
+	BYTE* a = buf.data();
+	BYTE* b = a + TILE_BYTES;
+	BYTE* gather = b + TILE_BYTES;
+
+	std::size_t i = 0, j = p0;
+	while (j >= ntiles - i) {
+		j -= ntiles - i;
+		i++;
+	}
+	j += i;
+	for (std::size_t p = p0; p < p1; p++) {
+		std::size_t r = i * TRANSPOSE_TILE, c = j * TRANSPOSE_TILE;
+		std::size_t h = std::min(TRANSPOSE_TILE, n - r), w = std::min(TRANSPOSE_TILE, n - c);
+		load_tile_transposed(a, mat, n, r, c, h, w, gather);
+		if (i != j) {
+			load_tile_transposed(b, mat, n, c, r, w, h, gather);
+			store_tile(mat, n, r, c, h, w, b);
+		}
+		store_tile(mat, n, c, r, w, h, a);
+		if (++j == ntiles) {
+			i++;
+			j = i;
+		}
+	}
+}
+
+/*
+	Bit slicing of the elements [e0, e1) in blocks of 64: the elements are unpacked into 64-bit words and transposed
+	into one word per plane, and vice versa. e0 is a multiple of 64, so every block starts at a byte of each plane.
+*/
+void slice_elements(BYTE* planes, std::size_t stride, const BYTE* src, std::size_t bitlen, std::size_t e0, std::size_t e1) {
+	const kernel_table* kernels = dispatch().kernels;
+	uint64_t x[64], y[64];
+	for (std::size_t i = e0; i < e1; i += 64) {
+		std::size_t m = std::min<std::size_t>(64, e1 - i);
+		unpack_bits(x, sizeof(uint64_t), src, i * bitlen, bitlen, m);
+		std::fill(x + m, x + 64, 0);
+		kernels->transpose64(y, x);
+		for (std::size_t b = 0; b < bitlen; b++) {
+			BYTE* p = planes + b * stride + i / 8;
+			memcpy(p, &y[b], m / 8);
+			if (m & 7) {
+				merge_byte<false>(p + m / 8, y[b] >> (m & ~(std::size_t) 7), (1u << (m & 7)) - 1);
+			}
+		}
+	}
+}
+
+void unslice_elements(BYTE* dst, const BYTE* planes, std::size_t stride, std::size_t bitlen, std::size_t e0,
+		std::size_t e1) {
+	const kernel_table* kernels = dispatch().kernels;
+	//the planes from bitlen on stay zero
+	uint64_t x[64], y[64] = { };
+	for (std::size_t i = e0; i < e1; i += 64) {
+		std::size_t m = std::min<std::size_t>(64, e1 - i);
+		for (std::size_t b = 0; b < bitlen; b++) {
+			y[b] = 0;
+			memcpy(&y[b], planes + b * stride + i / 8, (m + 7) / 8);
+		}
+		kernels->transpose64(x, y);
+		pack_bits(dst, i * bitlen, x, sizeof(uint64_t), bitlen, m);
+	}
+}
+
+//len <= 64 bits of src starting at bit pos, reads only the bytes of the range
+inline uint64_t load_bits64(const BYTE* src, std::size_t pos, std::size_t len) {
+	unsigned off = pos & 7;
+	BYTE buf[2 * sizeof(uint64_t)] = { };
+	memcpy(buf, src + (pos >> 3), (off + len + 7) / 8);
+	uint64_t w;
+	memcpy(&w, buf, sizeof(w));
+	w >>= off;
+	if (off) {
+		w |= (uint64_t) buf[sizeof(w)] << (64 - off);
+	}
+	return len == 64 ? w : w & (((uint64_t) 1 << len) - 1);
+}
+
+/*
+	Adds the rows [r0, r1) that are selected by the nsel selections onto their sums in acc. The rows are processed in
+	blocks of blockrows rows that stay in the cache while all selections read them, each selection collects the indices
+	of its rows in the block and adds them with one call to the row kernel.
+*/
+void xor_selected_block(BYTE* acc, const BYTE* rows, std::size_t rowbytes, const BYTE* sel, std::size_t selstride,
+		std::size_t nsel, std::size_t r0, std::size_t r1, std::size_t blockrows) {
+	const kernel_table* kernels = dispatch().kernels;
+	std::vector<uint32_t> idx(blockrows);
+	for (std::size_t b0 = r0; b0 < r1; b0 += blockrows) {
+		std::size_t b1 = std::min(b0 + blockrows, r1);
+		for (std::size_t s = 0; s < nsel; s++) {
+			std::size_t n = 0;
+			for (std::size_t i = b0; i < b1; i += 64) {
+				uint64_t w = load_bits64(sel, s * selstride + i, std::min<std::size_t>(64, b1 - i));
+				for (; w; w &= w - 1) {
+					idx[n++] = i - b0 + __builtin_ctzll(w);
+				}
+			}
+			kernels->xor_rows(acc + s * rowbytes, rowbytes, rows + b0 * rowbytes, rowbytes, idx.data(), n);
+		}
+	}
+}
+
+/*
+	Elements of 8, 16, 32 or 64 bits are processed in place, other lengths are unpacked into the next larger integers
+	chunk by chunk. The arithmetic modulo 2^(8 * width) is reduced modulo 2^bitlen when the results are packed.
+*/
+void arith_packed(arith_op op, BYTE* dst, const BYTE* a, const BYTE* b, uint64_t s, std::size_t bitlen, std::size_t n) {
+	assert(bitlen >= 1 && bitlen <= 64);
+	const kernel_table* kernels = dispatch().kernels;
+	if (bitlen % 8 == 0 && (bitlen & (bitlen - 1)) == 0) {
+		kernels->arith(op, dst, a, b, s, bitlen / 8, n);
+		return;
+	}
+	constexpr std::size_t CHUNK_BYTES = 2048;
+	std::size_t width = bitlen <= 8 ? 1 : bitlen <= 16 ? 2 : bitlen <= 32 ? 4 : 8;
+	std::size_t chunk = CHUNK_BYTES / width;
+	uint64_t x[CHUNK_BYTES / sizeof(uint64_t)], y[CHUNK_BYTES / sizeof(uint64_t)];
+	for (std::size_t i = 0; i < n; i += chunk) {
+		std::size_t m = std::min(chunk, n - i);
+		unpack_bits(x, width, a, i * bitlen, bitlen, m);
+		if (b) {
+			unpack_bits(y, width, b, i * bitlen, bitlen, m);
+		}
+		kernels->arith(op, (BYTE*) x, (BYTE*) x, b ? (BYTE*) y : NULL, s, width, m);
+		pack_bits(dst, i * bitlen, x, width, bitlen, m);
+	}
+}
+
+}
+
+
+simd_level get_simd_level() {
+	return dispatch().level;
+}
+
+simd_level get_max_simd_level() {
+	return dispatch().max_level;
+}
+
+simd_level set_simd_level(simd_level level) {
+	dispatch_state& state = dispatch();
+	state.level = std::min(level, state.max_level);
+	state.kernels = &table_for(state.level);
+	return state.level;
+}
+
+void xor_bytes(BYTE* dst, const BYTE* src, std::size_t len) {
+	dispatch().kernels->xor_bytes(dst, src, len);
+}
+
+void and_bytes(BYTE* dst, const BYTE* src, std::size_t len) {
+	dispatch().kernels->and_bytes(dst, src, len);
+}
+
+void set_xor_bytes(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len) {
+	dispatch().kernels->set_xor_bytes(dst, a, b, len);
+}
+
+void set_and_bytes(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len) {
+	dispatch().kernels->set_and_bytes(dst, a, b, len);
+}
+
+void or_bytes(BYTE* dst, const BYTE* src, std::size_t len) {
+	dispatch().kernels->or_bytes(dst, src, len);
+}
+
+void set_or_bytes(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len) {
+	dispatch().kernels->set_or_bytes(dst, a, b, len);
+}
+
+void invert_bytes(BYTE* dst, std::size_t len) {
+	dispatch().kernels->invert_bytes(dst, len);
+}
+
+bool equal_bytes(const BYTE* a, const BYTE* b, std::size_t len) {
+	return dispatch().kernels->equal_bytes(a, b, len);
+}
+
+std::size_t popcount_bytes(const BYTE* p, std::size_t len) {
+	return dispatch().kernels->popcount(p, len);
+}
+
+std::size_t hamming_bytes(const BYTE* a, const BYTE* b, std::size_t len) {
+	return dispatch().kernels->hamming(a, b, len);
+}
+
+void unpack_bits(void* dst, std::size_t width, const BYTE* src, std::size_t pos, std::size_t bitlen, std::size_t n) {
+	assert((width == 1 || width == 2 || width == 4 || width == 8) && bitlen >= 1 && bitlen <= 8 * width);
+	if (n > 0) {
+		dispatch().kernels->unpack(dst, width, src, pos, bitlen, n);
+	}
+}
+
+void pack_bits(BYTE* dst, std::size_t pos, const void* src, std::size_t width, std::size_t bitlen, std::size_t n) {
+	assert((width == 1 || width == 2 || width == 4 || width == 8) && bitlen >= 1 && bitlen <= 8 * width);
+	if (n > 0) {
+		dispatch().kernels->pack(dst, pos, src, width, bitlen, n);
+	}
+}
+
+void add_elements(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t bitlen, std::size_t n) {
+	arith_packed(arith_op::add, dst, a, b, 0, bitlen, n);
+}
+
+void sub_elements(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t bitlen, std::size_t n) {
+	arith_packed(arith_op::sub, dst, a, b, 0, bitlen, n);
+}
+
+void mul_elements(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t bitlen, std::size_t n) {
+	arith_packed(arith_op::mul, dst, a, b, 0, bitlen, n);
+}
+
+void mul_scalar_elements(BYTE* dst, const BYTE* a, uint64_t s, std::size_t bitlen, std::size_t n) {
+	arith_packed(arith_op::mul, dst, a, NULL, s, bitlen, n);
+}
+
+void bit_copy(BYTE* dst, std::size_t dstpos, const BYTE* src, std::size_t srcpos, std::size_t len) {
+	bit_op<false>(dst, dstpos, src, srcpos, len);
+}
+
+void bit_xor(BYTE* dst, std::size_t dstpos, const BYTE* src, std::size_t srcpos, std::size_t len) {
+	bit_op<true>(dst, dstpos, src, srcpos, len);
+}
+
+void bit_shift_left(BYTE* p, std::size_t pos, std::size_t len, std::size_t k) {
+	k = std::min(k, len);
+	bit_move(p, pos + k, pos, len - k);
+	bit_zero(p, pos, k);
+}
+
+void bit_shift_right(BYTE* p, std::size_t pos, std::size_t len, std::size_t k) {
+	k = std::min(k, len);
+	bit_move(p, pos, pos + k, len - k);
+	bit_zero(p, pos + len - k, k);
+}
+
+//the bits that wrap around are saved, the smaller part of the range is the one that wraps around
+void bit_rotate_left(BYTE* p, std::size_t pos, std::size_t len, std::size_t k) {
+	if (len == 0 || (k %= len) == 0) {
+		return;
+	}
+	std::size_t m = len - k;
+	std::vector<BYTE> wrapped((std::min(k, m) + 7) / 8);
+	if (k <= m) {
+		bit_op<false>(wrapped.data(), 0, p, pos + m, k);
+		bit_move(p, pos + k, pos, m);
+		bit_op<false>(p, pos, wrapped.data(), 0, k);
+	} else {
+		bit_op<false>(wrapped.data(), 0, p, pos, m);
+		bit_move(p, pos, pos + m, k);
+		bit_op<false>(p, pos + k, wrapped.data(), 0, m);
+	}
+}
+
+void bit_rotate_right(BYTE* p, std::size_t pos, std::size_t len, std::size_t k) {
+	if (len > 0) {
+		bit_rotate_left(p, pos, len, len - k % len);
+	}
+}
+
+void bit_transpose(BYTE* dst, const BYTE* src, std::size_t rows, std::size_t columns, uint32_t nthreads) {
+	if (rows == 0 || columns == 0) {
+		return;
+	}
+	ParallelFor(columns, TRANSPOSE_TILE, nthreads, [&] (std::size_t c0, std::size_t c1) {
+		transpose_columns(dst, src, rows, columns, c0, c1);
+	});
+}
+
+//Chunks of multiples of SLICE_GRAIN elements write disjoint bytes of the planes and of the packed elements
+void bit_slice(BYTE* planes, std::size_t stride, const BYTE* src, std::size_t bitlen, std::size_t n, uint32_t nthreads) {
+	assert(bitlen >= 1 && bitlen <= 64 && stride >= (n + 7) / 8);
+	ParallelFor(n, SLICE_GRAIN, nthreads, [&] (std::size_t e0, std::size_t e1) {
+		slice_elements(planes, stride, src, bitlen, e0, e1);
+	});
+}
+
+void bit_unslice(BYTE* dst, const BYTE* planes, std::size_t stride, std::size_t bitlen, std::size_t n, uint32_t nthreads) {
+	assert(bitlen >= 1 && bitlen <= 64 && stride >= (n + 7) / 8);
+	ParallelFor(n, SLICE_GRAIN, nthreads, [&] (std::size_t e0, std::size_t e1) {
+		unslice_elements(dst, planes, stride, bitlen, e0, e1);
+	});
+}
+
+//Threads sum their blocks into private accumulators, which are added to dst at the end
+void xor_selected_rows(BYTE* dst, const BYTE* rows, std::size_t rowbytes, std::size_t nrows, const BYTE* sel,
+		std::size_t selstride, std::size_t nsel, uint32_t nthreads) {
+	if (rowbytes == 0 || nsel == 0) {
+		return;
+	}
+	std::size_t blockrows = std::max<std::size_t>(1, SELECT_BLOCK_BYTES / rowbytes / 64) * 64;
+	if (nthreads == 1 || nrows <= blockrows) {
+		xor_selected_block(dst, rows, rowbytes, sel, selstride, nsel, 0, nrows, blockrows);
+		return;
+	}
+	std::mutex lock;
+	ParallelFor(nrows, blockrows, nthreads, [&] (std::size_t r0, std::size_t r1) {
+		std::vector<BYTE> acc(nsel * rowbytes);
+		xor_selected_block(acc.data(), rows, rowbytes, sel, selstride, nsel, r0, r1, blockrows);
+		std::lock_guard<std::mutex> guard(lock);
+		xor_bytes(dst, acc.data(), acc.size());
+	});
+}
+
+void bit_transpose_square(BYTE* mat, std::size_t n, uint32_t nthreads) {
+	std::size_t ntiles = (n + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+	//tiles of unaligned matrices share bytes at their borders
+	if (n & 7) {
+		nthreads = 1;
+	}
+	ParallelFor(ntiles * (ntiles + 1) / 2, 1, nthreads, [&] (std::size_t p0, std::size_t p1) {
+		transpose_square_tiles(mat, n, p0, p1);
+	});
+}
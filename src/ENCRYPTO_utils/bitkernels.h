@@ -0,0 +1,207 @@
+/**
+ \file 		bitkernels.h
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Bulk bitwise kernels on byte arrays with runtime SIMD dispatch
+ */
+
+#ifndef __BITKERNELS_H__
+#define __BITKERNELS_H__
+
+#include "typedefs.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+	Instruction set used by the bulk kernels below. The best level supported by the CPU is selected when the
+	library is loaded. AVX-512 requires AVX512F and AVX512BW.
+*/
+enum class simd_level {
+	scalar, avx2, avx512
+};
+
+/** \return the level that is currently used by the kernels */
+simd_level get_simd_level();
+
+/** \return the best level that is supported by the CPU and the compiler */
+simd_level get_max_simd_level();
+
+/**
+	Select the kernels of a particular level, e.g. to compare or benchmark them. Levels that are not supported are
+	lowered to the best supported one. Not thread-safe with concurrent calls to the kernels.
+	\return	the level that is used afterwards
+*/
+simd_level set_simd_level(simd_level level);
+
+/*
+	All kernels work on len bytes. dst may be equal to a source but must not otherwise overlap with it.
+*/
+
+/** dst ^= src */
+void xor_bytes(BYTE* dst, const BYTE* src, std::size_t len);
+/** dst &= src */
+void and_bytes(BYTE* dst, const BYTE* src, std::size_t len);
+/** dst = a ^ b */
+void set_xor_bytes(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len);
+/** dst = a & b */
+void set_and_bytes(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len);
+/** dst |= src */
+void or_bytes(BYTE* dst, const BYTE* src, std::size_t len);
+/** dst = a | b */
+void set_or_bytes(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len);
+/** dst = ~dst */
+void invert_bytes(BYTE* dst, std::size_t len);
+/** \return a == b */
+bool equal_bytes(const BYTE* a, const BYTE* b, std::size_t len);
+/** \return the number of set bits in p */
+std::size_t popcount_bytes(const BYTE* p, std::size_t len);
+/** \return the number of bits in which a and b differ */
+std::size_t hamming_bytes(const BYTE* a, const BYTE* b, std::size_t len);
+
+/*
+	Bit range kernels for arbitrary bit offsets. Bits are numbered LSB first within a byte, as in
+	CBitVector::GetBitNoMask(). Only the bytes that contain bits of the source or destination range are accessed and
+	the bits of dst outside the range are left untouched. The ranges must not overlap.
+*/
+
+/** Set bits [dstpos, dstpos+len) of dst to bits [srcpos, srcpos+len) of src */
+void bit_copy(BYTE* dst, std::size_t dstpos, const BYTE* src, std::size_t srcpos, std::size_t len);
+/** XOR bits [srcpos, srcpos+len) of src onto bits [dstpos, dstpos+len) of dst */
+void bit_xor(BYTE* dst, std::size_t dstpos, const BYTE* src, std::size_t srcpos, std::size_t len);
+
+/*
+	Shifts and rotations of the bit range [pos, pos+len) of p in place, with bits numbered as in bit_copy(). Left moves
+	bits to higher positions, i.e., bit pos+i moves to pos+i+k, which multiplies the range read as a polynomial over GF(2)
+	with bit pos+i as coefficient of x^i by x^k. Shifts fill in zeros and drop the bits that leave the range, k may
+	exceed len. Bits outside the range are left untouched.
+*/
+
+void bit_shift_left(BYTE* p, std::size_t pos, std::size_t len, std::size_t k);
+void bit_shift_right(BYTE* p, std::size_t pos, std::size_t len, std::size_t k);
+void bit_rotate_left(BYTE* p, std::size_t pos, std::size_t len, std::size_t k);
+void bit_rotate_right(BYTE* p, std::size_t pos, std::size_t len, std::size_t k);
+
+/*
+	Transposition of bit matrices that are stored densely row by row in CBitVector::GetBit() order (MSB first), i.e.,
+	bit (i, j) of a rows x columns matrix is at position i * columns + j. Bits of the last byte beyond the matrix are
+	left untouched. Tiles are split across nthreads threads, 0 uses all hardware threads.
+*/
+
+/** Transpose the rows x columns matrix src into the columns x rows matrix dst, dst must not overlap src */
+void bit_transpose(BYTE* dst, const BYTE* src, std::size_t rows, std::size_t columns, uint32_t nthreads = 1);
+/** Transpose the n x n matrix mat in place. Only byte-aligned matrices, i.e., n a multiple of 8, use threads. */
+void bit_transpose_square(BYTE* mat, std::size_t n, uint32_t nthreads = 1);
+
+/*
+	Bit slicing of n packed elements of bitlen <= 64 bits that start at bit 0, numbered as in unpack_bits(). Plane b holds
+	bit b of all elements: bit i of plane b, numbered as in bit_copy(), is bit b of element i. Plane b starts at byte
+	b * stride with stride >= ceil(n / 8). Bits of the planes and of the packed array after the n elements are left
+	untouched. Blocks of 64 elements are transposed with movemask kernels and split across nthreads threads, 0 uses all
+	hardware threads.
+*/
+
+/** Slice the elements of src into bitlen planes */
+void bit_slice(BYTE* planes, std::size_t stride, const BYTE* src, std::size_t bitlen, std::size_t n, uint32_t nthreads = 1);
+/** Combine bitlen planes into the packed elements of dst */
+void bit_unslice(BYTE* dst, const BYTE* planes, std::size_t stride, std::size_t bitlen, std::size_t n,
+		uint32_t nthreads = 1);
+
+/*
+	XOR of selected rows of a database of nrows rows of rowbytes bytes each, e.g., for PIR or DPF evaluation. Selection
+	s consists of the bits [s * selstride, s * selstride + nrows) of sel, numbered as in bit_copy(), and the XOR of the
+	rows i for which bit i of the selection is set is added to row s of dst, which has nsel rows of rowbytes bytes.
+	Blocks of rows are split across nthreads threads, 0 uses all hardware threads.
+*/
+void xor_selected_rows(BYTE* dst, const BYTE* rows, std::size_t rowbytes, std::size_t nrows, const BYTE* sel,
+		std::size_t selstride, std::size_t nsel, uint32_t nthreads = 1);
+
+/*
+	Packed elements of bitlen bits each that are stored back to back from bit pos on, with bits numbered as in
+	bit_copy(), i.e., element i occupies bits [pos + i * bitlen, pos + (i + 1) * bitlen). The unpacked elements are
+	unsigned integers of width 1, 2, 4 or 8 bytes and bitlen is at most 8 * width.
+*/
+
+/** Unpack n elements from src into the n integers of dst, zero-extended */
+void unpack_bits(void* dst, std::size_t width, const BYTE* src, std::size_t pos, std::size_t bitlen, std::size_t n);
+/** Pack the lower bitlen bits of the n integers of src into dst, the bits of dst around the elements are left untouched */
+void pack_bits(BYTE* dst, std::size_t pos, const void* src, std::size_t width, std::size_t bitlen, std::size_t n);
+
+/*
+	Arithmetic modulo 2^bitlen on n packed elements of bitlen <= 64 bits that start at bit 0. dst may be equal to a or
+	b, the bits of dst after the last element are left untouched.
+*/
+
+/** dst = a + b */
+void add_elements(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t bitlen, std::size_t n);
+/** dst = a - b */
+void sub_elements(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t bitlen, std::size_t n);
+/** dst = a * b */
+void mul_elements(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t bitlen, std::size_t n);
+/** dst = a * s */
+void mul_scalar_elements(BYTE* dst, const BYTE* a, uint64_t s, std::size_t bitlen, std::size_t n);
+
+/*
+	The same for a bit length L that is known at compile time and elements that start at the first bit of src / dst.
+	Eight elements span L bytes, so within such a group all offsets, shifts and masks are constants. The remaining
+	elements are left to the kernels above.
+*/
+
+template<std::size_t L, class T> void unpack_bits(T* dst, const BYTE* src, std::size_t n) {
+	static_assert(L >= 1 && L <= 8 * sizeof(T) && L <= 64, "element does not fit into T");
+	constexpr uint64_t mask = L == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << L) - 1;
+	std::size_t nbytes = (n * L + 7) / 8;
+	std::size_t i = 0;
+	//the last element of a group reads up to 9 bytes from byte 7 * L / 8 of the group on
+	for (; i + 8 <= n && (i + 7) * L / 8 + 9 <= nbytes; i += 8, src += L) {
+#pragma GCC unroll 8
+		for (std::size_t j = 0; j < 8; j++) {
+			uint64_t w;
+			memcpy(&w, src + j * L / 8, sizeof(w));
+			w >>= j * L % 8;
+			if (j * L % 8 + L > 64) {
+				w |= (uint64_t) src[j * L / 8 + 8] << (64 - j * L % 8);
+			}
+			dst[i + j] = w & mask;
+		}
+	}
+	unpack_bits(dst + i, sizeof(T), src, 0, L, n - i);
+}
+
+template<std::size_t L, class T> void pack_bits(BYTE* dst, const T* src, std::size_t n) {
+	static_assert(L >= 1 && L <= 8 * sizeof(T) && L <= 64, "element does not fit into T");
+	constexpr uint64_t mask = L == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << L) - 1;
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8, dst += L) {
+		uint64_t acc = 0;
+		std::size_t nacc = 0, out = 0;
+#pragma GCC unroll 8
+		for (std::size_t j = 0; j < 8; j++) {
+			uint64_t v = src[i + j] & mask;
+			acc |= v << nacc;
+			nacc += L;
+			if (nacc >= 64) {
+				memcpy(dst + out, &acc, sizeof(acc));
+				out += 8;
+				nacc -= 64;
+				acc = nacc ? v >> (L - nacc) : 0;
+			}
+		}
+		//a group ends on a byte boundary
+		memcpy(dst + out, &acc, nacc / 8);
+	}
+	pack_bits(dst, 0, src + i, sizeof(T), L, n - i);
+}
+
+#endif /* __BITKERNELS_H__ */
@@ -17,6 +17,8 @@
  */
 
 #include "cbitvector.h"
+#include "bitkernels.h"
+#include "cbitvector_allocator.h"
 #include "crypto/crypto.h"
 #include "utils.h"
 #include <algorithm>
@@ -40,21 +42,9 @@ constexpr BYTE REVERSE_BYTE_ORDER[256] = { 0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0
 		0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF };
 
 /**
-	This array is used by \link XORBits(BYTE* p, int pos, int len) \endlink and \link SetBits(BYTE* p, uint64_t pos, uint64_t len) \endlink
-    method for lower bit mask.
+	This array is used by \link GetBits(BYTE* p, int pos, int len) \endlink method for masking the unused bits of the last byte.
 */
 constexpr BYTE RESET_BIT_POSITIONS[9] = { 0x00, 0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F, 0xFF };
-/**
-	This array is used by \link XORBits(BYTE* p, int pos, int len) \endlink and \link SetBits(BYTE* p, uint64_t pos, uint64_t len) \endlink
-    method for upper bit mask.
-*/
-constexpr BYTE RESET_BIT_POSITIONS_INV[9] = { 0x00, 0x80, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC, 0xFE, 0xFF };
-
-/** This array is used by \link GetBits(BYTE* p, int pos, int len) \endlink method for lower bit mask. */
-constexpr BYTE GET_BIT_POSITIONS[9] = { 0xFF, 0xFE, 0xFC, 0xF8, 0xF0, 0xE0, 0xC0, 0x80, 0x00 };
-
-/** This array is used by \link GetBits(BYTE* p, int pos, int len) \endlink method for upper bit mask. */
-constexpr BYTE GET_BIT_POSITIONS_INV[9] = { 0xFF, 0x7F, 0x3F, 0x1F, 0x0F, 0x07, 0x03, 0x01, 0x00 };
 
 /**
 	This array is used for masking bits and extracting a particular positional bit from the provided byte array.
@@ -123,26 +113,38 @@ template<class T> void SetBytes(T* dst, const T* src, const T* lim) {
 	}
 }
 
-//Generic bytewise XOR operation
-template<class T> void XORBytes(T* dst, const T* src, const T* lim) {
-	while (dst != lim) {
-		*dst++ ^= *src++;
-	}
+constexpr BYTE GetArrayBit(const BYTE* p, size_t idx) {
+	return 0 != (p[idx >> 3] & BIT[idx & 0x7]);
 }
 
-template<class T> void ANDBytes(T* dst, const T* src, const T* lim) {
-	while (dst != lim) {
-		*dst++ &= *src++;
-	}
-}
+constexpr std::size_t MAX_RND_CHUNK_BYTES = 1 << 30;
 
-constexpr BYTE GetArrayBit(const BYTE* p, size_t idx) {
-	return 0 != (p[idx >> 3] & BIT[idx & 0x7]);
+//Ones in bits [pos, pos+len) of a, or of a ^ b, in GetBit() order, i.e., MSB first within a byte
+template<bool HAMMING> std::size_t count_bits(const BYTE* a, const BYTE* b, std::size_t pos, std::size_t len) {
+	if (len == 0) {
+		return 0;
+	}
+	std::size_t first = pos >> 3;
+	std::size_t last = (pos + len - 1) >> 3;
+	BYTE headmask = 0xFF >> (pos & 0x07);
+	BYTE tailmask = 0xFF << (7 - ((pos + len - 1) & 0x07));
+	auto byte = [&] (std::size_t i) -> BYTE { return HAMMING ? a[i] ^ b[i] : a[i]; };
+	if (first == last) {
+		return __builtin_popcount(byte(first) & headmask & tailmask);
+	}
+	std::size_t count = __builtin_popcount(byte(first) & headmask) + __builtin_popcount(byte(last) & tailmask);
+	if (HAMMING) {
+		return count + hamming_bytes(a + first + 1, b + first + 1, last - first - 1);
+	}
+	return count + popcount_bytes(a + first + 1, last - first - 1);
 }
 
 } // namespace
 
 
+//constant-initialized, such that CBitVectors with static storage duration can be constructed in any order
+CBitVectorAllocator* CBitVector::s_cDefaultAllocator = NULL;
+
 CBitVector::CBitVector() {
 	Init();
 }
@@ -157,9 +159,39 @@ CBitVector::CBitVector(std::size_t bits, crypto* crypt) {
 	Create(bits, crypt);
 }
 
+CBitVector::CBitVector(CBitVector&& other) noexcept
+	: m_pBits(other.m_pBits), m_cAllocator(other.m_cAllocator), m_cBufAllocator(other.m_cBufAllocator),
+	m_nByteSize(other.m_nByteSize), m_nCapacity(other.m_nCapacity), m_nBits(other.m_nBits), m_nElementLength(other.m_nElementLength),
+	m_nNumElements(other.m_nNumElements), m_nNumElementsDimB(other.m_nNumElementsDimB) {
+	other.m_pBits = NULL;
+	other.m_nByteSize = 0;
+	other.m_nCapacity = 0;
+}
+
+CBitVector& CBitVector::operator=(CBitVector&& other) noexcept {
+	if (this != &other) {
+		delCBitVector();
+		m_pBits = other.m_pBits;
+		m_cBufAllocator = other.m_cBufAllocator;
+		m_nByteSize = other.m_nByteSize;
+		m_nCapacity = other.m_nCapacity;
+		m_nBits = other.m_nBits;
+		m_nElementLength = other.m_nElementLength;
+		m_nNumElements = other.m_nNumElements;
+		m_nNumElementsDimB = other.m_nNumElementsDimB;
+		other.m_pBits = NULL;
+		other.m_nByteSize = 0;
+		other.m_nCapacity = 0;
+	}
+	return *this;
+}
+
 void CBitVector::Init() {
 	m_pBits = NULL;
 	m_nByteSize = 0;
+	m_nCapacity = 0;
+	m_cAllocator = GetDefaultAllocator();
+	m_cBufAllocator = m_cAllocator;
 }
 
 CBitVector::~CBitVector(){
@@ -167,33 +199,78 @@ CBitVector::~CBitVector(){
 };
 
 void CBitVector::delCBitVector() {
-	if (( m_nByteSize > 0 )&& (m_pBits != NULL)) {
-		free(m_pBits);
+	if (( m_nCapacity > 0 )&& (m_pBits != NULL)) {
+		m_cBufAllocator->Deallocate(m_pBits, m_nCapacity);
 	}
 	m_nByteSize = 0;
+	m_nCapacity = 0;
 	m_pBits = NULL;
 }
 
+void CBitVector::SetAllocator(CBitVectorAllocator* allocator) {
+	m_cAllocator = allocator;
+}
+
+CBitVectorAllocator* CBitVector::GetAllocator() const {
+	return m_cAllocator;
+}
+
+void CBitVector::SetDefaultAllocator(CBitVectorAllocator* allocator) {
+	s_cDefaultAllocator = allocator;
+}
+
+CBitVectorAllocator* CBitVector::GetDefaultAllocator() {
+	if (s_cDefaultAllocator == NULL) {
+		return AlignedAllocator::Instance();
+	}
+	return s_cDefaultAllocator;
+}
+
 /* Fill random values using the pre-defined AES key */
 void CBitVector::FillRand(std::size_t bits, crypto* crypt) {
-	if (bits > m_nByteSize << 3)
-		Create(bits);
-	crypt->gen_rnd(m_pBits, ceil_divide(bits, 8));
+	if (bits > m_nByteSize << 3) {
+		Create(bits, crypt);
+		return;
+	}
+	//gen_rnd takes 32-bit lengths, the chunks are multiples of AES_BYTES such that the output equals a single call
+	std::size_t nbytes = ceil_divide(bits, 8);
+	for (std::size_t pos = 0; pos < nbytes; pos += MAX_RND_CHUNK_BYTES) {
+		crypt->gen_rnd(m_pBits + pos, std::min(nbytes - pos, MAX_RND_CHUNK_BYTES));
+	}
+}
+
+void CBitVector::FillRand(std::size_t bits, crypto* crypt, uint32_t nthreads) {
+	std::size_t nbytes = ceil_divide(bits, 8);
+	if (bits > m_nByteSize << 3) {
+		CreateUninitialized(bits);
+		memset(m_pBits + nbytes, 0, m_nByteSize - nbytes);
+	}
+	crypt->gen_rnd_parallel(m_pBits, nbytes, nthreads);
 }
 
 void CBitVector::CreateExact(std::size_t bits) {
+	CreateExact(bits, true);
+}
+
+void CBitVector::CreateExact(std::size_t bits, bool zero) {
 	if (bits == 0){
 		bits = AES_BITS;
 	}
 
-	// if memory was previously allocated: free it
-	if (m_nByteSize > 0) {
-		free(m_pBits);
+	std::size_t bytes = ceil_divide(bits, 8);
+	if (bytes <= m_nCapacity && m_cBufAllocator == m_cAllocator) {
+		if (zero) {
+			memset(m_pBits, 0, bytes);
+		}
+	} else {
+		// if memory was previously allocated: free it
+		delCBitVector();
+		m_pBits = m_cAllocator->Allocate(bytes, zero);
+		m_cBufAllocator = m_cAllocator;
+		m_nCapacity = bytes;
+		assert(m_pBits != NULL);
 	}
-
-	m_nByteSize = ceil_divide(bits, 8);
-	m_pBits = (BYTE*) calloc(m_nByteSize, sizeof(BYTE));
-	assert(m_pBits != NULL);
+	m_nByteSize = bytes;
 
 	m_nElementLength = 1;
 	m_nNumElements = m_nByteSize;
@@ -205,6 +282,10 @@ void CBitVector::Create(std::size_t bits) {
 	CreateExact(ceil_divide(bits, AES_BITS) * AES_BITS);
 }
 
+void CBitVector::CreateUninitialized(std::size_t bits) {
+	CreateExact(ceil_divide(bits, AES_BITS) * AES_BITS, false);
+}
+
 void CBitVector::CreateBytes(std::size_t bytes) {
 	Create(bytes << 3);
 }
@@ -213,13 +294,16 @@ void CBitVector::CreateBytes(std::size_t bytes, crypto* crypt) {
 	Create(bytes << 3, crypt);
 }
 
+//Create() already zeroes the buffer
 void CBitVector::CreateZeros(std::size_t bits) {
 	Create(bits);
-	memset(m_pBits, 0, m_nByteSize);
 }
 
+//every byte is written once, either with randomness or as zero padding
 void CBitVector::Create(std::size_t bits, crypto* crypt) {
-	Create(bits);
+	CreateUninitialized(bits);
+	std::size_t nbytes = ceil_divide(bits, 8);
+	memset(m_pBits + nbytes, 0, m_nByteSize - nbytes);
 	FillRand(bits, crypt);
 }
 
@@ -251,15 +335,47 @@ void CBitVector::Create(std::size_t numelementsDimA, std::size_t numelementsDimB
 }
 
 void CBitVector::ResizeinBytes(std::size_t newSizeBytes) {
-	BYTE* tBits = m_pBits;
-	uint64_t tSize = (m_nByteSize<newSizeBytes)? m_nByteSize:newSizeBytes; //fix for overflow condition in memcpy.
-
+	if (newSizeBytes > m_nCapacity) {
+		Reallocate(std::max(newSizeBytes, 2 * m_nCapacity));
+	}
+	if (newSizeBytes > m_nByteSize) {
+		memset(m_pBits + m_nByteSize, 0, newSizeBytes - m_nByteSize);
+	}
 	m_nByteSize = newSizeBytes;
-	m_pBits = (uint8_t*) calloc(m_nByteSize, sizeof(uint8_t));
+}
 
-	memcpy(m_pBits, tBits, tSize);
+void CBitVector::Reserve(std::size_t bytes) {
+	if (bytes > m_nCapacity) {
+		Reallocate(bytes);
+	}
+}
 
-	free(tBits);
+std::size_t CBitVector::GetCapacity() const {
+	return m_nCapacity;
+}
+
+void CBitVector::ShrinkToFit() {
+	if (m_nCapacity > m_nByteSize) {
+		Reallocate(m_nByteSize);
+	}
+}
+
+void CBitVector::Reallocate(std::size_t capacity) {
+	BYTE* buf = NULL;
+	if (capacity > 0) {
+		buf = m_cAllocator->Allocate(capacity, false);
+		assert(buf != NULL);
+		if (m_pBits != NULL) {
+			memcpy(buf, m_pBits, std::min(m_nByteSize, capacity));
+		}
+	}
+	if (m_nCapacity > 0 && m_pBits != NULL) {
+		m_cBufAllocator->Deallocate(m_pBits, m_nCapacity);
+	}
+	m_pBits = buf;
+	m_nCapacity = capacity;
+	m_nByteSize = std::min(m_nByteSize, capacity);
+	m_cBufAllocator = m_cAllocator;
 }
 
 void CBitVector::Reset() {
@@ -277,9 +393,7 @@ void CBitVector::SetToOne() {
 }
 
 void CBitVector::Invert() {
-	for(std::size_t i = 0; i < m_nByteSize; i++) {
-		m_pBits[i] = ~m_pBits[i];
-	}
+	invert_bytes(m_pBits, m_nByteSize);
 }
 
 std::size_t CBitVector::GetSize() const {
@@ -291,13 +405,7 @@ BOOL CBitVector::IsEqual(const CBitVector& vec) const {
 		return false;
 	}
 
-	const BYTE* ptr = vec.GetArr();
-	for (std::size_t i = 0; i < m_nByteSize; i++) {
-		if (ptr[i] != m_pBits[i]) {
-			return false;
-		}
-	}
-	return true;
+	return equal_bytes(vec.GetArr(), m_pBits, m_nByteSize);
 }
 
 BOOL CBitVector::IsEqual(const CBitVector& vec, std::size_t from, std::size_t to) const {
@@ -305,7 +413,18 @@ BOOL CBitVector::IsEqual(const CBitVector& vec, std::size_t from, std::size_t to
 		return false;
 	}
 
-	for (std::size_t i = from; i < to; i++) {
+	//compare the bits up to the first full byte and after the last full byte individually
+	std::size_t frombyte = std::min(ceil_divide(from, 8), to / 8);
+	std::size_t tobyte = std::max(frombyte, to / 8);
+	for (std::size_t i = from; i < std::min(frombyte * 8, to); i++) {
+		if (vec.GetBit(i) != GetBit(i)) {
+			return false;
+		}
+	}
+	if (!equal_bytes(vec.GetArr() + frombyte, m_pBits + frombyte, tobyte - frombyte)) {
+		return false;
+	}
+	for (std::size_t i = std::max(tobyte * 8, from); i < to; i++) {
 		if (vec.GetBit(i) != GetBit(i)) {
 			return false;
 		}
@@ -313,6 +432,25 @@ BOOL CBitVector::IsEqual(const CBitVector& vec, std::size_t from, std::size_t to
 	return true;
 }
 
+std::size_t CBitVector::PopCount() const {
+	return popcount_bytes(m_pBits, m_nByteSize);
+}
+
+std::size_t CBitVector::PopCount(std::size_t pos, std::size_t len) const {
+	assert(pos + len <= m_nByteSize << 3);
+	return count_bits<false>(m_pBits, NULL, pos, len);
+}
+
+std::size_t CBitVector::HammingDistance(const CBitVector& vec) const {
+	assert(vec.GetSize() == m_nByteSize);
+	return hamming_bytes(m_pBits, vec.GetArr(), m_nByteSize);
+}
+
+std::size_t CBitVector::HammingDistance(const CBitVector& vec, std::size_t pos, std::size_t len) const {
+	assert(pos + len <= m_nByteSize << 3 && pos + len <= vec.GetSize() << 3);
+	return count_bits<true>(m_pBits, vec.GetArr(), pos, len);
+}
+
 void CBitVector::SetElementLength(std::size_t elelen) {
 	m_nElementLength = elelen;
 }
@@ -404,27 +542,13 @@ void CBitVector::GetBits(BYTE* p, std::size_t pos, std::size_t len) const {
 		return;
 	}
 
-	int posctr = pos >> 3;
-	int lowermask = pos & 7;
-	int uppermask = 8 - lowermask;
-
-	std::size_t i;
-	for (i = 0; i < len / (sizeof(BYTE) * 8); i++, posctr++) {
-		p[i] = ((m_pBits[posctr] & GET_BIT_POSITIONS[lowermask]) >> lowermask) & 0xFF;
-		p[i] |= (m_pBits[posctr + 1] & GET_BIT_POSITIONS_INV[uppermask]) << uppermask;
-	}
-	int remlen = len & 0x07;
-	if (remlen) {
-		if (remlen <= uppermask) {
-			p[i] = ((m_pBits[posctr] & ((((1 << remlen) - 1) << lowermask))) >> lowermask) & 0xFF;
-		} else {
-			p[i] = ((m_pBits[posctr] & GET_BIT_POSITIONS[lowermask]) >> lowermask) & 0xFF;
-			p[i] |= (m_pBits[posctr + 1] & (((1 << (remlen - uppermask)) - 1))) << uppermask;
-		}
+	bit_copy(p, 0, m_pBits, pos, len);
+	//unused bits of the last byte are zero
+	if (len & 0x07) {
+		p[len >> 3] &= RESET_BIT_POSITIONS[len & 0x07];
 	}
 }
 
-
 //optimized bytewise for set operation
 void CBitVector::GetBytes(BYTE* p, std::size_t pos, std::size_t len) const {
 	assert(pos+len <= m_nByteSize);
@@ -452,37 +576,13 @@ void CBitVector::SetBits(const BYTE* p, std::size_t pos, std::size_t len) {
 		SetBytes(p, pos >> 3, len >> 3);
 		return;
 	}
-	std::size_t posctr = pos >> 3;
-	int lowermask = pos & 7;
-	int uppermask = 8 - lowermask;
-
-	std::size_t i;
-	BYTE temp;
-	for (i = 0; i < len / (sizeof(BYTE) * 8); i++, posctr++) {
-		temp = p[i];
-		m_pBits[posctr] = (m_pBits[posctr] & RESET_BIT_POSITIONS[lowermask]) | ((temp << lowermask) & 0xFF);
-		m_pBits[posctr + 1] = (m_pBits[posctr + 1] & RESET_BIT_POSITIONS_INV[uppermask]) | (temp >> uppermask);
-	}
-	int remlen = len & 0x07;
-	if (remlen) {
-		temp = p[i] & RESET_BIT_POSITIONS[remlen];
-		if (remlen <= uppermask) {
-			m_pBits[posctr] = (m_pBits[posctr] & (~(((1 << remlen) - 1) << lowermask))) | ((temp << lowermask) & 0xFF);
-		} else {
-			m_pBits[posctr] = (m_pBits[posctr] & RESET_BIT_POSITIONS[lowermask]) | ((temp << lowermask) & 0xFF);
-			m_pBits[posctr + 1] = (m_pBits[posctr + 1] & (~(((1 << (remlen - uppermask)) - 1)))) | (temp >> uppermask);
-		}
-	}
+	bit_copy(m_pBits, pos, p, 0, len);
 }
 
-
 //Set bits given an offset on the bits for p which is not necessarily divisible by 8
 void CBitVector::SetBitsPosOffset(const BYTE* p, std::size_t ppos, std::size_t pos, std::size_t len) {
-	for (auto i = pos, j = ppos; j < ppos + len; i++, j++) {
-		BYTE source_bit = GetArrayBit(p, j);
-		SetBitNoMask(i, source_bit);
-
-	}
+	assert((pos + len) <= (m_nByteSize<<3));
+	bit_copy(m_pBits, pos, p, ppos, len);
 }
 
 //optimized bytewise for set operation
@@ -524,13 +624,7 @@ void CBitVector::XORBytes(const BYTE* p, std::size_t pos, std::size_t len) {
 	std::cout << "pos = " << pos << ", len = " << len << ", bytesize = " << m_nByteSize << std::endl;
 	assert(pos + len <= m_nByteSize);
 
-	BYTE* dst = m_pBits + pos;
-	const BYTE* src = p;
-	//Do many operations on REGSIZE types first and then (if necessary) use bytewise operations
-	::XORBytes((REGSIZE*) dst, (REGSIZE*) src, ((REGSIZE*) dst) + (len >> SHIFTVAL));
-	dst += ((len >> SHIFTVAL) << SHIFTVAL);
-	src += ((len >> SHIFTVAL) << SHIFTVAL);
-	::XORBytes(dst, src, dst + (len & ((1 << SHIFTVAL) - 1)));
+	xor_bytes(m_pBits + pos, p, len);
 }
 
 void CBitVector::XORBytes(const BYTE* p, std::size_t len) {
@@ -553,35 +647,13 @@ void CBitVector::XORBits(const BYTE* p, std::size_t pos, std::size_t len) {
 		XORBytes(p, pos >> 3, len >> 3);
 		return;
 	}
-	int posctr = pos >> 3;
-	int lowermask = pos & 7;
-	int uppermask = 8 - lowermask;
-
-	std::size_t i;
-	BYTE temp;
-	for (i = 0; i < len / (sizeof(BYTE) * 8); i++, posctr++) {
-		temp = p[i];
-		m_pBits[posctr] ^= ((temp << lowermask) & 0xFF);
-		m_pBits[posctr + 1] ^= (temp >> uppermask);
-	}
-	int remlen = len & 0x07;
-	if (remlen) {
-		temp = p[i] & RESET_BIT_POSITIONS[remlen];
-		if (remlen <= uppermask) {
-			m_pBits[posctr] ^= ((temp << lowermask) & 0xFF);
-		} else {
-			m_pBits[posctr] ^= ((temp << lowermask) & 0xFF);
-			m_pBits[posctr + 1] ^= (temp >> uppermask);
-		}
-	}
+	bit_xor(m_pBits, pos, p, 0, len);
 }
 
 //XOR bits given an offset on the bits for p which is not necessarily divisible by 8
 void CBitVector::XORBitsPosOffset(const BYTE* p, std::size_t ppos, std::size_t pos, std::size_t len) {
 	assert((pos + len) <= (m_nByteSize<<3));
-	for (auto i = pos, j = ppos; j < ppos + len; i++, j++) {
-		m_pBits[i / 8] ^= (((p[j / 8] & (1 << (j % 8))) >> j % 8) << i % 8);
-	}
+	bit_xor(m_pBits, pos, p, ppos, len);
 }
 
 //Method for directly XORing CBitVectors
@@ -604,23 +676,27 @@ void CBitVector::XORBytesReverse(const BYTE* p, std::size_t pos, std::size_t len
 //optimized bytewise for AND operation
 void CBitVector::ANDBytes(const BYTE* p, std::size_t pos, std::size_t len) {
 	assert(pos+len <= m_nByteSize);
-	BYTE* dst = m_pBits + pos;
-	const BYTE* src = p;
-	//Do many operations on REGSIZE types first and then (if necessary) use bytewise operations
-	::ANDBytes((REGSIZE*) dst, (REGSIZE*) src, ((REGSIZE*) dst) + (len >> SHIFTVAL));
-	dst += ((len >> SHIFTVAL) << SHIFTVAL);
-	src += ((len >> SHIFTVAL) << SHIFTVAL);
-	::ANDBytes(dst, src, dst + (len & ((1 << SHIFTVAL) - 1)));
+
+	and_bytes(m_pBits + pos, p, len);
 }
 
 void CBitVector::SetXOR(const BYTE* p, const BYTE* q, std::size_t pos, std::size_t len) {
-	Copy(p, pos, len);
-	XORBytes(q, pos, len);
+	if (pos + len > m_nByteSize) {
+		//grow the vector like Copy() does
+		Copy(p, pos, len);
+		XORBytes(q, pos, len);
+		return;
+	}
+	set_xor_bytes(m_pBits + pos, p, q, len);
 }
 
 void CBitVector::SetAND(const BYTE* p, const BYTE* q, std::size_t pos, std::size_t len) {
-	Copy(p, pos, len);
-	ANDBytes(q, pos, len);
+	if (pos + len > m_nByteSize) {
+		Copy(p, pos, len);
+		ANDBytes(q, pos, len);
+		return;
+	}
+	set_and_bytes(m_pBits + pos, p, q, len);
 }
 
 //Method for directly ANDing CBitVectors
@@ -629,14 +705,86 @@ void CBitVector::AND(const CBitVector* b) {
 	ANDBytes(b->GetArr(), 0, m_nByteSize);
 }
 
+void CBitVector::SetAdd(const CBitVector* a, const CBitVector* b) {
+	assert(IsArithOperand(a) && IsArithOperand(b));
+	add_elements(m_pBits, a->GetArr(), b->GetArr(), m_nElementLength, (m_nByteSize << 3) / m_nElementLength);
+}
+
+void CBitVector::SetSub(const CBitVector* a, const CBitVector* b) {
+	assert(IsArithOperand(a) && IsArithOperand(b));
+	sub_elements(m_pBits, a->GetArr(), b->GetArr(), m_nElementLength, (m_nByteSize << 3) / m_nElementLength);
+}
+
+void CBitVector::SetMul(const CBitVector* a, const CBitVector* b) {
+	assert(IsArithOperand(a) && IsArithOperand(b));
+	mul_elements(m_pBits, a->GetArr(), b->GetArr(), m_nElementLength, (m_nByteSize << 3) / m_nElementLength);
+}
+
+void CBitVector::SetMulScalar(const CBitVector* a, uint64_t s) {
+	assert(IsArithOperand(a));
+	mul_scalar_elements(m_pBits, a->GetArr(), s, m_nElementLength, (m_nByteSize << 3) / m_nElementLength);
+}
+
+void CBitVector::Add(const CBitVector* b) {
+	SetAdd(this, b);
+}
+
+void CBitVector::Sub(const CBitVector* b) {
+	SetSub(this, b);
+}
+
+void CBitVector::Mul(const CBitVector* b) {
+	SetMul(this, b);
+}
+
+void CBitVector::MulScalar(uint64_t s) {
+	SetMulScalar(this, s);
+}
+
+bool CBitVector::IsArithOperand(const CBitVector* vec) const {
+	return vec->GetSize() == m_nByteSize && vec->GetElementLength() == m_nElementLength && m_nElementLength >= 1
+			&& m_nElementLength <= 64;
+}
+
 //Cyclic left shift by pos bits
 void CBitVector::CLShift(std::size_t pos) {
-	uint8_t* tmpbuf = (uint8_t*) malloc(m_nByteSize);
-	for(std::size_t i = 0; i < m_nByteSize; i++) {
-		tmpbuf[i+pos] = m_pBits[i];
-	}
-	free(m_pBits);
-	m_pBits = tmpbuf;
+	RotateLeft(pos);
+}
+
+void CBitVector::ShiftLeft(std::size_t k) {
+	bit_shift_left(m_pBits, 0, m_nByteSize << 3, k);
+}
+
+void CBitVector::ShiftLeft(std::size_t k, std::size_t pos, std::size_t len) {
+	assert(pos + len <= m_nByteSize << 3);
+	bit_shift_left(m_pBits, pos, len, k);
+}
+
+void CBitVector::ShiftRight(std::size_t k) {
+	bit_shift_right(m_pBits, 0, m_nByteSize << 3, k);
+}
+
+void CBitVector::ShiftRight(std::size_t k, std::size_t pos, std::size_t len) {
+	assert(pos + len <= m_nByteSize << 3);
+	bit_shift_right(m_pBits, pos, len, k);
+}
+
+void CBitVector::RotateLeft(std::size_t k) {
+	bit_rotate_left(m_pBits, 0, m_nByteSize << 3, k);
+}
+
+void CBitVector::RotateLeft(std::size_t k, std::size_t pos, std::size_t len) {
+	assert(pos + len <= m_nByteSize << 3);
+	bit_rotate_left(m_pBits, pos, len, k);
+}
+
+void CBitVector::RotateRight(std::size_t k) {
+	bit_rotate_right(m_pBits, 0, m_nByteSize << 3, k);
+}
+
+void CBitVector::RotateRight(std::size_t k, std::size_t pos, std::size_t len) {
+	assert(pos + len <= m_nByteSize << 3);
+	bit_rotate_right(m_pBits, pos, len, k);
 }
 
 BYTE* CBitVector::GetArr() {
@@ -650,6 +798,9 @@ const BYTE* CBitVector::GetArr() const {
 void CBitVector::AttachBuf(BYTE* p, std::size_t size) {
 	m_pBits = p;
 	m_nByteSize = size;
+	m_nCapacity = size;
+	//attached buffers are released with free(), unless they are detached again
+	m_cBufAllocator = MallocAllocator::Instance();
 }
 
 
@@ -658,6 +809,7 @@ void CBitVector::AttachBuf(BYTE* p, std::size_t size) {
 void CBitVector::DetachBuf() {
 	m_pBits = NULL;
 	m_nByteSize = 0;
+	m_nCapacity = 0;
 }
 
 
@@ -725,17 +877,65 @@ void CBitVector::PrintBinaryMasked(std::size_t from, std::size_t to) {
 	std::cout << std::endl;
 }
 
-void CBitVector::Transpose(std::size_t rows, std::size_t columns) {
+//Planes that do not end on a byte boundary are sliced with a byte-aligned stride and moved together afterwards
+void CBitVector::BitSlice(CBitVector& planes, std::size_t bitlen, std::size_t n, uint32_t nthreads) const {
+	assert(&planes != this && n * bitlen <= m_nByteSize << 3);
+	planes.CreateExact(n * bitlen);
+	if ((n & 7) == 0) {
+		bit_slice(planes.m_pBits, n / 8, m_pBits, bitlen, n, nthreads);
+		return;
+	}
+	std::size_t stride = ceil_divide(n, 8);
+	BYTE* temp = (BYTE*) malloc(bitlen * stride);
+	bit_slice(temp, stride, m_pBits, bitlen, n, nthreads);
+	for (std::size_t b = 0; b < bitlen; b++) {
+		bit_copy(planes.m_pBits, b * n, temp + b * stride, 0, n);
+	}
+	free(temp);
+}
+
+void CBitVector::BitUnslice(const CBitVector& planes, std::size_t bitlen, std::size_t n, uint32_t nthreads) {
+	assert(&planes != this && n * bitlen <= planes.m_nByteSize << 3);
+	CreateExact(n * bitlen);
+	if ((n & 7) == 0) {
+		bit_unslice(m_pBits, planes.m_pBits, n / 8, bitlen, n, nthreads);
+		return;
+	}
+	std::size_t stride = ceil_divide(n, 8);
+	BYTE* temp = (BYTE*) malloc(bitlen * stride);
+	for (std::size_t b = 0; b < bitlen; b++) {
+		bit_copy(temp + b * stride, 0, planes.m_pBits, b * n, n);
+	}
+	bit_unslice(m_pBits, temp, stride, bitlen, n, nthreads);
+	free(temp);
+}
+
+void CBitVector::XORSelectedRows(CBitVector& result, std::size_t rowbytes, std::size_t nrows,
+		const CBitVector& selections, std::size_t nsel, uint32_t nthreads) const {
+	assert(&result != this && nrows * rowbytes <= m_nByteSize && nsel * nrows <= selections.m_nByteSize << 3);
+	result.CreateExact(nsel * rowbytes * 8);
+	xor_selected_rows(result.m_pBits, m_pBits, rowbytes, nrows, selections.m_pBits, nrows, nsel, nthreads);
+}
+
+void CBitVector::Transpose(std::size_t rows, std::size_t columns, uint32_t nthreads) {
 #ifdef SIMPLE_TRANSPOSE
 	SimpleTranspose(rows, columns);
-#else
+#elif defined(EKLUNDH_TRANSPOSE)
 	EklundhBitTranspose(rows, columns);
+#else
+	//without vector instructions, Eklundh's algorithm is faster for the shapes that it supports
+	bool pow2 = rows >= 64 && columns >= 64 && (rows & (rows - 1)) == 0 && (columns & (columns - 1)) == 0;
+	if (get_simd_level() == simd_level::scalar && nthreads == 1 && pow2) {
+		EklundhBitTranspose(rows, columns);
+	} else {
+		TiledTranspose(rows, columns, nthreads);
+	}
 #endif
 }
 
 void CBitVector::SimpleTranspose(std::size_t rows, std::size_t columns) {
 	CBitVector temp(rows * columns);
-	temp.Copy(m_pBits, 0, rows * columns / 8);
+	temp.Copy(m_pBits, 0, ceil_divide(rows * columns, 8));
 	for (std::size_t i = 0; i < rows; i++) {
 		for (std::size_t j = 0; j < columns; j++) {
 			SetBit(j * rows + i, temp.GetBit(i * columns + j));
@@ -743,6 +943,23 @@ void CBitVector::SimpleTranspose(std::size_t rows, std::size_t columns) {
 	}
 }
 
+void CBitVector::TiledTranspose(std::size_t rows, std::size_t columns, uint32_t nthreads) {
+	std::size_t bytes = ceil_divide(rows * columns, 8);
+	assert(bytes <= m_nByteSize);
+	if (rows == columns) {
+		bit_transpose_square(m_pBits, rows, nthreads);
+		return;
+	}
+	//transpose into a temporary and copy it back, such that attached buffers stay valid
+	BYTE* temp = (BYTE*) malloc(bytes);
+	if (bytes > 0) {
+		temp[bytes - 1] = m_pBits[bytes - 1];
+	}
+	bit_transpose(temp, m_pBits, rows, columns, nthreads);
+	memcpy(m_pBits, temp, bytes);
+	free(temp);
+}
+
 //A transposition algorithm for bit-matrices of size 2^i x 2^i
 void CBitVector::EklundhBitTranspose(std::size_t rows, std::size_t columns) {
 	REGISTER_SIZE* rowaptr;	//ptr;
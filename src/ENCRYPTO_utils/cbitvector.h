@@ -19,12 +19,16 @@
 #ifndef CBITVECTOR_H_
 #define CBITVECTOR_H_
 
+#include "bitkernels.h"
 #include "typedefs.h"
 #include <cassert>
 #include <cstddef>
+#include <vector>
 
 // forward declarations
 class crypto;
+class CBitVectorAllocator;
+template<class E> struct bit_expr;
 
 /** Class which defines the functionality of storing C-based Bits in vector type format.*/
 class CBitVector {
@@ -48,6 +52,31 @@ public:
 	 */
 	CBitVector(std::size_t bits, crypto* crypt);
 
+	/**
+		Move constructor, which takes over the buffer of other together with its allocator. other is left empty.
+	*/
+	CBitVector(CBitVector&& other) noexcept;
+
+	/**
+		Move assignment, which releases the own buffer and takes over the buffer of other together with the allocator
+		that owns it. The allocator for future allocations of this vector is kept. other is left empty.
+	*/
+	CBitVector& operator=(CBitVector&& other) noexcept;
+
+	//Copies would share the buffer
+	CBitVector(const CBitVector&) = delete;
+	CBitVector& operator=(const CBitVector&) = delete;
+
+	/**
+		Evaluate a bitwise expression of CBitVectors, e.g. dst = (a ^ b) & c, in a single pass. The vector is resized to
+		the size of the expression. Defined in cbitvector_expr.h, which provides the operators.
+	*/
+	template<class E> CBitVector& operator=(const bit_expr<E>& expr);
+	/** XOR / AND / OR the result of a bitwise expression of the same size onto the CBitVector */
+	template<class E> CBitVector& operator^=(const bit_expr<E>& expr);
+	template<class E> CBitVector& operator&=(const bit_expr<E>& expr);
+	template<class E> CBitVector& operator|=(const bit_expr<E>& expr);
+
 	//Constructor code ends here...
 
 	//Basic Primitive function of allocation and deallocation begins here.
@@ -67,6 +96,21 @@ public:
 		This method is used to deallocate the bit pointer and size explicitly. This method needs to be called by the programmer explicitly.
 	*/
 	void delCBitVector();
+
+	/**
+		Set the allocator for the following allocations of this CBitVector, the current buffer is still released to the
+		allocator that it was obtained from. The allocator has to outlive all buffers that it allocates.
+		\param	allocator	-	Allocation policy, see cbitvector_allocator.h.
+	*/
+	void SetAllocator(CBitVectorAllocator* allocator);
+	CBitVectorAllocator* GetAllocator() const;
+
+	/**
+		Set the allocator of CBitVectors that are constructed afterwards. Defaults to AlignedAllocator::Instance(), i.e.,
+		buffers that are aligned to cache lines. Not thread-safe.
+	*/
+	static void SetDefaultAllocator(CBitVectorAllocator* allocator);
+	static CBitVectorAllocator* GetDefaultAllocator();
 	//Basic Primitive function of allocation and deallocation ends here.
 
 
@@ -80,18 +124,36 @@ public:
 	*/
 	void FillRand(std::size_t bits, crypto* crypt);
 
+	/**
+		Parallel version of \link FillRand(std::size_t bits, crypto* crypt) \endlink, which splits the AES counter range
+		of crypt among threads that write disjoint parts of the vector. The result is the same as that of the sequential
+		version.
+
+		\param	nthreads - Number of threads, 0 uses all hardware threads.
+	*/
+	void FillRand(std::size_t bits, crypto* crypt, uint32_t nthreads);
+
 
 
 	/* Create in bits and bytes */
 	
 	/**
 		This method is used to create the CBitVector with the provided bits. The method creates a bit vector of exactly ceil_divide(bits) size.
-		For example, if bit size provided is 3 after this method is called it will be 8 bits = 1 byte.
+		For example, if bit size provided is 3 after this method is called it will be 8 bits = 1 byte. If the capacity of the current buffer
+		suffices and it was obtained from the current allocator, the buffer is zeroed and reused instead of being reallocated.
 
 		\param  bits	 - It is the number of bits which will be used to allocate the CBitVector with.
 	*/
 	void CreateExact(std::size_t bits);
 
+	/**
+		This method is used to create the CBitVector with the provided bits like \link Create(std::size_t bits) \endlink, but leaves the content
+		uninitialized. It is meant for vectors that are completely overwritten afterwards and avoids writing the memory twice.
+
+		\param  bits	 - It is the number of bits which will be used to allocate the CBitVector with.
+	*/
+	void CreateUninitialized(std::size_t bits);
+
 	/**
 		This method is used to create the CBitVector with the provided bits. The method creates a bit vector with a size close to AES Bitsize.
 		For example, if bit size provided is 110. After this method is called it will be 128 bits. It will perform a ceil of provided_bit_size
@@ -190,10 +252,24 @@ public:
 
 	/**
 		This method is used to resize the bytes allocated to CBitVector with newly provided size. And also accommodate the data from previous allocation to new one.
+		Bytes that are added are zero. The capacity grows at least by a factor of two and does not shrink, such that repeated resizes take
+		amortized constant time per byte.
 		\param newSizeBytes		-	This variable provides the new size to which the cbitvector needs to be modified to user's needs.
 	*/
 	void ResizeinBytes(std::size_t newSizeBytes);
 
+	/**
+		Make sure that the buffer can hold at least the given number of bytes without reallocation. The size is not changed.
+		\param bytes	-	The capacity in bytes.
+	*/
+	void Reserve(std::size_t bytes);
+
+	/** \return the number of bytes that the buffer can hold without reallocation. */
+	std::size_t GetCapacity() const;
+
+	/** Release the capacity beyond the current size. */
+	void ShrinkToFit();
+
 	/**
 		This method is used to reset the values in the given CBitVector. This method sets all bit values to zeros. This is a slight variant of the method
 		\link CreateZeros(std::size_t bits) \endlink. The create method mentioned above allocates and sets value to zero. Whereas the provided method only
@@ -241,6 +317,36 @@ public:
 	*/
 	BOOL IsEqual(const CBitVector& vec, std::size_t from, std::size_t to) const;
 
+	/**
+		This method counts the bits of the CBitVector that are set.
+		\return the number of ones in all bytes of the CBitVector.
+	*/
+	std::size_t PopCount() const;
+
+	/**
+		This method counts the bits that are set in a range of bit positions, numbered as in \link GetBit(std::size_t idx) \endlink.
+		\param	pos		-		Bit position at which the range starts.
+		\param	len		-		Number of bits in the range.
+		\return the number of ones in the range.
+	*/
+	std::size_t PopCount(std::size_t pos, std::size_t len) const;
+
+	/**
+		This method computes the Hamming distance between two CBitVectors of the same size.
+		\param	vec		-		Vector which is compared with the current one.
+		\return the number of bits in which the vectors differ.
+	*/
+	std::size_t HammingDistance(const CBitVector& vec) const;
+
+	/**
+		This method computes the Hamming distance between two CBitVectors for a range of bit positions.
+		\param	vec		-		Vector which is compared with the current one.
+		\param	pos		-		Bit position at which the range starts in both vectors.
+		\param	len		-		Number of bits in the range.
+		\return the number of bits in the range in which the vectors differ.
+	*/
+	std::size_t HammingDistance(const CBitVector& vec, std::size_t pos, std::size_t len) const;
+
 	/**
 		This method sets the element length of the CBitVector. It can be used to modify the object size in a CBitVector when
 		around with the multi dimensional arrays/vectors.
@@ -581,12 +687,73 @@ public:
 	*/
 	void AND(const CBitVector* b);
 
+	/*
+	 * Arithmetic on the elements of m_nElementLength <= 64 bits modulo 2^m_nElementLength. All elements that fit into
+	 * the CBitVector are processed, the operands need the same size and element length.
+	 */
+
+	/**
+		Set the elements of this CBitVector to the sums of the elements of a and b
+		\param	a		-	First summand
+		\param	b		-	Second summand
+	*/
+	void SetAdd(const CBitVector* a, const CBitVector* b);
+
+	/**
+		Set the elements of this CBitVector to the differences a - b of the elements of a and b
+		\param	a		-	Minuend
+		\param	b		-	Subtrahend
+	*/
+	void SetSub(const CBitVector* a, const CBitVector* b);
+
+	/**
+		Set the elements of this CBitVector to the products of the elements of a and b
+		\param	a		-	First factor
+		\param	b		-	Second factor
+	*/
+	void SetMul(const CBitVector* a, const CBitVector* b);
+
 	/**
-		Cyclic shift left by pos positions
+		Set the elements of this CBitVector to the elements of a multiplied by s
+		\param	a		-	Vector of which the elements are multiplied
+		\param	s		-	Scalar factor
+	*/
+	void SetMulScalar(const CBitVector* a, uint64_t s);
+
+	/** Add the elements of b to the elements of this CBitVector */
+	void Add(const CBitVector* b);
+	/** Subtract the elements of b from the elements of this CBitVector */
+	void Sub(const CBitVector* b);
+	/** Multiply the elements of this CBitVector by the elements of b */
+	void Mul(const CBitVector* b);
+	/** Multiply the elements of this CBitVector by s */
+	void MulScalar(uint64_t s);
+
+	/**
+		Cyclic shift left by pos positions, same as \link RotateLeft(std::size_t k) \endlink.
 		\param	pos		-	the left shift value
 	*/
 	void CLShift(std::size_t pos);
 
+	/*
+		Shifts and rotations in place, see bit_shift_left() in bitkernels.h. Positions are numbered as in
+		\link GetBits(BYTE* p, std::size_t pos, std::size_t len) \endlink and left moves bits to higher positions, i.e.,
+		bit i moves to bit i+k. Shifts fill in zeros. The whole vector or the bits [pos, pos+len) are shifted.
+	*/
+
+	/** Shift left by k positions, which multiplies the vector read as a polynomial over GF(2) with x^k */
+	void ShiftLeft(std::size_t k);
+	void ShiftLeft(std::size_t k, std::size_t pos, std::size_t len);
+	/** Shift right by k positions */
+	void ShiftRight(std::size_t k);
+	void ShiftRight(std::size_t k, std::size_t pos, std::size_t len);
+	/** Rotate left by k positions, i.e., bit i moves to bit (i+k) mod the number of bits */
+	void RotateLeft(std::size_t k);
+	void RotateLeft(std::size_t k, std::size_t pos, std::size_t len);
+	/** Rotate right by k positions */
+	void RotateRight(std::size_t k);
+	void RotateRight(std::size_t k, std::size_t pos, std::size_t len);
+
 
 	/*
 	 * Buffer access operations
@@ -696,21 +863,164 @@ public:
 	template<class T> void Set2D(T val, std::size_t i, std::size_t j) {
 		Set<T>(val, (i * m_nNumElementsDimB + j) * m_nElementLength, m_nElementLength);
 	}
+
+	/*
+	 * Batch access to the elements [i, i+n). Elements are unpacked into and packed from integers T with at least
+	 * m_nElementLength bits, the elements of row i of a 2-dimensional vector start at index i * m_nNumElementsDimB.
+	 */
+
+	/**
+		Batch version of \link Get(std::size_t i) \endlink which unpacks n consecutive elements.
+		\param	dst		-		Array of n integers which receive the elements.
+		\param	i		-		Index of the first element.
+		\param	n		-		Number of elements.
+	*/
+	template<class T> void GetElements(T* dst, std::size_t i, std::size_t n) const {
+		assert(m_nElementLength <= sizeof(T) * 8 && (i + n) * m_nElementLength <= m_nByteSize << 3);
+		unpack_bits(dst, sizeof(T), m_pBits, i * m_nElementLength, m_nElementLength, n);
+	}
+
+	/**
+		Batch version of \link Get(std::size_t i) \endlink which unpacks n consecutive elements.
+		\param	i		-		Index of the first element.
+		\param	n		-		Number of elements.
+		\return	the elements.
+	*/
+	template<class T> std::vector<T> GetElements(std::size_t i, std::size_t n) const {
+		std::vector<T> elements(n);
+		GetElements(elements.data(), i, n);
+		return elements;
+	}
+
+	/**
+		Batch version of \link Set(T val, std::size_t i) \endlink which packs n consecutive elements.
+		\param	src		-		Array of n integers of which the lower m_nElementLength bits are written.
+		\param	i		-		Index of the first element.
+		\param	n		-		Number of elements.
+	*/
+	template<class T> void SetElements(const T* src, std::size_t i, std::size_t n) {
+		assert(m_nElementLength <= sizeof(T) * 8 && (i + n) * m_nElementLength <= m_nByteSize << 3);
+		pack_bits(m_pBits, i * m_nElementLength, src, sizeof(T), m_nElementLength, n);
+	}
+
+	/**
+		Batch version of \link Set(T val, std::size_t i) \endlink which packs consecutive elements.
+		\param	src		-		Elements of which the lower m_nElementLength bits are written.
+		\param	i		-		Index of the first element.
+	*/
+	template<class T> void SetElements(const std::vector<T>& src, std::size_t i) {
+		SetElements(src.data(), i, src.size());
+	}
+
+	/**
+		Batch access for elements of L bits that is known at compile time, which is independent of m_nElementLength.
+		Element i occupies the bits [i * L, (i + 1) * L) as in \link Get(std::size_t pos, std::size_t len) \endlink.
+		\param	dst		-		Array of n integers which receive the elements.
+		\param	i		-		Index of the first element.
+		\param	n		-		Number of elements.
+	*/
+	template<std::size_t L, class T> void GetElements(T* dst, std::size_t i, std::size_t n) const {
+		assert((i + n) * L <= m_nByteSize << 3);
+		std::size_t head = AlignedElement<L>(i, n);
+		unpack_bits(dst, sizeof(T), m_pBits, i * L, L, head);
+		unpack_bits<L>(dst + head, m_pBits + (i + head) * L / 8, n - head);
+	}
+
+	template<std::size_t L, class T> std::vector<T> GetElements(std::size_t i, std::size_t n) const {
+		std::vector<T> elements(n);
+		GetElements<L>(elements.data(), i, n);
+		return elements;
+	}
+
+	/**
+		Batch access for elements of L bits that is known at compile time, which is independent of m_nElementLength.
+		\param	src		-		Array of n integers of which the lower L bits are written.
+		\param	i		-		Index of the first element.
+		\param	n		-		Number of elements.
+	*/
+	template<std::size_t L, class T> void SetElements(const T* src, std::size_t i, std::size_t n) {
+		assert((i + n) * L <= m_nByteSize << 3);
+		std::size_t head = AlignedElement<L>(i, n);
+		pack_bits(m_pBits, i * L, src, sizeof(T), L, head);
+		pack_bits<L>(m_pBits + (i + head) * L / 8, src + head, n - head);
+	}
+
+	template<std::size_t L, class T> void SetElements(const std::vector<T>& src, std::size_t i) {
+		SetElements<L>(src.data(), i, src.size());
+	}
 	//useful when accessing elements using an index
 
-	//View the cbitvector as a rows x columns matrix and transpose
-	void Transpose(std::size_t rows, std::size_t columns);
+	/**
+		Bit slicing of the first n elements of bitlen bits, which are numbered as in
+		\link Get(std::size_t pos, std::size_t len) \endlink, e.g., to turn n arithmetic values into bitlen Boolean
+		values of n bits each. planes gets n * bitlen bits, bit b * n + i in \link GetBitNoMask(std::size_t idx) \endlink
+		order is bit b of element i.
+		\param	planes		-	Receives the bit planes, must not be this vector.
+		\param	bitlen		-	Bits per element, at most 64.
+		\param	n			-	Number of elements.
+		\param	nthreads	-	Number of threads, 0 uses all hardware threads.
+	*/
+	void BitSlice(CBitVector& planes, std::size_t bitlen, std::size_t n, uint32_t nthreads = 1) const;
+
+	/**
+		Inverse of \link BitSlice(CBitVector& planes, std::size_t bitlen, std::size_t n, uint32_t nthreads) const \endlink,
+		this vector gets the n elements of bitlen bits whose bit planes are stored in planes.
+	*/
+	void BitUnslice(const CBitVector& planes, std::size_t bitlen, std::size_t n, uint32_t nthreads = 1);
+
+	/**
+		XOR of selected rows, e.g., to scan a database for PIR or DPF evaluation. This vector is a database of nrows rows
+		of rowbytes bytes each. For each of the nsel selections, the XOR of the rows i for which bit i of the selection is
+		set is computed. The database is read once per block of rows for all selections.
+		\param	result		-	Receives nsel rows of rowbytes bytes, must not be this vector.
+		\param	rowbytes	-	Bytes per row.
+		\param	nrows		-	Number of rows.
+		\param	selections	-	nsel * nrows bits, bit s * nrows + i in \link GetBitNoMask(std::size_t idx) \endlink order
+								selects row i for selection s.
+		\param	nsel		-	Number of selections.
+		\param	nthreads	-	Number of threads, 0 uses all hardware threads.
+	*/
+	void XORSelectedRows(CBitVector& result, std::size_t rowbytes, std::size_t nrows, const CBitVector& selections,
+			std::size_t nsel = 1, uint32_t nthreads = 1) const;
+
+	//View the cbitvector as a rows x columns matrix and transpose, nthreads 0 uses all hardware threads
+	void Transpose(std::size_t rows, std::size_t columns, uint32_t nthreads = 1);
 	void SimpleTranspose(std::size_t rows, std::size_t columns);
+	//Only for rows and columns that are powers of two
 	void EklundhBitTranspose(std::size_t rows, std::size_t columns);
+	//Cache-blocked SIMD transposition of arbitrary shapes, square matrices are transposed in place
+	void TiledTranspose(std::size_t rows, std::size_t columns, uint32_t nthreads = 1);
 
 private:
 	BYTE* m_pBits;	/** Byte pointer which stores the CBitVector as simple byte array. */
+	CBitVectorAllocator* m_cAllocator; /** Allocator for new buffers. */
+	CBitVectorAllocator* m_cBufAllocator; /** Allocator that owns m_pBits. */
 	std::size_t m_nByteSize; /** Byte size variable which stores the size of CBitVector in bytes. */
+	std::size_t m_nCapacity; /** Number of bytes allocated for m_pBits, at least m_nByteSize. */
 	std::size_t m_nBits; //The exact number of bits
 	std::size_t m_nElementLength; /** Size of elements in the CBitVector. By default, it is set to 1. It is used
 	 	 	 	 	 	 	 	   differently when it is used as 1-d or 2-d custom vector/array. */
 	std::size_t m_nNumElements;  /** Number elements in the first dimension in the CBitVector. */
 	std::size_t m_nNumElementsDimB;/** Number elements in the second dimension in the CBitVector. */
+
+	void CreateExact(std::size_t bits, bool zero);
+
+	//replace the buffer by one with the given capacity that holds the first bytes of the current content
+	void Reallocate(std::size_t capacity);
+
+	//same size and element length as this vector, with elements of at most 64 bits
+	bool IsArithOperand(const CBitVector* vec) const;
+
+	//Number of elements of L bits from index i on, at most n, until an element starts on a byte boundary
+	template<std::size_t L> static std::size_t AlignedElement(std::size_t i, std::size_t n) {
+		std::size_t head = 0;
+		while (head < n && ((i + head) * L) % 8) {
+			head++;
+		}
+		return head;
+	}
+
+	static CBitVectorAllocator* s_cDefaultAllocator;
 };
 
 #endif /* BITVECTOR_H_ */
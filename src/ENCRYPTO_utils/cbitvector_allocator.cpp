@@ -0,0 +1,277 @@
+/**
+ \file 		cbitvector_allocator.cpp
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Allocation policies for the buffers of CBitVector
+ */
+
+#include "cbitvector_allocator.h"
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t MIN_POOL_CLASS = 6; //64 bytes
+
+inline std::size_t round_up(std::size_t n, std::size_t multiple) {
+	return (n + multiple - 1) / multiple * multiple;
+}
+
+inline std::size_t size_class(std::size_t nbytes) {
+	std::size_t c = MIN_POOL_CLASS;
+	while (((std::size_t) 1 << c) < nbytes) {
+		c++;
+	}
+	return c;
+}
+
+} // namespace
+
+
+BYTE* MallocAllocator::Allocate(std::size_t nbytes, bool zero) {
+	return (BYTE*) (zero ? calloc(nbytes, sizeof(BYTE)) : malloc(nbytes));
+}
+
+void MallocAllocator::Deallocate(BYTE* p, std::size_t) {
+	free(p);
+}
+
+MallocAllocator* MallocAllocator::Instance() {
+	static MallocAllocator instance;
+	return &instance;
+}
+
+
+AlignedAllocator::AlignedAllocator(std::size_t alignment) : m_nAlignment(alignment) {
+	assert(alignment >= sizeof(void*) && (alignment & (alignment - 1)) == 0);
+}
+
+//posix_memalign buffers can be released with free(), such that buffers handed over via AttachBuf() / DetachBuf() stay valid
+BYTE* AlignedAllocator::Allocate(std::size_t nbytes, bool zero) {
+	void* p = NULL;
+	if (posix_memalign(&p, m_nAlignment, nbytes > 0 ? nbytes : 1) != 0) {
+		return NULL;
+	}
+	if (zero) {
+		memset(p, 0, nbytes);
+	}
+	return (BYTE*) p;
+}
+
+void AlignedAllocator::Deallocate(BYTE* p, std::size_t) {
+	free(p);
+}
+
+AlignedAllocator* AlignedAllocator::Instance() {
+	static AlignedAllocator instance;
+	return &instance;
+}
+
+
+HugePageAllocator::HugePageAllocator(mode m) : m_eMode(m) {
+}
+
+BYTE* HugePageAllocator::Allocate(std::size_t nbytes, bool) {
+	std::size_t size = round_up(nbytes, HUGE_PAGE_BYTES);
+	void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+	if (m_eMode == mode::explicit_pages) {
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	}
+#endif
+	if (p == MAP_FAILED) {
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) {
+			return NULL;
+		}
+#ifdef MADV_HUGEPAGE
+		madvise(p, size, MADV_HUGEPAGE);
+#endif
+	}
+	return (BYTE*) p;
+}
+
+void HugePageAllocator::Deallocate(BYTE* p, std::size_t nbytes) {
+	munmap(p, round_up(nbytes, HUGE_PAGE_BYTES));
+}
+
+
+PoolAllocator::PoolAllocator(CBitVectorAllocator* upstream) : m_cUpstream(upstream) {
+}
+
+PoolAllocator::~PoolAllocator() {
+	Trim();
+}
+
+BYTE* PoolAllocator::Allocate(std::size_t nbytes, bool zero) {
+	std::size_t c = size_class(nbytes);
+	BYTE* p = NULL;
+	{
+		std::lock_guard<std::mutex> lock(m_mLock);
+		if (c < m_vFree.size() && !m_vFree[c].empty()) {
+			p = m_vFree[c].back();
+			m_vFree[c].pop_back();
+		}
+	}
+	if (p == NULL) {
+		return m_cUpstream->Allocate((std::size_t) 1 << c, zero);
+	}
+	if (zero) {
+		memset(p, 0, nbytes);
+	}
+	return p;
+}
+
+void PoolAllocator::Deallocate(BYTE* p, std::size_t nbytes) {
+	std::size_t c = size_class(nbytes);
+	std::lock_guard<std::mutex> lock(m_mLock);
+	if (c >= m_vFree.size()) {
+		m_vFree.resize(c + 1);
+	}
+	m_vFree[c].push_back(p);
+}
+
+void PoolAllocator::Trim() {
+	std::lock_guard<std::mutex> lock(m_mLock);
+	for (std::size_t c = 0; c < m_vFree.size(); c++) {
+		for (BYTE* p : m_vFree[c]) {
+			m_cUpstream->Deallocate(p, (std::size_t) 1 << c);
+		}
+		m_vFree[c].clear();
+	}
+}
+
+
+ArenaAllocator::ArenaAllocator(std::size_t chunkbytes, CBitVectorAllocator* upstream)
+	: m_cUpstream(upstream), m_nChunkBytes(chunkbytes), m_pCurrent(NULL), m_nUsed(0) {
+}
+
+ArenaAllocator::~ArenaAllocator() {
+	Release();
+}
+
+BYTE* ArenaAllocator::Allocate(std::size_t nbytes, bool zero) {
+	std::size_t size = round_up(nbytes, CACHE_LINE_BYTES);
+	std::lock_guard<std::mutex> lock(m_mLock);
+	if (size > m_nChunkBytes) {
+		//large buffers get a chunk of their own
+		BYTE* p = m_cUpstream->Allocate(size, zero);
+		if (p != NULL) {
+			m_vChunks.push_back(chunk { p, size });
+		}
+		return p;
+	}
+	if (m_pCurrent == NULL || m_nUsed + size > m_nChunkBytes) {
+		m_pCurrent = m_cUpstream->Allocate(m_nChunkBytes, false);
+		if (m_pCurrent == NULL) {
+			return NULL;
+		}
+		m_vChunks.push_back(chunk { m_pCurrent, m_nChunkBytes });
+		m_nUsed = 0;
+	}
+	BYTE* p = m_pCurrent + m_nUsed;
+	m_nUsed += size;
+	if (zero) {
+		memset(p, 0, nbytes);
+	}
+	return p;
+}
+
+void ArenaAllocator::Deallocate(BYTE*, std::size_t) {
+}
+
+void ArenaAllocator::Release() {
+	std::lock_guard<std::mutex> lock(m_mLock);
+	for (chunk& c : m_vChunks) {
+		m_cUpstream->Deallocate(c.buf, c.size);
+	}
+	m_vChunks.clear();
+	m_pCurrent = NULL;
+	m_nUsed = 0;
+}
+
+
+MappedFileAllocator::MappedFileAllocator(const char* path, mode m, bool sequential, bool hugepages)
+	: m_eMode(m), m_bSequential(sequential), m_nOffset(0) {
+	int flags = m == mode::create ? O_RDWR | O_CREAT | O_TRUNC : (m == mode::open ? O_RDWR : O_RDONLY);
+	m_nFD = open(path, flags, 0644);
+	if (m_nFD < 0) {
+		std::cerr << "MappedFileAllocator: could not open " << path << ": " << strerror(errno) << std::endl;
+	}
+	m_nAlignment = hugepages ? HUGE_PAGE_BYTES : sysconf(_SC_PAGESIZE);
+}
+
+MappedFileAllocator::~MappedFileAllocator() {
+	if (m_nFD >= 0) {
+		close(m_nFD);
+	}
+}
+
+bool MappedFileAllocator::IsOpen() const {
+	return m_nFD >= 0;
+}
+
+BYTE* MappedFileAllocator::Allocate(std::size_t nbytes, bool) {
+	std::size_t size = round_up(nbytes, m_nAlignment);
+	std::lock_guard<std::mutex> lock(m_mLock);
+	if (m_nFD < 0) {
+		return NULL;
+	}
+	if (m_eMode == mode::create) {
+		//reserve the blocks now, writing to a mapping of a hole of a full disk would raise SIGBUS
+		if (posix_fallocate(m_nFD, m_nOffset, size) != 0) {
+			return NULL;
+		}
+	} else {
+		struct stat st;
+		if (fstat(m_nFD, &st) != 0 || (std::size_t) st.st_size < m_nOffset + nbytes) {
+			return NULL;
+		}
+	}
+	void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, m_eMode == mode::open_private ? MAP_PRIVATE : MAP_SHARED,
+			m_nFD, m_nOffset);
+	if (p == MAP_FAILED) {
+		return NULL;
+	}
+#ifdef MADV_HUGEPAGE
+	if (m_nAlignment == HUGE_PAGE_BYTES) {
+		madvise(p, size, MADV_HUGEPAGE);
+	}
+#endif
+	if (m_bSequential) {
+		madvise(p, size, MADV_SEQUENTIAL);
+		if (m_eMode != mode::create) {
+			madvise(p, size, MADV_WILLNEED);
+		}
+	}
+	m_nOffset += size;
+	return (BYTE*) p;
+}
+
+void MappedFileAllocator::Deallocate(BYTE* p, std::size_t nbytes) {
+	//dirty pages of shared mappings are written back by the kernel
+	munmap(p, round_up(nbytes, m_nAlignment));
+}
+
+std::size_t MappedFileAllocator::GetOffset() const {
+	return m_nOffset;
+}
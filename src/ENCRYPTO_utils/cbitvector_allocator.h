@@ -0,0 +1,182 @@
+/**
+ \file 		cbitvector_allocator.h
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Allocation policies for the buffers of CBitVector
+ */
+
+#ifndef CBITVECTOR_ALLOCATOR_H_
+#define CBITVECTOR_ALLOCATOR_H_
+
+#include "typedefs.h"
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#define CACHE_LINE_BYTES	64
+#define HUGE_PAGE_BYTES		(1 << 21)
+
+/**
+	Allocation policy of CBitVector. A CBitVector keeps a pointer to the allocator that owns its buffer and returns the
+	buffer to it, hence an allocator has to outlive all vectors that use it.
+*/
+class CBitVectorAllocator {
+public:
+	virtual ~CBitVectorAllocator() = default;
+
+	/**
+		\param	nbytes	-	Number of bytes, larger than zero.
+		\param	zero	-	Whether the buffer has to be zero-initialized.
+		\return	the buffer or NULL if the allocation failed.
+	*/
+	virtual BYTE* Allocate(std::size_t nbytes, bool zero) = 0;
+
+	/** Release a buffer of this allocator, nbytes is the size it was allocated with. */
+	virtual void Deallocate(BYTE* p, std::size_t nbytes) = 0;
+};
+
+/** calloc / malloc and free, the policy of buffers that are attached via CBitVector::AttachBuf(). */
+class MallocAllocator : public CBitVectorAllocator {
+public:
+	BYTE* Allocate(std::size_t nbytes, bool zero) override;
+	void Deallocate(BYTE* p, std::size_t nbytes) override;
+
+	static MallocAllocator* Instance();
+};
+
+/**
+	Buffers aligned to a power of two, by default to cache lines. This is the default policy of CBitVector.
+	Buffers come from posix_memalign and can be released with free(), like the buffers of MallocAllocator, so they can
+	be handed over with AttachBuf() and DetachBuf(). Zeroed buffers are cleared with memset, use MallocAllocator for
+	large vectors that should be zeroed lazily by the kernel.
+*/
+class AlignedAllocator : public CBitVectorAllocator {
+public:
+	AlignedAllocator(std::size_t alignment = CACHE_LINE_BYTES);
+
+	BYTE* Allocate(std::size_t nbytes, bool zero) override;
+	void Deallocate(BYTE* p, std::size_t nbytes) override;
+
+	static AlignedAllocator* Instance();
+
+private:
+	std::size_t m_nAlignment;
+};
+
+/**
+	Anonymous mappings in multiples of HUGE_PAGE_BYTES to reduce TLB misses on large vectors. Transparent huge pages
+	are requested via madvise. Explicit huge pages are taken from the hugetlbfs pool (vm.nr_hugepages), if the pool is
+	exhausted the allocator falls back to transparent huge pages. Mappings are always zeroed by the kernel.
+*/
+class HugePageAllocator : public CBitVectorAllocator {
+public:
+	enum class mode { transparent, explicit_pages };
+
+	HugePageAllocator(mode m = mode::transparent);
+
+	BYTE* Allocate(std::size_t nbytes, bool zero) override;
+	void Deallocate(BYTE* p, std::size_t nbytes) override;
+
+private:
+	mode m_eMode;
+};
+
+/**
+	Caches released buffers in power-of-two size classes and hands them out again, for code that repeatedly creates
+	vectors of similar sizes. Buffers are obtained from and finally returned to the upstream allocator. Thread-safe.
+*/
+class PoolAllocator : public CBitVectorAllocator {
+public:
+	PoolAllocator(CBitVectorAllocator* upstream = AlignedAllocator::Instance());
+	~PoolAllocator();
+
+	BYTE* Allocate(std::size_t nbytes, bool zero) override;
+	void Deallocate(BYTE* p, std::size_t nbytes) override;
+
+	/** Return all cached buffers to the upstream allocator */
+	void Trim();
+
+private:
+	CBitVectorAllocator* m_cUpstream;
+	std::vector<std::vector<BYTE*>> m_vFree; //indexed by the log2 of the size class
+	std::mutex m_mLock;
+};
+
+/**
+	Bump allocation from large chunks. Deallocate() is a no-op, the memory of all vectors is released at once by
+	Release() or the destructor, which must only happen after the vectors are gone. Thread-safe.
+*/
+class ArenaAllocator : public CBitVectorAllocator {
+public:
+	ArenaAllocator(std::size_t chunkbytes = HUGE_PAGE_BYTES, CBitVectorAllocator* upstream = AlignedAllocator::Instance());
+	~ArenaAllocator();
+
+	BYTE* Allocate(std::size_t nbytes, bool zero) override;
+	void Deallocate(BYTE* p, std::size_t nbytes) override;
+
+	/** Return all chunks to the upstream allocator */
+	void Release();
+
+private:
+	struct chunk {
+		BYTE* buf;
+		std::size_t size;
+	};
+	CBitVectorAllocator* m_cUpstream;
+	std::size_t m_nChunkBytes;
+	std::vector<chunk> m_vChunks;
+	BYTE* m_pCurrent; //chunk that is currently used for bump allocation
+	std::size_t m_nUsed; //bytes used in the current chunk
+	std::mutex m_mLock;
+};
+
+/**
+	Maps consecutive regions of a file as buffers, for vectors that exceed main memory or that are written by one process
+	and read by another, e.g., correlations of an offline phase that are used by a later online phase. Buffers are laid
+	out in the order in which they are allocated, each starting at a multiple of the page size, such that vectors that
+	are created with the same sizes in the same order map the same bits when the file is opened again.
+
+	In mode::create the file is created or truncated and space for each buffer is preallocated, so buffers are zeroed.
+	In mode::open the mapped regions have to exist and their bits are kept, i.e., the zero flag of Allocate() is
+	ignored and writes go to the file. mode::open_private maps existing regions copy-on-write, writes are not visible in
+	the file. Sequential access makes the kernel read ahead aggressively and, for existing regions, starts reading the
+	whole region on allocation. Huge pages align the buffers to HUGE_PAGE_BYTES and request huge pages via madvise,
+	which takes effect for files on tmpfs or hugetlbfs. Thread-safe.
+*/
+class MappedFileAllocator : public CBitVectorAllocator {
+public:
+	enum class mode { create, open, open_private };
+
+	MappedFileAllocator(const char* path, mode m = mode::create, bool sequential = true, bool hugepages = false);
+	~MappedFileAllocator();
+
+	/** \return whether the file could be opened, otherwise all allocations fail */
+	bool IsOpen() const;
+
+	BYTE* Allocate(std::size_t nbytes, bool zero) override;
+	void Deallocate(BYTE* p, std::size_t nbytes) override;
+
+	/** \return the file offset of the next buffer */
+	std::size_t GetOffset() const;
+
+private:
+	int m_nFD;
+	mode m_eMode;
+	bool m_bSequential;
+	std::size_t m_nAlignment; //page or huge page size
+	std::size_t m_nOffset;
+	std::mutex m_mLock;
+};
+
+#endif /* CBITVECTOR_ALLOCATOR_H_ */
@@ -0,0 +1,346 @@
+/**
+ \file 		cbitvector_expr.h
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Lazy bitwise expressions over CBitVector
+ */
+
+#ifndef CBITVECTOR_EXPR_H_
+#define CBITVECTOR_EXPR_H_
+
+#include "bitkernels.h"
+#include "cbitvector.h"
+#include "cbitvector_view.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#define BIT_EXPR_BLOCK_BYTES	4096
+
+/**
+	Base of lazy bitwise expressions such as dst = (a ^ b) & c ^ d. An expression only refers to the buffers of its
+	operands, which must outlive it and have the same size. It is evaluated when it is assigned, block by block in the
+	L1 cache with the kernels of bitkernels.h, i.e., in a single pass over memory and without temporary vectors.
+	Operands may alias the vector that is assigned to or overlap it partly, e.g., views of it at another offset. If an
+	operand starts before the assigned bytes, it would read bytes that were already overwritten, and the expression is
+	evaluated into a temporary vector first.
+
+	Besides size() and eval(), which writes the bytes [pos, pos + len) of the result, expressions report whether their
+	operands are disjoint from a buffer, whether they can be evaluated into a buffer in place and whether they can be
+	evaluated block by block before each block is written to a buffer. Evaluation in place requires every operand to
+	be either the buffer itself or disjoint from it, if it is read after the first write to the buffer. Evaluation
+	block by block requires every operand to be disjoint from the buffer or to start at or after it.
+*/
+template<class E> struct bit_expr {
+	const E& self() const {
+		return static_cast<const E&>(*this);
+	}
+};
+
+/** Leaf of an expression, a range of bytes that is not owned */
+struct bit_operand : bit_expr<bit_operand> {
+	static constexpr bool leaf = true;
+
+	bit_operand(const BYTE* p, std::size_t nbytes) : m_pBits(p), m_nBytes(nbytes) {
+	}
+
+	bit_operand(const CBitVector& vec) : m_pBits(vec.GetArr()), m_nBytes(vec.GetSize()) {
+	}
+
+	std::size_t size() const {
+		return m_nBytes;
+	}
+
+	const BYTE* bytes(std::size_t pos) const {
+		return m_pBits + pos;
+	}
+
+	void eval(BYTE* out, std::size_t pos, std::size_t len) const {
+		if (out != m_pBits + pos) {
+			memcpy(out, m_pBits + pos, len);
+		}
+	}
+
+	bool disjoint(const BYTE* p, std::size_t n) const {
+		return m_pBits + m_nBytes <= p || p + n <= m_pBits;
+	}
+
+	bool evaluable_into(const BYTE* p, std::size_t n) const {
+		return m_pBits == p || disjoint(p, n);
+	}
+
+	//byte pos is read before the block that contains byte pos of the buffer is written
+	bool blockwise_evaluable_into(const BYTE* p, std::size_t n) const {
+		return m_pBits >= p || disjoint(p, n);
+	}
+
+	const BYTE* m_pBits;
+	std::size_t m_nBytes;
+};
+
+//Operations of the nodes, apply() combines into dst and set() combines two sources
+struct bit_xor_op {
+	static void apply(BYTE* dst, const BYTE* src, std::size_t len) {
+		xor_bytes(dst, src, len);
+	}
+	static void set(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len) {
+		set_xor_bytes(dst, a, b, len);
+	}
+};
+
+struct bit_and_op {
+	static void apply(BYTE* dst, const BYTE* src, std::size_t len) {
+		and_bytes(dst, src, len);
+	}
+	static void set(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len) {
+		set_and_bytes(dst, a, b, len);
+	}
+};
+
+struct bit_or_op {
+	static void apply(BYTE* dst, const BYTE* src, std::size_t len) {
+		or_bytes(dst, src, len);
+	}
+	static void set(BYTE* dst, const BYTE* a, const BYTE* b, std::size_t len) {
+		set_or_bytes(dst, a, b, len);
+	}
+};
+
+struct bit_assign_op {
+	static void apply(BYTE* dst, const BYTE* src, std::size_t len) {
+		memcpy(dst, src, len);
+	}
+};
+
+/** Node that combines two expressions with a commutative operation OP */
+template<class OP, class L, class R> struct bit_binary : bit_expr<bit_binary<OP, L, R>> {
+	static constexpr bool leaf = false;
+
+	bit_binary(const L& l, const R& r) : m_cLeft(l), m_cRight(r) {
+		assert(l.size() == r.size());
+	}
+
+	std::size_t size() const {
+		return m_cLeft.size();
+	}
+
+	//leaves are read in place, only a non-leaf right operand needs a block of its own
+	void eval(BYTE* out, std::size_t pos, std::size_t len) const {
+		if constexpr (L::leaf && R::leaf) {
+			OP::set(out, m_cLeft.bytes(pos), m_cRight.bytes(pos), len);
+		} else if constexpr (R::leaf) {
+			m_cLeft.eval(out, pos, len);
+			OP::apply(out, m_cRight.bytes(pos), len);
+		} else if constexpr (L::leaf) {
+			m_cRight.eval(out, pos, len);
+			OP::apply(out, m_cLeft.bytes(pos), len);
+		} else {
+			BYTE right[BIT_EXPR_BLOCK_BYTES];
+			m_cLeft.eval(out, pos, len);
+			m_cRight.eval(right, pos, len);
+			OP::apply(out, right, len);
+		}
+	}
+
+	bool disjoint(const BYTE* p, std::size_t n) const {
+		return m_cLeft.disjoint(p, n) && m_cRight.disjoint(p, n);
+	}
+
+	//the order of the accesses in eval()
+	bool evaluable_into(const BYTE* p, std::size_t n) const {
+		if constexpr (L::leaf && R::leaf) {
+			return m_cLeft.evaluable_into(p, n) && m_cRight.evaluable_into(p, n);
+		} else if constexpr (L::leaf && !R::leaf) {
+			return m_cRight.evaluable_into(p, n) && m_cLeft.disjoint(p, n);
+		} else {
+			return m_cLeft.evaluable_into(p, n) && m_cRight.disjoint(p, n);
+		}
+	}
+
+	bool blockwise_evaluable_into(const BYTE* p, std::size_t n) const {
+		return m_cLeft.blockwise_evaluable_into(p, n) && m_cRight.blockwise_evaluable_into(p, n);
+	}
+
+	L m_cLeft;
+	R m_cRight;
+};
+
+/** Node that inverts an expression */
+template<class E> struct bit_not : bit_expr<bit_not<E>> {
+	static constexpr bool leaf = false;
+
+	bit_not(const E& e) : m_cExpr(e) {
+	}
+
+	std::size_t size() const {
+		return m_cExpr.size();
+	}
+
+	void eval(BYTE* out, std::size_t pos, std::size_t len) const {
+		m_cExpr.eval(out, pos, len);
+		invert_bytes(out, len);
+	}
+
+	bool disjoint(const BYTE* p, std::size_t n) const {
+		return m_cExpr.disjoint(p, n);
+	}
+
+	bool evaluable_into(const BYTE* p, std::size_t n) const {
+		return m_cExpr.evaluable_into(p, n);
+	}
+
+	bool blockwise_evaluable_into(const BYTE* p, std::size_t n) const {
+		return m_cExpr.blockwise_evaluable_into(p, n);
+	}
+
+	E m_cExpr;
+};
+
+inline bit_operand as_bit_expr(const CBitVector& vec) {
+	return bit_operand(vec);
+}
+
+//views take part in expressions if they are byte aligned and of whole bytes
+inline bit_operand as_bit_expr(const CBitVectorConstView& view) {
+	assert(view.IsByteAligned() && view.GetLength() % 8 == 0);
+	return bit_operand(view.GetArr(), view.GetLength() >> 3);
+}
+
+template<class E> const E& as_bit_expr(const bit_expr<E>& e) {
+	return e.self();
+}
+
+//CBitVectors, views and expressions can be combined by the operators below
+template<class T> struct is_bit_expr_operand : std::integral_constant<bool,
+		std::is_same<T, CBitVector>::value || std::is_same<T, CBitVectorConstView>::value
+		|| std::is_same<T, CBitVectorView>::value || std::is_base_of<bit_expr<T>, T>::value> {
+};
+
+template<class T> using bit_expr_type = typename std::decay<decltype(as_bit_expr(std::declval<const T&>()))>::type;
+
+#define BIT_EXPR_OPERATOR(op, opstruct)																		\
+template<class A, class B, typename std::enable_if<is_bit_expr_operand<A>::value && is_bit_expr_operand<B>::value,	\
+		int>::type = 0>																						\
+bit_binary<opstruct, bit_expr_type<A>, bit_expr_type<B>> operator op(const A& a, const B& b) {						\
+	return bit_binary<opstruct, bit_expr_type<A>, bit_expr_type<B>>(as_bit_expr(a), as_bit_expr(b));				\
+}
+
+BIT_EXPR_OPERATOR(^, bit_xor_op)
+BIT_EXPR_OPERATOR(&, bit_and_op)
+BIT_EXPR_OPERATOR(|, bit_or_op)
+
+#undef BIT_EXPR_OPERATOR
+
+template<class A, typename std::enable_if<is_bit_expr_operand<A>::value, int>::type = 0>
+bit_not<bit_expr_type<A>> operator~(const A& a) {
+	return bit_not<bit_expr_type<A>>(as_bit_expr(a));
+}
+
+/**
+	Evaluate e into a block at a time and combine the block into dst with OP. If an operand starts before dst and
+	overlaps it, e is evaluated completely before dst is written.
+*/
+template<class OP, class E> void evaluate_bit_expr(BYTE* dst, const E& e) {
+	if (!e.blockwise_evaluable_into(dst, e.size())) {
+		std::vector<BYTE> result(e.size());
+		for (std::size_t pos = 0; pos < e.size(); pos += BIT_EXPR_BLOCK_BYTES) {
+			e.eval(result.data() + pos, pos, std::min((std::size_t) BIT_EXPR_BLOCK_BYTES, e.size() - pos));
+		}
+		OP::apply(dst, result.data(), e.size());
+		return;
+	}
+	BYTE block[BIT_EXPR_BLOCK_BYTES];
+	for (std::size_t pos = 0; pos < e.size(); pos += BIT_EXPR_BLOCK_BYTES) {
+		std::size_t len = std::min((std::size_t) BIT_EXPR_BLOCK_BYTES, e.size() - pos);
+		e.eval(block, pos, len);
+		OP::apply(dst + pos, block, len);
+	}
+}
+
+template<class E> CBitVector& CBitVector::operator=(const bit_expr<E>& expr) {
+	const E& e = expr.self();
+	if (m_nByteSize != e.size()) {
+		if (!e.disjoint(m_pBits, m_nByteSize)) {
+			//a view of this vector is an operand, hence the expression is evaluated before the buffer is replaced
+			std::vector<BYTE> result(e.size());
+			evaluate_bit_expr<bit_assign_op>(result.data(), e);
+			CreateExact(e.size() << 3, false);
+			memcpy(m_pBits, result.data(), result.size());
+			return *this;
+		}
+		CreateExact(e.size() << 3, false);
+	}
+	if (e.evaluable_into(m_pBits, m_nByteSize)) {
+		for (std::size_t pos = 0; pos < m_nByteSize; pos += BIT_EXPR_BLOCK_BYTES) {
+			e.eval(m_pBits + pos, pos, std::min((std::size_t) BIT_EXPR_BLOCK_BYTES, m_nByteSize - pos));
+		}
+	} else {
+		evaluate_bit_expr<bit_assign_op>(m_pBits, e);
+	}
+	return *this;
+}
+
+template<class E> CBitVector& CBitVector::operator^=(const bit_expr<E>& expr) {
+	assert(m_nByteSize == expr.self().size());
+	evaluate_bit_expr<bit_xor_op>(m_pBits, expr.self());
+	return *this;
+}
+
+template<class E> CBitVector& CBitVector::operator&=(const bit_expr<E>& expr) {
+	assert(m_nByteSize == expr.self().size());
+	evaluate_bit_expr<bit_and_op>(m_pBits, expr.self());
+	return *this;
+}
+
+template<class E> CBitVector& CBitVector::operator|=(const bit_expr<E>& expr) {
+	assert(m_nByteSize == expr.self().size());
+	evaluate_bit_expr<bit_or_op>(m_pBits, expr.self());
+	return *this;
+}
+
+template<class E> void CBitVectorView::Assign(const bit_expr<E>& expr) const {
+	bit_operand out = as_bit_expr(*this);
+	assert(out.size() == expr.self().size());
+	const E& e = expr.self();
+	if (e.evaluable_into(out.m_pBits, out.size())) {
+		for (std::size_t pos = 0; pos < out.size(); pos += BIT_EXPR_BLOCK_BYTES) {
+			e.eval(GetArr() + pos, pos, std::min((std::size_t) BIT_EXPR_BLOCK_BYTES, out.size() - pos));
+		}
+	} else {
+		evaluate_bit_expr<bit_assign_op>(GetArr(), e);
+	}
+}
+
+template<class E> const CBitVectorView& CBitVectorView::operator^=(const bit_expr<E>& expr) const {
+	assert(as_bit_expr(*this).size() == expr.self().size());
+	evaluate_bit_expr<bit_xor_op>(GetArr(), expr.self());
+	return *this;
+}
+
+template<class E> const CBitVectorView& CBitVectorView::operator&=(const bit_expr<E>& expr) const {
+	assert(as_bit_expr(*this).size() == expr.self().size());
+	evaluate_bit_expr<bit_and_op>(GetArr(), expr.self());
+	return *this;
+}
+
+template<class E> const CBitVectorView& CBitVectorView::operator|=(const bit_expr<E>& expr) const {
+	assert(as_bit_expr(*this).size() == expr.self().size());
+	evaluate_bit_expr<bit_or_op>(GetArr(), expr.self());
+	return *this;
+}
+
+#endif /* CBITVECTOR_EXPR_H_ */
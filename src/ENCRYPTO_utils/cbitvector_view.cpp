@@ -0,0 +1,180 @@
+/**
+ \file 		cbitvector_view.cpp
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Non-owning views of bit ranges
+ */
+
+#include "cbitvector_view.h"
+#include "bitkernels.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+//Views with different bit offsets are combined through stack blocks of this many bits
+constexpr std::size_t VIEW_BLOCK_BITS = 1 << 15;
+
+//bits of the first byte from offset on and of the last byte before the end, LSB first
+inline BYTE head_mask(std::size_t offset) {
+	return 0xFF << offset;
+}
+
+inline BYTE tail_mask(std::size_t offset, std::size_t bits) {
+	std::size_t end = (offset + bits) & 0x07;
+	return end ? (1 << end) - 1 : 0xFF;
+}
+
+} // namespace
+
+
+void CBitVectorConstView::GetBits(BYTE* p, std::size_t pos, std::size_t len) const {
+	assert(pos + len <= m_nBits);
+	if (len == 0) {
+		return;
+	}
+	bit_copy(p, 0, m_pBits, m_nOffset + pos, len);
+	if (len & 0x07) {
+		p[len >> 3] &= (1 << (len & 0x07)) - 1;
+	}
+}
+
+std::size_t CBitVectorConstView::PopCount() const {
+	if (m_nBits == 0) {
+		return 0;
+	}
+	std::size_t nbytes = GetByteSpan();
+	BYTE head = head_mask(m_nOffset), tail = tail_mask(m_nOffset, m_nBits);
+	if (nbytes == 1) {
+		return __builtin_popcount(m_pBits[0] & head & tail);
+	}
+	return __builtin_popcount(m_pBits[0] & head) + popcount_bytes(m_pBits + 1, nbytes - 2)
+			+ __builtin_popcount(m_pBits[nbytes - 1] & tail);
+}
+
+bool CBitVectorConstView::IsEqual(const CBitVectorConstView& other) const {
+	if (m_nBits != other.m_nBits) {
+		return false;
+	}
+	if (m_nOffset == 0 && other.m_nOffset == 0) {
+		std::size_t full = m_nBits >> 3;
+		if (!equal_bytes(m_pBits, other.m_pBits, full)) {
+			return false;
+		}
+		BYTE tail = (1 << (m_nBits & 0x07)) - 1;
+		return tail == 0 || ((m_pBits[full] ^ other.m_pBits[full]) & tail) == 0;
+	}
+	BYTE a[VIEW_BLOCK_BITS / 8], b[VIEW_BLOCK_BITS / 8];
+	for (std::size_t pos = 0; pos < m_nBits; pos += VIEW_BLOCK_BITS) {
+		std::size_t len = std::min(VIEW_BLOCK_BITS, m_nBits - pos);
+		GetBits(a, pos, len);
+		other.GetBits(b, pos, len);
+		if (!equal_bytes(a, b, (len + 7) >> 3)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void CBitVectorConstView::TransposeTo(const CBitVectorView& dst, std::size_t rows, std::size_t columns,
+		uint32_t nthreads) const {
+	assert(IsByteAligned() && dst.IsByteAligned());
+	assert(rows * columns <= m_nBits && rows * columns <= dst.GetLength());
+	bit_transpose(dst.GetArr(), m_pBits, rows, columns, nthreads);
+}
+
+
+void CBitVectorView::SetBits(const BYTE* p, std::size_t pos, std::size_t len) const {
+	assert(pos + len <= m_nBits);
+	bit_copy(GetArr(), m_nOffset + pos, p, 0, len);
+}
+
+void CBitVectorView::XORBits(const BYTE* p, std::size_t pos, std::size_t len) const {
+	assert(pos + len <= m_nBits);
+	bit_xor(GetArr(), m_nOffset + pos, p, 0, len);
+}
+
+void CBitVectorView::Copy(const CBitVectorConstView& src) const {
+	assert(src.GetLength() == m_nBits);
+	bit_copy(GetArr(), m_nOffset, src.GetArr(), src.GetOffset(), m_nBits);
+}
+
+void CBitVectorView::XOR(const CBitVectorConstView& src) const {
+	assert(src.GetLength() == m_nBits);
+	bit_xor(GetArr(), m_nOffset, src.GetArr(), src.GetOffset(), m_nBits);
+}
+
+//Sources with the same offset are ANDed bytewise, others are first shifted to the offset of the view in blocks
+void CBitVectorView::AND(const CBitVectorConstView& src) const {
+	assert(src.GetLength() == m_nBits);
+	if (m_nBits == 0) {
+		return;
+	}
+	if (src.GetOffset() == m_nOffset) {
+		BYTE first = m_pBits[0], last = m_pBits[GetByteSpan() - 1];
+		and_bytes(GetArr(), src.GetArr(), GetByteSpan());
+		RestoreEdges(first, last);
+		return;
+	}
+	//bits of the block outside the source range are one and keep the view unchanged
+	BYTE block[VIEW_BLOCK_BITS / 8 + 1];
+	for (std::size_t pos = 0; pos < m_nBits; pos += VIEW_BLOCK_BITS) {
+		std::size_t len = std::min(VIEW_BLOCK_BITS, m_nBits - pos);
+		std::size_t nbytes = (m_nOffset + len + 7) >> 3;
+		memset(block, 0xFF, nbytes);
+		bit_copy(block, m_nOffset, src.GetArr(), src.GetOffset() + pos, len);
+		and_bytes(GetArr() + (pos >> 3), block, nbytes);
+	}
+}
+
+void CBitVectorView::Reset() const {
+	if (m_nBits > 0) {
+		BYTE first = m_pBits[0], last = m_pBits[GetByteSpan() - 1];
+		memset(GetArr(), 0, GetByteSpan());
+		RestoreEdges(first, last);
+	}
+}
+
+void CBitVectorView::SetToOne() const {
+	if (m_nBits > 0) {
+		BYTE first = m_pBits[0], last = m_pBits[GetByteSpan() - 1];
+		memset(GetArr(), 0xFF, GetByteSpan());
+		RestoreEdges(first, last);
+	}
+}
+
+void CBitVectorView::Invert() const {
+	if (m_nBits > 0) {
+		BYTE first = m_pBits[0], last = m_pBits[GetByteSpan() - 1];
+		invert_bytes(GetArr(), GetByteSpan());
+		RestoreEdges(first, last);
+	}
+}
+
+void CBitVectorView::Transpose(std::size_t n, uint32_t nthreads) const {
+	assert(IsByteAligned() && n * n <= m_nBits);
+	bit_transpose_square(GetArr(), n, nthreads);
+}
+
+void CBitVectorView::RestoreEdges(BYTE first, BYTE last) const {
+	BYTE* p = GetArr();
+	std::size_t nbytes = GetByteSpan();
+	BYTE head = head_mask(m_nOffset), tail = tail_mask(m_nOffset, m_nBits);
+	if (nbytes == 1) {
+		head &= tail;
+	} else {
+		p[nbytes - 1] = (p[nbytes - 1] & tail) | (last & ~tail);
+	}
+	p[0] = (p[0] & head) | (first & ~head);
+}
@@ -0,0 +1,201 @@
+/**
+ \file 		cbitvector_view.h
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Non-owning views of bit ranges
+ */
+
+#ifndef CBITVECTOR_VIEW_H_
+#define CBITVECTOR_VIEW_H_
+
+#include "cbitvector.h"
+#include "typedefs.h"
+#include <cassert>
+#include <cstddef>
+
+class CBitVectorView;
+template<class E> struct bit_expr;
+
+/**
+	Read-only view of a range of bits, given by a pointer, a bit offset and a bit length, that neither owns nor
+	allocates memory. Bits are numbered as in \link CBitVector::GetBits(BYTE* p, std::size_t pos, std::size_t len) \endlink,
+	i.e., LSB first within a byte like \link CBitVector::GetBitNoMask(std::size_t idx) \endlink. Views are cheap to
+	copy and must not outlive the memory they refer to. A CBitVector converts implicitly into a view of all its bits.
+*/
+class CBitVectorConstView {
+public:
+	/**
+		\param	p		-	Memory of the bits.
+		\param	pos		-	Bit offset of the view in p.
+		\param	bits	-	Number of bits of the view.
+	*/
+	CBitVectorConstView(const BYTE* p, std::size_t pos, std::size_t bits)
+		: m_pBits(p + (pos >> 3)), m_nOffset(pos & 0x07), m_nBits(bits) {
+	}
+
+	CBitVectorConstView(const CBitVector& vec) : CBitVectorConstView(vec.GetArr(), 0, vec.GetSize() << 3) {
+	}
+
+	CBitVectorConstView(const CBitVector& vec, std::size_t pos, std::size_t bits)
+		: CBitVectorConstView(vec.GetArr(), pos, bits) {
+		assert(pos + bits <= vec.GetSize() << 3);
+	}
+
+	/** \return the view of bits [pos, pos+bits) of this view */
+	CBitVectorConstView Slice(std::size_t pos, std::size_t bits) const {
+		assert(pos + bits <= m_nBits);
+		return CBitVectorConstView(m_pBits, m_nOffset + pos, bits);
+	}
+
+	/** \return the byte that contains the first bit */
+	const BYTE* GetArr() const {
+		return m_pBits;
+	}
+
+	/** \return the position of the first bit in the byte returned by GetArr(), smaller than 8 */
+	std::size_t GetOffset() const {
+		return m_nOffset;
+	}
+
+	/** \return the number of bits of the view */
+	std::size_t GetLength() const {
+		return m_nBits;
+	}
+
+	/** \return whether the view starts at the beginning of a byte */
+	bool IsByteAligned() const {
+		return m_nOffset == 0;
+	}
+
+	/** \return the number of bytes that contain bits of the view */
+	std::size_t GetByteSpan() const {
+		return (m_nOffset + m_nBits + 7) >> 3;
+	}
+
+	BYTE GetBitNoMask(std::size_t idx) const {
+		assert(idx < m_nBits);
+		idx += m_nOffset;
+		return (m_pBits[idx >> 3] >> (idx & 0x07)) & 0x01;
+	}
+
+	/**
+		Copy bits [pos, pos+len) of the view into p, starting at the first bit of p. Unused bits of the last byte are zero.
+	*/
+	void GetBits(BYTE* p, std::size_t pos, std::size_t len) const;
+
+	template<class T> T Get(std::size_t pos, std::size_t len) const {
+		assert(len <= sizeof(T) * 8);
+		T val = 0;
+		GetBits((BYTE*) &val, pos, len);
+		return val;
+	}
+
+	/** \return the number of ones in the view */
+	std::size_t PopCount() const;
+
+	/** \return whether the views have the same length and bits */
+	bool IsEqual(const CBitVectorConstView& other) const;
+
+	/**
+		Transpose the rows x columns matrix of this view into dst, see bit_transpose(). Both views have to be byte
+		aligned and must not overlap.
+	*/
+	void TransposeTo(const CBitVectorView& dst, std::size_t rows, std::size_t columns, uint32_t nthreads = 1) const;
+
+protected:
+	const BYTE* m_pBits; /** Byte that contains the first bit */
+	std::size_t m_nOffset; /** Position of the first bit in *m_pBits */
+	std::size_t m_nBits;
+};
+
+/**
+	Writable view of a range of bits. All operations only modify the bits of the view, the other bits of the first and
+	last byte are kept. Source views of the operations must have the same length and must not overlap with the view.
+*/
+class CBitVectorView : public CBitVectorConstView {
+public:
+	CBitVectorView(BYTE* p, std::size_t pos, std::size_t bits) : CBitVectorConstView(p, pos, bits) {
+	}
+
+	CBitVectorView(CBitVector& vec) : CBitVectorConstView(vec) {
+	}
+
+	CBitVectorView(CBitVector& vec, std::size_t pos, std::size_t bits) : CBitVectorConstView(vec, pos, bits) {
+	}
+
+	CBitVectorView Slice(std::size_t pos, std::size_t bits) const {
+		assert(pos + bits <= m_nBits);
+		return CBitVectorView(GetArr(), m_nOffset + pos, bits);
+	}
+
+	BYTE* GetArr() const {
+		return const_cast<BYTE*>(m_pBits);
+	}
+
+	void SetBitNoMask(std::size_t idx, BYTE b) const {
+		assert(idx < m_nBits);
+		idx += m_nOffset;
+		GetArr()[idx >> 3] = (m_pBits[idx >> 3] & ~(1 << (idx & 0x07))) | ((b & 0x01) << (idx & 0x07));
+	}
+
+	void XORBitNoMask(std::size_t idx, BYTE b) const {
+		assert(idx < m_nBits);
+		idx += m_nOffset;
+		GetArr()[idx >> 3] ^= (b & 0x01) << (idx & 0x07);
+	}
+
+	/** Set bits [pos, pos+len) of the view to the first len bits of p */
+	void SetBits(const BYTE* p, std::size_t pos, std::size_t len) const;
+	/** XOR the first len bits of p onto bits [pos, pos+len) of the view */
+	void XORBits(const BYTE* p, std::size_t pos, std::size_t len) const;
+
+	template<class T> void Set(T val, std::size_t pos, std::size_t len) const {
+		assert(len <= sizeof(T) * 8);
+		SetBits((BYTE*) &val, pos, len);
+	}
+
+	template<class T> void XOR(T val, std::size_t pos, std::size_t len) const {
+		assert(len <= sizeof(T) * 8);
+		XORBits((BYTE*) &val, pos, len);
+	}
+
+	/** this = src */
+	void Copy(const CBitVectorConstView& src) const;
+	/** this ^= src */
+	void XOR(const CBitVectorConstView& src) const;
+	/** this &= src */
+	void AND(const CBitVectorConstView& src) const;
+
+	void Reset() const;
+	void SetToOne() const;
+	void Invert() const;
+
+	/** Transpose the n x n matrix at the start of the byte aligned view in place, see bit_transpose_square() */
+	void Transpose(std::size_t n, uint32_t nthreads = 1) const;
+
+	/**
+		Evaluate a bitwise expression into the view, which has to be byte aligned and of whole bytes. Defined in
+		cbitvector_expr.h.
+	*/
+	template<class E> void Assign(const bit_expr<E>& expr) const;
+	template<class E> const CBitVectorView& operator^=(const bit_expr<E>& expr) const;
+	template<class E> const CBitVectorView& operator&=(const bit_expr<E>& expr) const;
+	template<class E> const CBitVectorView& operator|=(const bit_expr<E>& expr) const;
+
+private:
+	//set the bits of the first and last byte outside the view back to those of first and last
+	void RestoreEdges(BYTE first, BYTE last) const;
+};
+
+#endif /* CBITVECTOR_VIEW_H_ */
@@ -17,18 +17,21 @@
 
 #include "channel.h"
 
+#include "cbitvector.h"
 #include "typedefs.h"
 #include "rcvthread.h"
 #include "sndthread.h"
+#include "utils.h"
 #include <cassert>
 #include <cstring>
 #include <cstdlib>
+#include <vector>
 
 
 channel::channel(uint8_t channelid, RcvThread* rcver, SndThread* snder)
 	: m_bChannelID(channelid), m_cRcver(rcver), m_cSnder(snder),
 	m_eRcved(std::make_unique<CEvent>()), m_eFin(std::make_unique<CEvent>()),
-	m_bSndAlive(true), m_bRcvAlive(true),
+	m_bSndAlive(true), m_bRcvAlive(true), m_nQueuedAtFin(0),
 	m_qRcvedBlocks(rcver->add_listener(channelid, m_eRcved.get(), m_eFin.get())),
 	m_qRcvedBlocks_mutex_(rcver->get_listener_mutex(channelid))
 {
@@ -64,9 +67,60 @@ void channel::blocking_send_id_len(CEvent* eventcaller, uint8_t* buf, uint64_t n
 	eventcaller->Wait();
 }
 
+void channel::send(const CBitVector& vec, std::size_t bitpos, std::size_t bitlen) {
+	assert(m_bSndAlive);
+	assert(bitpos + bitlen <= vec.GetSize() * 8);
+	//an empty message would signal the end of the channel
+	if(bitlen == 0) {
+		return;
+	}
+	//the bits are written straight into the buffer of the send task
+	std::vector<uint8_t> sndbuf;
+	if(bitpos & 0x07) {
+		sndbuf.resize(bits_in_bytes(bitlen));
+		vec.GetBits(sndbuf.data(), bitpos, bitlen);
+	} else {
+		//full bytes are copied as they are, only a trailing partial byte is masked
+		const uint8_t* start = vec.GetArr() + (bitpos >> 3);
+		sndbuf.reserve(bits_in_bytes(bitlen));
+		sndbuf.assign(start, start + (bitlen >> 3));
+		if(bitlen & 0x07) {
+			sndbuf.push_back(0);
+			vec.GetBits(&sndbuf.back(), bitpos + (bitlen & ~((std::size_t) 0x07)), bitlen & 0x07);
+		}
+	}
+	m_cSnder->add_snd_task(m_bChannelID, std::move(sndbuf));
+}
+
+void channel::blocking_send(CEvent* eventcaller, const CBitVector& vec, std::size_t bitpos, std::size_t bitlen) {
+	assert(m_bSndAlive);
+	assert(bitpos + bitlen <= vec.GetSize() * 8);
+	if(bitlen == 0) {
+		return;
+	}
+	if(bitpos & 0x07) {
+		//unaligned ranges have to be shifted anyway
+		std::vector<uint8_t> tmpbuf(bits_in_bytes(bitlen));
+		vec.GetBits(tmpbuf.data(), bitpos, bitlen);
+		m_cSnder->add_event_snd_task_nocopy(eventcaller, m_bChannelID, 0, nullptr, std::move(tmpbuf));
+	} else {
+		//full bytes are sent from vec, only a trailing partial byte is masked and copied
+		std::vector<uint8_t> tail;
+		if(bitlen & 0x07) {
+			tail.push_back(0);
+			vec.GetBits(tail.data(), bitpos + (bitlen & ~((std::size_t) 0x07)), bitlen & 0x07);
+		}
+		m_cSnder->add_event_snd_task_nocopy(eventcaller, m_bChannelID, bitlen >> 3, vec.GetArr() + (bitpos >> 3), std::move(tail));
+	}
+	eventcaller->Wait();
+}
+
 //buf needs to be freed, data contains the payload
 uint8_t* channel::blocking_receive_id_len(uint8_t** data, uint64_t* id, uint64_t* len) {
 	uint8_t* buf = blocking_receive();
+	if(buf == nullptr) {
+		return nullptr;
+	}
 	*data = buf;
 	*id = *((uint64_t*) *data);
 	(*data)  += sizeof(uint64_t);
@@ -82,10 +136,21 @@ bool channel::queue_empty() const {
 	return qempty;
 }
 
+bool channel::wait_for_data() {
+	while(queue_empty()) {
+		if(m_cRcver->has_failed()) {
+			return false;
+		}
+		m_eRcved->Wait();
+	}
+	return true;
+}
+
 uint8_t* channel::blocking_receive() {
 	assert(m_bRcvAlive);
-	while(queue_empty())
-		m_eRcved->Wait();
+	if(!wait_for_data()) {
+		return nullptr;
+	}
 	rcv_ctx* ret = nullptr;
 	uint8_t* ret_block = nullptr;
 	{
@@ -99,15 +164,17 @@ uint8_t* channel::blocking_receive() {
 	return ret_block;
 }
 
-void channel::blocking_receive(uint8_t* rcvbuf, uint64_t rcvsize) {
+bool channel::blocking_receive(uint8_t* rcvbuf, uint64_t rcvsize) {
 	assert(m_bRcvAlive);
-	while(queue_empty())
-		m_eRcved->Wait();
+	if(!wait_for_data()) {
+		return false;
+	}
 
 	std::unique_lock<std::mutex> lock(m_qRcvedBlocks_mutex_);
 	rcv_ctx* ret = (rcv_ctx*) m_qRcvedBlocks->front();
 	uint8_t* ret_block = ret->buf;
 	uint64_t rcved_this_call = ret->rcvbytes;
+	int block_node = ret->numa_node;
 	if(rcved_this_call == rcvsize) {
 		m_qRcvedBlocks->pop();
 		lock.unlock();
@@ -118,6 +185,7 @@ void channel::blocking_receive(uint8_t* rcvbuf, uint64_t rcvsize) {
 		uint8_t* newbuf = (uint8_t*) malloc(ret->rcvbytes);
 		memcpy(newbuf, ret->buf+rcvsize, ret->rcvbytes);
 		ret->buf = newbuf;
+		ret->numa_node = CThread::NumaNodeOfAddress(newbuf);
 		lock.unlock();
 		rcved_this_call = rcvsize;
 	} else {
@@ -128,15 +196,55 @@ void channel::blocking_receive(uint8_t* rcvbuf, uint64_t rcvsize) {
 		uint8_t* new_rcvbuf_start = rcvbuf + rcved_this_call;
 		uint64_t new_rcvsize = rcvsize -rcved_this_call;
 
-		blocking_receive(new_rcvbuf_start, new_rcvsize);
+		if(!blocking_receive(new_rcvbuf_start, new_rcvsize)) {
+			free(ret_block);
+			return false;
+		}
 	}
 	memcpy(rcvbuf, ret_block, rcved_this_call);
+	m_cRcver->count_copy(block_node, rcved_this_call);
 	free(ret_block);
+	return true;
+}
+
+bool channel::blocking_receive(CBitVector& vec, std::size_t bitpos, std::size_t bitlen) {
+	assert(m_bRcvAlive);
+	assert(bitpos + bitlen <= vec.GetSize() * 8);
+	uint64_t nbytes = bits_in_bytes(bitlen);
+	if(nbytes == 0) {
+		return true;
+	}
+	if(!((bitpos & 0x07) || (bitlen & 0x07))) {
+		uint8_t* dst = vec.GetArr() + (bitpos >> 3);
+		if(m_cRcver->post_receive(m_bChannelID, dst, nbytes)) {
+			while(true) {
+				RcvThread::posted_state state = m_cRcver->check_posted_receive(m_bChannelID);
+				if(state == RcvThread::posted_state::done) {
+					return true;
+				}
+				if(state == RcvThread::posted_state::cancelled) {
+					break;
+				}
+				if(m_cRcver->has_failed()) {
+					return false;
+				}
+				m_eRcved->Wait();
+			}
+		}
+		return blocking_receive(dst, nbytes);
+	} else {
+		std::vector<uint8_t> tmpbuf(nbytes);
+		if(!blocking_receive(tmpbuf.data(), nbytes)) {
+			return false;
+		}
+		vec.SetBits(tmpbuf.data(), bitpos, bitlen);
+		return true;
+	}
 }
 
 
 bool channel::is_alive() {
-	return (!(queue_empty() && m_eFin->IsSet()));
+	return (!(queue_empty() && (m_eFin->IsSet() || m_cRcver->has_failed())));
 }
 
 bool channel::data_available() {
@@ -150,9 +258,15 @@ void channel::signal_end() {
 
 void channel::wait_for_fin() {
 	m_eFin->Wait();
+	m_nQueuedAtFin = m_cRcver->consume_fin(m_bChannelID);
 	m_bRcvAlive = false;
 }
 
+void channel::flush_before_fin() {
+	assert(!m_bRcvAlive);
+	m_cRcver->flush_queue_before_fin(m_bChannelID, m_nQueuedAtFin);
+}
+
 void channel::synchronize_end() {
 	if(m_bSndAlive)
 		signal_end();
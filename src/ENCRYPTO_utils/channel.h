@@ -18,6 +18,7 @@
 #ifndef CHANNEL_H_
 #define CHANNEL_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <mutex>
@@ -28,6 +29,7 @@ class SndThread;
 struct rcv_ctx;
 class CEvent;
 class CLock;
+class CBitVector;
 
 class channel {
 public:
@@ -43,14 +45,36 @@ public:
 
 	void blocking_send_id_len(CEvent* eventcaller, uint8_t* buf, uint64_t nbytes, uint64_t id, uint64_t len);
 
-	//buf needs to be freed, data contains the payload
+	/**
+		Send bits [bitpos, bitpos+bitlen) of vec as one message of ceil(bitlen/8) bytes. The bits are shifted to
+		start at bit 0 (GetBits order) and unused bits in the last byte are zero. The bits are copied before returning.
+	*/
+	void send(const CBitVector& vec, std::size_t bitpos, std::size_t bitlen);
+
+	/**
+		Same as send(const CBitVector&, std::size_t, std::size_t), but if bitpos is byte-aligned the data is sent
+		directly out of the buffer of vec. vec must therefore not be modified until the call returns.
+	*/
+	void blocking_send(CEvent* eventcaller, const CBitVector& vec, std::size_t bitpos, std::size_t bitlen);
+
+	//buf needs to be freed, data contains the payload. Returns nullptr if the connection failed.
 	uint8_t* blocking_receive_id_len(uint8_t** data, uint64_t* id, uint64_t* len);
 
     bool queue_empty() const;
 
+	//Returns nullptr if the connection failed, see RcvThread::has_failed
 	uint8_t* blocking_receive();
 
-	void blocking_receive(uint8_t* rcvbuf, uint64_t rcvsize);
+	//false if the connection failed before rcvsize bytes were received
+	bool blocking_receive(uint8_t* rcvbuf, uint64_t rcvsize);
+
+	/**
+		Receive a message sent by send(const CBitVector&, std::size_t, std::size_t) into bits [bitpos, bitpos+bitlen)
+		of vec, other bits of vec are left untouched. If the range is byte-aligned and no other data is pending on
+		this channel, the receiver thread writes the message directly into vec.
+		\return	false if the connection failed before the message was received
+	*/
+	bool blocking_receive(CBitVector& vec, std::size_t bitpos, std::size_t bitlen);
 
 	bool is_alive();
 
@@ -58,11 +82,18 @@ public:
 
 	void signal_end();
 
+	//Wait for the end-of-channel message of the other party
 	void wait_for_fin();
 
+	//Drop the blocks that were received before the fin that wait_for_fin() returned on, later blocks are kept
+	void flush_before_fin();
+
 	void synchronize_end();
 
 private:
+	//Wait until a block is queued, false if the connection failed
+	bool wait_for_data();
+
 	uint8_t m_bChannelID;
 	RcvThread* m_cRcver;
 	SndThread* m_cSnder;
@@ -70,6 +101,7 @@ private:
 	std::unique_ptr<CEvent> m_eFin;
 	bool m_bSndAlive;
 	bool m_bRcvAlive;
+	uint64_t m_nQueuedAtFin;
 	std::queue<rcv_ctx*>* m_qRcvedBlocks;
 	std::mutex& m_qRcvedBlocks_mutex_;
 };
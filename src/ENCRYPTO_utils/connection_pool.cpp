@@ -0,0 +1,152 @@
+/**
+ \file 		connection_pool.cpp
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Multiplexing of sessions over persistent connections
+ */
+
+#include "connection_pool.h"
+#include "channel.h"
+#include "constants.h"
+#include "rcvthread.h"
+#include "sndthread.h"
+#include "socket.h"
+#include "crypto/record_layer.h"
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+
+
+ConnectionPool::ConnectionPool(std::vector<std::unique_ptr<CSocket>> sockets, uint8_t channels_per_session,
+		const std::vector<record_layer*>& record_layers)
+	: m_nChannelsPerSession(channels_per_session),
+	m_nSlotsPerConnection(channels_per_session > 0 ? ADMIN_CHANNEL / channels_per_session : 0)
+{
+	assert(channels_per_session > 0);
+	assert(m_nSlotsPerConnection > 0);
+	assert(record_layers.empty() || record_layers.size() == sockets.size());
+	m_vConnections.resize(sockets.size());
+	for(size_t i = 0; i < sockets.size(); i++) {
+		connection& con = m_vConnections[i];
+		con.sock = std::move(sockets[i]);
+		con.lock = std::make_unique<CLock>();
+		con.snder = std::make_unique<SndThread>(con.sock.get(), con.lock.get());
+		con.rcver = std::make_unique<RcvThread>(con.sock.get(), con.lock.get());
+		record_layer* rl = record_layers.empty() ? nullptr : record_layers[i];
+		if(rl != nullptr) {
+			//the salts are small enough to be buffered by the socket, so both parties can send theirs first
+			if(!rl->handshake(con.sock.get())) {
+				std::cerr << "Error in the record layer handshake of connection " << i << ": connection_pool.cpp" << std::endl;
+				exit(1);
+			}
+			con.snder->set_record_layer(rl);
+			con.rcver->set_record_layer(rl);
+		}
+		con.snder->Start();
+		con.rcver->Start();
+	}
+	m_vSlotInUse.resize(m_vConnections.size() * m_nSlotsPerConnection, false);
+}
+
+ConnectionPool::~ConnectionPool() {
+	for(size_t i = 0; i < m_vSlotInUse.size(); i++) {
+		assert(!m_vSlotInUse[i]);
+	}
+	//first stop all senders, which also terminates the receivers of the other party, then wait for the receivers
+	for(auto& con : m_vConnections) {
+		con.snder.reset();
+	}
+	for(auto& con : m_vConnections) {
+		con.rcver.reset();
+	}
+}
+
+std::unique_ptr<session> ConnectionPool::open_session(uint32_t sessionid) {
+	if(m_vSlotInUse.empty()) {
+		return nullptr;
+	}
+	size_t slot = sessionid % m_vSlotInUse.size();
+	{
+		std::lock_guard<std::mutex> lock(m_mSlotMutex);
+		if(m_vSlotInUse[slot]) {
+			std::cerr << "Session " << sessionid << " cannot be opened, its slot is still in use" << std::endl;
+			return nullptr;
+		}
+		m_vSlotInUse[slot] = true;
+	}
+	connection& con = m_vConnections[slot / m_nSlotsPerConnection];
+	uint8_t basechannel = (slot % m_nSlotsPerConnection) * m_nChannelsPerSession;
+
+	return std::unique_ptr<session>(new session(this, sessionid, slot, con.rcver.get(), con.snder.get(), basechannel));
+}
+
+std::size_t ConnectionPool::get_max_sessions() const {
+	return m_vSlotInUse.size();
+}
+
+uint8_t ConnectionPool::get_channels_per_session() const {
+	return m_nChannelsPerSession;
+}
+
+void ConnectionPool::release_slot(std::size_t slot) {
+	std::lock_guard<std::mutex> lock(m_mSlotMutex);
+	m_vSlotInUse[slot] = false;
+}
+
+
+session::session(ConnectionPool* pool, uint32_t sessionid, std::size_t slot, RcvThread* rcver, SndThread* snder, uint8_t basechannel)
+	: m_cPool(pool), m_nSessionID(sessionid), m_nSlot(slot), m_cRcver(rcver), m_nBaseChannel(basechannel), m_bOpen(true)
+{
+	//all channels are registered right away such that both parties end all of them in close()
+	m_vChannels.resize(pool->get_channels_per_session());
+	for(size_t i = 0; i < m_vChannels.size(); i++) {
+		m_vChannels[i] = std::make_unique<channel>(m_nBaseChannel + i, rcver, snder);
+	}
+}
+
+session::~session() {
+	close();
+}
+
+channel* session::get_channel(uint8_t localid) {
+	assert(m_bOpen);
+	assert(localid < m_vChannels.size());
+	return m_vChannels[localid].get();
+}
+
+uint8_t session::get_num_channels() const {
+	return m_vChannels.size();
+}
+
+uint32_t session::get_id() const {
+	return m_nSessionID;
+}
+
+void session::close() {
+	if(!m_bOpen) {
+		return;
+	}
+	for(auto& ch : m_vChannels) {
+		ch->signal_end();
+	}
+	for(size_t i = 0; i < m_vChannels.size(); i++) {
+		m_vChannels[i]->wait_for_fin();
+		//the other party might already use the slot for its next session and even have ended it, only drop
+		//data that arrived before the fin of this session
+		m_vChannels[i]->flush_before_fin();
+	}
+	m_vChannels.clear();
+	m_bOpen = false;
+	m_cPool->release_slot(m_nSlot);
+}
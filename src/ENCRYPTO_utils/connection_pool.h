@@ -0,0 +1,127 @@
+/**
+ \file 		connection_pool.h
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Multiplexing of sessions over persistent connections
+ */
+
+#ifndef __CONNECTION_POOL_H__
+#define __CONNECTION_POOL_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class CSocket;
+class CLock;
+class RcvThread;
+class SndThread;
+class channel;
+class record_layer;
+class session;
+
+/**
+	Keeps a set of connected sockets together with their send and receive threads alive and hands out
+	sessions on top of them. Each connection carries up to ADMIN_CHANNEL channels, which are split into
+	slots of channels_per_session channels. A session occupies one slot, so opening and closing a session
+	neither creates sockets nor threads.
+
+	Both parties have to open sessions with the same ids. The slot is derived from the session id, hence
+	session ids that are open at the same time have to map to different slots (e.g. consecutive ids).
+*/
+class ConnectionPool {
+public:
+	/**
+		\param	sockets					- connected sockets, e.g. obtained via Connect() / Listen() from connection.h.
+										  The i-th socket of both parties has to belong to the same connection.
+		\param	channels_per_session	- number of channels available in each session
+		\param	record_layers			- optional, record_layers[i] encrypts the connection of the i-th socket if it is
+										  not nullptr. Its handshake is done here, before the threads are started, and
+										  it has to stay alive as long as the pool. Both parties have to pass record
+										  layers for the same sockets.
+	*/
+	ConnectionPool(std::vector<std::unique_ptr<CSocket>> sockets, uint8_t channels_per_session,
+			const std::vector<record_layer*>& record_layers = {});
+
+	/** Stops all threads, all sessions have to be closed before. */
+	~ConnectionPool();
+
+	/**
+		Open the session with the given id. The returned session is closed when it is destroyed.
+		\return the session or nullptr if its slot is still occupied by another open session.
+	*/
+	std::unique_ptr<session> open_session(uint32_t sessionid);
+
+	/** \return the number of sessions that can be open at the same time */
+	std::size_t get_max_sessions() const;
+
+	uint8_t get_channels_per_session() const;
+
+private:
+	friend class session;
+
+	void release_slot(std::size_t slot);
+
+	struct connection {
+		std::unique_ptr<CSocket> sock;
+		std::unique_ptr<CLock> lock;
+		std::unique_ptr<SndThread> snder;
+		std::unique_ptr<RcvThread> rcver;
+	};
+
+	std::vector<connection> m_vConnections;
+	uint8_t m_nChannelsPerSession;
+	std::size_t m_nSlotsPerConnection;
+	std::vector<bool> m_vSlotInUse;
+	std::mutex m_mSlotMutex;
+};
+
+/**
+	A set of channels of a ConnectionPool that is exclusively used by one session. Channels are addressed
+	by session local ids 0, ..., get_num_channels()-1.
+*/
+class session {
+public:
+	~session();
+
+	/** \return the channel with the session local id localid */
+	channel* get_channel(uint8_t localid);
+
+	uint8_t get_num_channels() const;
+
+	uint32_t get_id() const;
+
+	/**
+		End all channels of the session and wait until the other party ended them as well. Data that was
+		not received until then is dropped. Afterwards the slot can be used by the next session.
+	*/
+	void close();
+
+private:
+	friend class ConnectionPool;
+
+	session(ConnectionPool* pool, uint32_t sessionid, std::size_t slot, RcvThread* rcver, SndThread* snder, uint8_t basechannel);
+
+	ConnectionPool* m_cPool;
+	uint32_t m_nSessionID;
+	std::size_t m_nSlot;
+	RcvThread* m_cRcver;
+	uint8_t m_nBaseChannel;
+	std::vector<std::unique_ptr<channel>> m_vChannels;
+	bool m_bOpen;
+};
+
+#endif /* __CONNECTION_POOL_H__ */
@@ -27,6 +27,7 @@
 //#define FIXED_KEY_AES_HASHING
 //#define USE_PIPELINED_AES_NI
 //#define SIMPLE_TRANSPOSE //activate the simple transpose, only required for benchmarking, not recommended
+//#define EKLUNDH_TRANSPOSE //use the Eklundh transpose instead of the SIMD transpose, only required for benchmarking
 
 #define AES_KEY_BITS			128
 #define AES_KEY_BYTES			16
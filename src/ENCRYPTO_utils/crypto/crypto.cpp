@@ -22,11 +22,14 @@
 #include <openssl/des.h>
 #include "ecc-pk-crypto.h"
 #include "gmp-pk-crypto.h"
+#include "../thread.h"
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <fcntl.h>
 #include <unistd.h>
 #include <utility>
+#include <vector>
 
 crypto::crypto(uint32_t symsecbits, uint8_t* seed) {
 	init(symsecbits, seed);
@@ -104,29 +107,51 @@ pk_crypto* crypto::gen_field(field_type ftype) {
 	return ret;
 }
 
-void gen_rnd_bytes(prf_state_ctx* prf_state, uint8_t* resbuf, uint32_t nbytes) {
-	AES_KEY_CTX* aes_key;
-	uint64_t* rndctr;
-	uint8_t* tmpbuf;
-	uint32_t i, size;
-	int32_t dummy;
+//Counter blocks that are encrypted with a single call, written to the output and encrypted in place
+#define RND_BATCH_BLOCKS	1024
 
-	aes_key = &(prf_state->aes_key);
-	rndctr = prf_state->ctr;
-	size = ceil_divide(nbytes, AES_BYTES);
-	tmpbuf = (uint8_t*) malloc(sizeof(uint8_t) * size * AES_BYTES);
-
-	//TODO it might be better to store the result directly in resbuf but this would require the invoking routine to pad it to a multiple of AES_BYTES
-	for (i = 0; i < size; i++, rndctr[0]++) {
+//Encrypt the nblocks counter blocks ctr + first, ctr + first + 1, ... into out. Only the lowest word of ctr is counted.
+static void encrypt_ctr_blocks(AES_KEY_CTX* aes_key, const uint64_t* ctr, uint64_t first, uint8_t* out, std::size_t nblocks) {
+	int32_t dummy;
+	for (std::size_t i = 0; i < nblocks; i += RND_BATCH_BLOCKS) {
+		std::size_t batch = std::min(nblocks - i, (std::size_t) RND_BATCH_BLOCKS);
+		uint8_t* buf = out + i * AES_BYTES;
+		for (std::size_t j = 0; j < batch; j++) {
+			uint64_t c = first + i + j;
+			memcpy(buf + j * AES_BYTES, &c, sizeof(uint64_t));
+			memcpy(buf + j * AES_BYTES + sizeof(uint64_t), ctr + 1, AES_BYTES - sizeof(uint64_t));
+		}
 #ifdef OPENSSL_OPAQUE_EVP_CIPHER_CTX
-		EVP_EncryptUpdate(*aes_key, tmpbuf + i * AES_BYTES, &dummy, (uint8_t*) rndctr, AES_BYTES);
+		EVP_EncryptUpdate(*aes_key, buf, &dummy, buf, batch * AES_BYTES);
 #else
-		EVP_EncryptUpdate(aes_key, tmpbuf + i * AES_BYTES, &dummy, (uint8_t*) rndctr, AES_BYTES);
+		EVP_EncryptUpdate(aes_key, buf, &dummy, buf, batch * AES_BYTES);
 #endif
 	}
-	memcpy(resbuf, tmpbuf, nbytes);
+}
 
-	free(tmpbuf);
+//Encrypt the partial block ctr[0] into the last nbytes % AES_BYTES bytes of resbuf
+static void encrypt_ctr_tail(AES_KEY_CTX* aes_key, const uint64_t* ctr, uint8_t* resbuf, std::size_t nbytes) {
+	uint8_t tmpbuf[AES_BYTES];
+	int32_t dummy;
+#ifdef OPENSSL_OPAQUE_EVP_CIPHER_CTX
+	EVP_EncryptUpdate(*aes_key, tmpbuf, &dummy, (uint8_t*) ctr, AES_BYTES);
+#else
+	EVP_EncryptUpdate(aes_key, tmpbuf, &dummy, (uint8_t*) ctr, AES_BYTES);
+#endif
+	memcpy(resbuf + nbytes / AES_BYTES * AES_BYTES, tmpbuf, nbytes % AES_BYTES);
+}
+
+void gen_rnd_bytes(prf_state_ctx* prf_state, uint8_t* resbuf, uint32_t nbytes) {
+	uint64_t* rndctr = prf_state->ctr;
+	uint32_t size = nbytes / AES_BYTES;
+
+	//full blocks are encrypted directly into resbuf, only a partial last block goes through a temporary block
+	encrypt_ctr_blocks(&(prf_state->aes_key), rndctr, rndctr[0], resbuf, size);
+	rndctr[0] += size;
+	if (nbytes % AES_BYTES) {
+		encrypt_ctr_tail(&(prf_state->aes_key), rndctr, resbuf, nbytes);
+		rndctr[0]++;
+	}
 }
 
 void crypto::gen_rnd(uint8_t* resbuf, uint32_t nbytes) {
@@ -134,6 +159,42 @@ void crypto::gen_rnd(uint8_t* resbuf, uint32_t nbytes) {
 	gen_rnd_bytes(&global_prf_state, resbuf, nbytes);
 }
 
+//Every thread encrypts its own range of counters with a copy of the key, as cipher contexts must not be shared
+void crypto::gen_rnd_parallel(uint8_t* resbuf, std::size_t nbytes, uint32_t nthreads) {
+	std::lock_guard<std::mutex> lock(global_prf_state_mutex);
+	uint64_t* rndctr = global_prf_state.ctr;
+	uint64_t first = rndctr[0];
+	//ranges for which no copy of the key could be made are filled sequentially with the key itself afterwards
+	std::vector<std::pair<std::size_t, std::size_t>> failed;
+	std::mutex failed_mutex;
+	ParallelFor(nbytes / AES_BYTES, RND_BATCH_BLOCKS, nthreads, [&](std::size_t begin, std::size_t end) {
+#ifdef OPENSSL_OPAQUE_EVP_CIPHER_CTX
+		AES_KEY_CTX aes_key = EVP_CIPHER_CTX_new();
+		bool copied = aes_key != nullptr && EVP_CIPHER_CTX_copy(aes_key, global_prf_state.aes_key) == 1;
+#else
+		AES_KEY_CTX aes_key;
+		EVP_CIPHER_CTX_init(&aes_key);
+		bool copied = EVP_CIPHER_CTX_copy(&aes_key, &global_prf_state.aes_key) == 1;
+#endif
+		if (copied) {
+			encrypt_ctr_blocks(&aes_key, rndctr, first + begin, resbuf + begin * AES_BYTES, end - begin);
+		} else {
+			std::lock_guard<std::mutex> failed_lock(failed_mutex);
+			failed.emplace_back(begin, end);
+		}
+		clean_aes_key(&aes_key);
+	});
+	for (const auto& range : failed) {
+		encrypt_ctr_blocks(&global_prf_state.aes_key, rndctr, first + range.first, resbuf + range.first * AES_BYTES,
+				range.second - range.first);
+	}
+	rndctr[0] += nbytes / AES_BYTES;
+	if (nbytes % AES_BYTES) {
+		encrypt_ctr_tail(&global_prf_state.aes_key, rndctr, resbuf, nbytes);
+		rndctr[0]++;
+	}
+}
+
 void crypto::gen_rnd_uniform(uint32_t* res, uint32_t mod) {
 	//pad to multiple of 4 bytes for uint32_t length
 	uint32_t nrndbytes = PadToMultiple(bits_in_bytes(secparam.symbits) + ceil_log2(mod), sizeof(uint32_t));
@@ -71,6 +71,8 @@ public:
 
 	//Randomness generation routines
 	void gen_rnd(uint8_t* resbuf, uint32_t numbytes);
+	// Same output and counter state as gen_rnd(), generated by nthreads threads (0 uses all hardware threads)
+	void gen_rnd_parallel(uint8_t* resbuf, std::size_t numbytes, uint32_t nthreads = 0);
 	void gen_rnd_from_seed(uint8_t* resbuf, uint32_t resbytes, uint8_t* seed);
 	//void gen_rnd(prf_state_ctx* prf_state, uint8_t* resbuf, uint32_t nbytes);
 	void gen_rnd_uniform(uint32_t* res, uint32_t mod);
@@ -0,0 +1,177 @@
+/**
+ \file 		record_layer.cpp
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+			it under the terms of the GNU Lesser General Public License as published
+			by the Free Software Foundation, either version 3 of the License, or
+			(at your option) any later version.
+			ABY is distributed in the hope that it will be useful,
+			but WITHOUT ANY WARRANTY; without even the implied warranty of
+			MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+			GNU Lesser General Public License for more details.
+			You should have received a copy of the GNU Lesser General Public License
+			along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		AES-GCM record layer for the traffic of SndThread / RcvThread
+ */
+
+#include "record_layer.h"
+#include "crypto.h"
+#include "../socket.h"
+#include "../typedefs.h"
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#define GCM_NONCE_BYTES		12
+//EVP takes int lengths, larger payloads are processed in chunks
+#define MAX_EVP_CHUNK_BYTES	(1<<30)
+
+
+record_layer::record_layer(const uint8_t* snd_key, const uint8_t* rcv_key)
+	: m_cSndCtx(EVP_CIPHER_CTX_new()), m_cRcvCtx(EVP_CIPHER_CTX_new()), m_nSndCtr(0), m_nRcvCtr(0),
+	  m_bKeysDerived(false)
+{
+	memcpy(m_vSndMasterKey, snd_key, AES_KEY_BYTES);
+	memcpy(m_vRcvMasterKey, rcv_key, AES_KEY_BYTES);
+	RAND_bytes(m_vSalt, RECORD_SALT_BYTES);
+}
+
+record_layer::record_layer(prf_state_ctx* prf_state, uint32_t role)
+	: m_cSndCtx(EVP_CIPHER_CTX_new()), m_cRcvCtx(EVP_CIPHER_CTX_new()), m_nSndCtr(0), m_nRcvCtr(0),
+	  m_bKeysDerived(false)
+{
+	assert(role == SERVER_ID || role == CLIENT_ID);
+	//the first key protects messages of the server, the second those of the client
+	uint8_t keys[2 * AES_KEY_BYTES];
+	gen_rnd_bytes(prf_state, keys, sizeof(keys));
+	memcpy(m_vSndMasterKey, keys + role * AES_KEY_BYTES, AES_KEY_BYTES);
+	memcpy(m_vRcvMasterKey, keys + (1 - role) * AES_KEY_BYTES, AES_KEY_BYTES);
+	memset(keys, 0, sizeof(keys));
+	//the salt must not come from the shared state, the other party would draw the same one
+	RAND_bytes(m_vSalt, RECORD_SALT_BYTES);
+}
+
+record_layer::~record_layer() {
+	EVP_CIPHER_CTX_free(m_cSndCtx);
+	EVP_CIPHER_CTX_free(m_cRcvCtx);
+	memset(m_vSndMasterKey, 0, AES_KEY_BYTES);
+	memset(m_vRcvMasterKey, 0, AES_KEY_BYTES);
+}
+
+bool record_layer::handshake(CSocket* sock) {
+	uint8_t peer_salt[RECORD_SALT_BYTES];
+	if(sock->Send(m_vSalt, RECORD_SALT_BYTES) != RECORD_SALT_BYTES
+			|| sock->Receive(peer_salt, RECORD_SALT_BYTES) != RECORD_SALT_BYTES) {
+		return false;
+	}
+	return derive_keys(peer_salt);
+}
+
+const uint8_t* record_layer::get_salt() const {
+	return m_vSalt;
+}
+
+bool record_layer::derive_keys(const uint8_t* peer_salt) {
+	assert(!m_bKeysDerived);
+	//the salts are ordered by sender, so both directions get different keys even if the master keys are equal
+	bool ok = init_ctx(m_cSndCtx, m_vSndMasterKey, m_vSalt, peer_salt, true)
+			&& init_ctx(m_cRcvCtx, m_vRcvMasterKey, peer_salt, m_vSalt, false);
+	memset(m_vSndMasterKey, 0, AES_KEY_BYTES);
+	memset(m_vRcvMasterKey, 0, AES_KEY_BYTES);
+	m_bKeysDerived = ok;
+	return ok;
+}
+
+bool record_layer::init_ctx(EVP_CIPHER_CTX* ctx, const uint8_t* master_key, const uint8_t* first_salt,
+		const uint8_t* second_salt, bool encrypt) {
+	if(ctx == nullptr) {
+		return false;
+	}
+	//key = HMAC-SHA256(master_key, salt of the sender || salt of the receiver), truncated to the AES key size
+	uint8_t salts[2 * RECORD_SALT_BYTES];
+	memcpy(salts, first_salt, RECORD_SALT_BYTES);
+	memcpy(salts + RECORD_SALT_BYTES, second_salt, RECORD_SALT_BYTES);
+	uint8_t key[EVP_MAX_MD_SIZE];
+	unsigned int keylen;
+	if(HMAC(EVP_sha256(), master_key, AES_KEY_BYTES, salts, sizeof(salts), key, &keylen) == nullptr) {
+		return false;
+	}
+
+	//the key schedule is computed once, every message only sets a new nonce
+	int ok;
+	if(encrypt) {
+		ok = EVP_EncryptInit_ex(ctx, EVP_aes_128_gcm(), nullptr, key, nullptr);
+	} else {
+		ok = EVP_DecryptInit_ex(ctx, EVP_aes_128_gcm(), nullptr, key, nullptr);
+	}
+	memset(key, 0, sizeof(key));
+	return ok == 1;
+}
+
+bool record_layer::set_nonce_and_header(EVP_CIPHER_CTX* ctx, uint64_t ctr, uint8_t channelid, uint64_t nbytes, bool encrypt) {
+	uint8_t nonce[GCM_NONCE_BYTES] = { 0 };
+	memcpy(nonce, &ctr, sizeof(ctr));
+
+	uint8_t header[sizeof(uint8_t) + sizeof(uint64_t)];
+	header[0] = channelid;
+	memcpy(header + 1, &nbytes, sizeof(nbytes));
+
+	int dummy;
+	if(encrypt) {
+		return EVP_EncryptInit_ex(ctx, nullptr, nullptr, nullptr, nonce) == 1
+				&& EVP_EncryptUpdate(ctx, nullptr, &dummy, header, sizeof(header)) == 1;
+	} else {
+		return EVP_DecryptInit_ex(ctx, nullptr, nullptr, nullptr, nonce) == 1
+				&& EVP_DecryptUpdate(ctx, nullptr, &dummy, header, sizeof(header)) == 1;
+	}
+}
+
+bool record_layer::seal_init(uint8_t channelid, uint64_t nbytes) {
+	assert(m_bKeysDerived);
+	return set_nonce_and_header(m_cSndCtx, m_nSndCtr++, channelid, nbytes, true);
+}
+
+bool record_layer::seal_update(const uint8_t* in, uint8_t* out, uint64_t nbytes) {
+	int outlen;
+	while(nbytes > 0) {
+		int len = std::min<uint64_t>(nbytes, MAX_EVP_CHUNK_BYTES);
+		//GCM is a stream mode, all of the input is written out immediately
+		if(EVP_EncryptUpdate(m_cSndCtx, out, &outlen, in, len) != 1 || outlen != len) {
+			return false;
+		}
+		in += len;
+		out += len;
+		nbytes -= len;
+	}
+	return true;
+}
+
+bool record_layer::seal_final(uint8_t* tag) {
+	int dummy;
+	return EVP_EncryptFinal_ex(m_cSndCtx, nullptr, &dummy) == 1
+			&& EVP_CIPHER_CTX_ctrl(m_cSndCtx, EVP_CTRL_GCM_GET_TAG, RECORD_TAG_BYTES, tag) == 1;
+}
+
+bool record_layer::open(uint8_t channelid, uint8_t* buf, uint64_t nbytes, const uint8_t* tag) {
+	assert(m_bKeysDerived);
+	if(!set_nonce_and_header(m_cRcvCtx, m_nRcvCtr++, channelid, nbytes, false)) {
+		return false;
+	}
+
+	int outlen;
+	uint8_t* pos = buf;
+	while(nbytes > 0) {
+		int len = std::min<uint64_t>(nbytes, MAX_EVP_CHUNK_BYTES);
+		if(EVP_DecryptUpdate(m_cRcvCtx, pos, &outlen, pos, len) != 1 || outlen != len) {
+			return false;
+		}
+		pos += len;
+		nbytes -= len;
+	}
+	return EVP_CIPHER_CTX_ctrl(m_cRcvCtx, EVP_CTRL_GCM_SET_TAG, RECORD_TAG_BYTES, const_cast<uint8_t*>(tag)) == 1
+			&& EVP_DecryptFinal_ex(m_cRcvCtx, nullptr, &outlen) > 0;
+}
@@ -0,0 +1,118 @@
+/**
+ \file 		record_layer.h
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+			it under the terms of the GNU Lesser General Public License as published
+			by the Free Software Foundation, either version 3 of the License, or
+			(at your option) any later version.
+			ABY is distributed in the hope that it will be useful,
+			but WITHOUT ANY WARRANTY; without even the implied warranty of
+			MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+			GNU Lesser General Public License for more details.
+			You should have received a copy of the GNU Lesser General Public License
+			along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		AES-GCM record layer for the traffic of SndThread / RcvThread
+ */
+
+#ifndef RECORD_LAYER_H_
+#define RECORD_LAYER_H_
+
+#include "../constants.h"
+#include <openssl/evp.h>
+#include <cstddef>
+#include <cstdint>
+
+class CSocket;
+struct prf_state_ctx;
+
+#define RECORD_TAG_BYTES	16
+#define RECORD_SALT_BYTES	16
+
+/**
+	Authenticated encryption of the messages between a SndThread and the RcvThread of the other party.
+	Every message is sealed with AES-128-GCM under a per-direction key. The nonce is the implicit number of the
+	message in its direction, so reordered, replayed or dropped messages fail to authenticate. The channel id
+	and the length field of the message header are authenticated as additional data and the tag is appended
+	to the payload.
+
+	The master keys have to be pre-shared or agreed on over an authenticated channel. They are never used to
+	encrypt directly: since the nonces restart at 0 for every connection, handshake() derives fresh keys for each
+	connection from the master keys and a random salt of each party. A record_layer object protects exactly one
+	connection, and its handshake() has to run before the send and receive threads are started.
+
+	Sealing is only used by the send thread and opening only by the receive thread, hence a single object can
+	be shared by both threads of a connection.
+*/
+class record_layer {
+public:
+	/**
+		\param	snd_key	- AES_KEY_BYTES master key of outgoing messages
+		\param	rcv_key	- AES_KEY_BYTES master key of incoming messages, the other party uses it as snd_key
+	*/
+	record_layer(const uint8_t* snd_key, const uint8_t* rcv_key);
+	~record_layer();
+
+	record_layer(const record_layer&) = delete;
+	record_layer& operator=(const record_layer&) = delete;
+
+	/**
+		Derive the keys of both directions from a state that both parties share, which has to be initialized with a
+		pre-shared secret seed via crypto::init_prf_state.
+		Keys derived from crypto::gen_common_seed are insecure: it sends both seed shares in the clear, so anyone who
+		observes the link can compute both keys, and the record layer then provides no confidentiality and no
+		authenticity at all.
+		\param	prf_state	- shared state from a pre-shared seed, advanced by 2*AES_KEY_BYTES
+		\param	role		- SERVER_ID or CLIENT_ID, the parties have to use different roles
+	*/
+	record_layer(prf_state_ctx* prf_state, uint32_t role);
+
+	/**
+		Exchange the salts with the other party over sock and derive the keys of this connection. Has to be called
+		by both parties before the threads that use the record layer are started.
+		\return false if the salts could not be exchanged or the keys not be derived
+	*/
+	bool handshake(CSocket* sock);
+
+	/** The fresh random salt of this party, which the other party passes to derive_keys() */
+	const uint8_t* get_salt() const;
+
+	/**
+		Derive the keys of this connection from the master keys and the salts of both parties, done by handshake().
+		Can be called only once.
+		\return false if OpenSSL failed, the record layer must not be used then
+	*/
+	bool derive_keys(const uint8_t* peer_salt);
+
+	//Sealing a message takes one seal_init(), any number of seal_update() and one seal_final() call. Each of them
+	//returns false if OpenSSL failed, the message is lost then and the connection cannot be used any more.
+	/** Start sealing the next outgoing message with nbytes payload bytes on channelid */
+	bool seal_init(uint8_t channelid, uint64_t nbytes);
+	/** Encrypt the next nbytes of the payload from in to out, in and out may be equal */
+	bool seal_update(const uint8_t* in, uint8_t* out, uint64_t nbytes);
+	/** Finish the message and write its RECORD_TAG_BYTES tag */
+	bool seal_final(uint8_t* tag);
+
+	/**
+		Decrypt an incoming message with nbytes payload bytes on channelid in place and check its tag.
+		\return false if the message was not authentic or OpenSSL failed, buf is garbage in that case.
+	*/
+	bool open(uint8_t channelid, uint8_t* buf, uint64_t nbytes, const uint8_t* tag);
+
+private:
+	bool init_ctx(EVP_CIPHER_CTX* ctx, const uint8_t* master_key, const uint8_t* first_salt, const uint8_t* second_salt,
+			bool encrypt);
+	bool set_nonce_and_header(EVP_CIPHER_CTX* ctx, uint64_t ctr, uint8_t channelid, uint64_t nbytes, bool encrypt);
+
+	EVP_CIPHER_CTX* m_cSndCtx;
+	EVP_CIPHER_CTX* m_cRcvCtx;
+	uint64_t m_nSndCtr;
+	uint64_t m_nRcvCtr;
+	uint8_t m_vSndMasterKey[AES_KEY_BYTES];
+	uint8_t m_vRcvMasterKey[AES_KEY_BYTES];
+	uint8_t m_vSalt[RECORD_SALT_BYTES];
+	bool m_bKeysDerived;
+};
+
+#endif /* RECORD_LAYER_H_ */
@@ -0,0 +1,285 @@
+/**
+ \file 		fixed_bitvector.h
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Bit vectors of a fixed size
+ */
+
+#ifndef FIXED_BITVECTOR_H_
+#define FIXED_BITVECTOR_H_
+
+#include "bitkernels.h"
+#include "cbitvector.h"
+#include "crypto/Config.h"
+#include "typedefs.h"
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+
+//Operations on the words of FixedBitVector, applied to plain words and to GCC vectors of words
+struct fixed_xor_op {
+	template<class V> static constexpr void apply(V& x, const V& y) {
+		x ^= y;
+	}
+};
+
+struct fixed_and_op {
+	template<class V> static constexpr void apply(V& x, const V& y) {
+		x &= y;
+	}
+};
+
+struct fixed_or_op {
+	template<class V> static constexpr void apply(V& x, const V& y) {
+		x |= y;
+	}
+};
+
+/**
+	Bit vector of N bits with the size known at compile time, which lives on the stack or inside other objects and needs
+	neither allocations nor bounds logic, e.g., for 128 bit seeds and labels or 256 bit codewords. The bits are stored
+	in the byte order of CBitVector, such that rows of a CBitVector can be loaded and stored directly. Bits beyond N in
+	the last word are always zero.
+
+	Vectors of 128, 256 and 512 bits are combined as one GCC vector, i.e., in one SSE, AVX or AVX-512 register if the
+	code is compiled for it. Construction, bit access, comparison, PopCount() and the bitwise operators are constexpr.
+*/
+template<std::size_t N> class FixedBitVector {
+	static_assert(N > 0, "FixedBitVector needs at least one bit");
+
+public:
+	static constexpr std::size_t BITS = N;
+	static constexpr std::size_t BYTES = (N + 7) / 8;
+	static constexpr std::size_t WORDS = (N + 63) / 64;
+
+	constexpr FixedBitVector() : m_nWords {} {
+	}
+
+	/** Set the words of the vector, lowest first. Missing words are zero. */
+	constexpr FixedBitVector(std::initializer_list<uint64_t> words) : m_nWords {} {
+		assert(words.size() <= WORDS);
+		std::size_t i = 0;
+		for (uint64_t w : words) {
+			m_nWords[i++] = w;
+		}
+		ClearTail();
+	}
+
+	/** Load BYTES bytes from p */
+	explicit FixedBitVector(const BYTE* p) {
+		Load(p);
+	}
+
+	/** Load bits [pos, pos+N) of vec, numbered as in CBitVector::GetBits() */
+	FixedBitVector(const CBitVector& vec, std::size_t pos) {
+		Load(vec, pos);
+	}
+
+	template<std::size_t M = N, typename std::enable_if<M == 128, int>::type = 0> explicit FixedBitVector(const block& b) {
+		SetBlock(0, b);
+	}
+
+	void Load(const BYTE* p) {
+		m_nWords[WORDS - 1] = 0;
+		memcpy(m_nWords, p, BYTES);
+		ClearTail();
+	}
+
+	void Store(BYTE* p) const {
+		memcpy(p, m_nWords, BYTES);
+	}
+
+	void Load(const CBitVector& vec, std::size_t pos) {
+		assert(pos + N <= vec.GetSize() << 3);
+		if (pos % 8 == 0) {
+			Load(vec.GetArr() + pos / 8);
+		} else {
+			m_nWords[WORDS - 1] = 0;
+			bit_copy((BYTE*) m_nWords, 0, vec.GetArr(), pos, N);
+		}
+	}
+
+	/** Set bits [pos, pos+N) of vec to this vector */
+	void Store(CBitVector& vec, std::size_t pos) const {
+		assert(pos + N <= vec.GetSize() << 3);
+		bit_copy(vec.GetArr(), pos, (const BYTE*) m_nWords, 0, N);
+	}
+
+	/** XOR this vector onto bits [pos, pos+N) of vec */
+	void XORInto(CBitVector& vec, std::size_t pos) const {
+		assert(pos + N <= vec.GetSize() << 3);
+		bit_xor(vec.GetArr(), pos, (const BYTE*) m_nWords, 0, N);
+	}
+
+	/** \return the i-th 128 bit block */
+	block GetBlock(std::size_t i) const {
+		static_assert(N % 128 == 0, "FixedBitVector does not consist of blocks");
+		assert(i < N / 128);
+		return _mm_loadu_si128((const block*) m_nWords + i);
+	}
+
+	void SetBlock(std::size_t i, const block& b) {
+		static_assert(N % 128 == 0, "FixedBitVector does not consist of blocks");
+		assert(i < N / 128);
+		_mm_storeu_si128((block*) m_nWords + i, b);
+	}
+
+	BYTE* GetArr() {
+		return (BYTE*) m_nWords;
+	}
+
+	const BYTE* GetArr() const {
+		return (const BYTE*) m_nWords;
+	}
+
+	constexpr uint64_t GetWord(std::size_t i) const {
+		return m_nWords[i];
+	}
+
+	constexpr BYTE GetByte(std::size_t i) const {
+		return (m_nWords[i / 8] >> (8 * (i % 8))) & 0xFF;
+	}
+
+	/** Bit access in the order of CBitVector::GetBit(), i.e., MSB first within a byte */
+	constexpr BYTE GetBit(std::size_t i) const {
+		return GetBitNoMask((i & ~(std::size_t) 7) | (7 - (i & 7)));
+	}
+
+	constexpr void SetBit(std::size_t i, BYTE b) {
+		SetBitNoMask((i & ~(std::size_t) 7) | (7 - (i & 7)), b);
+	}
+
+	/** Bit access in the order of CBitVector::GetBitNoMask(), i.e., LSB first within a byte */
+	constexpr BYTE GetBitNoMask(std::size_t i) const {
+		assert(i < N);
+		return (m_nWords[i / 64] >> (i % 64)) & 1;
+	}
+
+	constexpr void SetBitNoMask(std::size_t i, BYTE b) {
+		assert(i < N);
+		m_nWords[i / 64] = (m_nWords[i / 64] & ~((uint64_t) 1 << (i % 64))) | ((uint64_t) (b & 1) << (i % 64));
+	}
+
+	constexpr void Reset() {
+		for (std::size_t i = 0; i < WORDS; i++) {
+			m_nWords[i] = 0;
+		}
+	}
+
+	constexpr void SetToOne() {
+		for (std::size_t i = 0; i < WORDS; i++) {
+			m_nWords[i] = ~(uint64_t) 0;
+		}
+		ClearTail();
+	}
+
+	constexpr std::size_t PopCount() const {
+		std::size_t ones = 0;
+		for (std::size_t i = 0; i < WORDS; i++) {
+			ones += __builtin_popcountll(m_nWords[i]);
+		}
+		return ones;
+	}
+
+	constexpr bool IsZero() const {
+		uint64_t x = 0;
+		for (std::size_t i = 0; i < WORDS; i++) {
+			x |= m_nWords[i];
+		}
+		return x == 0;
+	}
+
+	constexpr FixedBitVector& operator^=(const FixedBitVector& b) {
+		Combine<fixed_xor_op>(b);
+		return *this;
+	}
+
+	constexpr FixedBitVector& operator&=(const FixedBitVector& b) {
+		Combine<fixed_and_op>(b);
+		return *this;
+	}
+
+	constexpr FixedBitVector& operator|=(const FixedBitVector& b) {
+		Combine<fixed_or_op>(b);
+		return *this;
+	}
+
+	constexpr FixedBitVector operator^(const FixedBitVector& b) const {
+		FixedBitVector r(*this);
+		return r ^= b;
+	}
+
+	constexpr FixedBitVector operator&(const FixedBitVector& b) const {
+		FixedBitVector r(*this);
+		return r &= b;
+	}
+
+	constexpr FixedBitVector operator|(const FixedBitVector& b) const {
+		FixedBitVector r(*this);
+		return r |= b;
+	}
+
+	constexpr FixedBitVector operator~() const {
+		FixedBitVector r;
+		r.SetToOne();
+		return r ^= *this;
+	}
+
+	constexpr bool operator==(const FixedBitVector& b) const {
+		uint64_t x = 0;
+		for (std::size_t i = 0; i < WORDS; i++) {
+			x |= m_nWords[i] ^ b.m_nWords[i];
+		}
+		return x == 0;
+	}
+
+	constexpr bool operator!=(const FixedBitVector& b) const {
+		return !(*this == b);
+	}
+
+private:
+	static constexpr bool VECTOR_WORDS = N == 128 || N == 256 || N == 512;
+
+	//the vector path is taken at run time only, GCC vectors cannot be used in constant expressions
+	template<class OP> constexpr void Combine(const FixedBitVector& b) {
+		if (VECTOR_WORDS && !__builtin_is_constant_evaluated()) {
+			CombineVector<OP>(b);
+		} else {
+			for (std::size_t i = 0; i < WORDS; i++) {
+				OP::apply(m_nWords[i], b.m_nWords[i]);
+			}
+		}
+	}
+
+	template<class OP> void CombineVector(const FixedBitVector& b) {
+		typedef uint64_t vec __attribute__((vector_size(VECTOR_WORDS ? N / 8 : 8)));
+		vec x, y;
+		memcpy(&x, m_nWords, sizeof(vec));
+		memcpy(&y, b.m_nWords, sizeof(vec));
+		OP::apply(x, y);
+		memcpy(m_nWords, &x, sizeof(vec));
+	}
+
+	constexpr void ClearTail() {
+		if (N % 64) {
+			m_nWords[WORDS - 1] &= ((uint64_t) 1 << (N % 64)) - 1;
+		}
+	}
+
+	alignas(16) uint64_t m_nWords[WORDS];
+};
+
+#endif /* FIXED_BITVECTOR_H_ */
@@ -0,0 +1,169 @@
+/**
+ \file 		gf2_matrix.cpp
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Dense matrices over GF(2)
+ */
+
+#include "gf2_matrix.h"
+#include "bitkernels.h"
+#include "graycode.h"
+#include "thread.h"
+#include "utils.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+//Rows of the right-hand side that are combined in one M4RM table, one byte of a left-hand side row indexes the table
+constexpr std::size_t M4RM_ROWS = 8;
+constexpr std::size_t M4RM_ENTRIES = 1 << M4RM_ROWS;
+
+//Column strips of this many bytes are split among threads, and processed in strips of at most STRIP_BYTES bytes, such
+//that a table of M4RM_ENTRIES strip rows stays in the L2 cache
+constexpr std::size_t STRIP_GRAIN = 64;
+constexpr std::size_t STRIP_BYTES = 512;
+
+} // namespace
+
+
+GF2Matrix::GF2Matrix() : m_nRows(0), m_nColumns(0), m_nRowBytes(0) {
+}
+
+GF2Matrix::GF2Matrix(std::size_t rows, std::size_t columns) {
+	Create(rows, columns);
+}
+
+void GF2Matrix::Create(std::size_t rows, std::size_t columns) {
+	m_nRows = rows;
+	m_nColumns = columns;
+	m_nRowBytes = ceil_divide(columns, 64) * 8;
+	m_vBits.CreateExact(rows * m_nRowBytes * 8);
+}
+
+std::size_t GF2Matrix::GetRows() const {
+	return m_nRows;
+}
+
+std::size_t GF2Matrix::GetColumns() const {
+	return m_nColumns;
+}
+
+std::size_t GF2Matrix::GetRowBytes() const {
+	return m_nRowBytes;
+}
+
+BYTE* GF2Matrix::GetRow(std::size_t i) {
+	assert(i < m_nRows);
+	return m_vBits.GetArr() + i * m_nRowBytes;
+}
+
+const BYTE* GF2Matrix::GetRow(std::size_t i) const {
+	assert(i < m_nRows);
+	return m_vBits.GetArr() + i * m_nRowBytes;
+}
+
+CBitVectorView GF2Matrix::Row(std::size_t i) {
+	return CBitVectorView(GetRow(i), 0, m_nColumns);
+}
+
+CBitVectorConstView GF2Matrix::Row(std::size_t i) const {
+	return CBitVectorConstView(GetRow(i), 0, m_nColumns);
+}
+
+BYTE GF2Matrix::GetBit(std::size_t i, std::size_t j) const {
+	assert(j < m_nColumns);
+	return (GetRow(i)[j >> 3] >> (j & 0x07)) & 0x01;
+}
+
+void GF2Matrix::SetBit(std::size_t i, std::size_t j, BYTE b) {
+	assert(j < m_nColumns);
+	BYTE* p = GetRow(i) + (j >> 3);
+	*p = (*p & ~(1 << (j & 0x07))) | ((b & 0x01) << (j & 0x07));
+}
+
+void GF2Matrix::Reset() {
+	m_vBits.Reset();
+}
+
+bool GF2Matrix::IsEqual(const GF2Matrix& other) const {
+	return m_nRows == other.m_nRows && m_nColumns == other.m_nColumns
+			&& equal_bytes(m_vBits.GetArr(), other.m_vBits.GetArr(), m_nRows * m_nRowBytes);
+}
+
+//The table of rows c, ..., c+7 of b over a strip is built in Gray code order, entry gray[i+1] differs from entry gray[i]
+//in the row inc[i]. The padding bits of the rows of a are zero, so a last chunk of less than 8 rows needs fewer entries.
+void GF2Matrix::SetProduct(const GF2Matrix& a, const GF2Matrix& b, uint32_t nthreads) {
+	assert(a.m_nColumns == b.m_nRows && &a != this && &b != this);
+	Create(a.m_nRows, b.m_nColumns);
+	uint32_t* gray = BuildGrayCode(M4RM_ENTRIES);
+	uint32_t* inc = BuildGrayCodeIncrement(M4RM_ENTRIES);
+
+	ParallelFor(m_nRowBytes, STRIP_GRAIN, nthreads, [&] (std::size_t b0, std::size_t b1) {
+		std::vector<BYTE> table(M4RM_ENTRIES * STRIP_BYTES);
+		BYTE* t = table.data();
+		for (std::size_t s = b0; s < b1; s += STRIP_BYTES) {
+			std::size_t w = std::min(STRIP_BYTES, b1 - s);
+			for (std::size_t c = 0; c < a.m_nColumns; c += M4RM_ROWS) {
+				std::size_t entries = (std::size_t) 1 << std::min(M4RM_ROWS, a.m_nColumns - c);
+				memset(t, 0, w);
+				for (std::size_t i = 0; i + 1 < entries; i++) {
+					set_xor_bytes(t + gray[i + 1] * w, t + gray[i] * w, b.GetRow(c + inc[i]) + s, w);
+				}
+				for (std::size_t r = 0; r < m_nRows; r++) {
+					BYTE idx = a.GetRow(r)[c / M4RM_ROWS];
+					if (idx) {
+						xor_bytes(GetRow(r) + s, t + idx * w, w);
+					}
+				}
+			}
+		}
+	});
+	free(gray);
+	free(inc);
+}
+
+void GF2Matrix::MultiplyVector(CBitVector& y, const CBitVector& x, uint32_t nthreads) const {
+	assert(x.GetSize() * 8 >= m_nColumns);
+	y.Create(m_nRows);
+	std::vector<uint64_t> xwords(m_nRowBytes / 8);
+	memcpy(xwords.data(), x.GetArr(), std::min(x.GetSize(), m_nRowBytes));
+
+	//threads write whole bytes of y
+	ParallelFor(m_nRows, 64, nthreads, [&] (std::size_t r0, std::size_t r1) {
+		for (std::size_t r = r0; r < r1; r++) {
+			const uint64_t* row = (const uint64_t*) GetRow(r);
+			uint64_t acc = 0;
+			for (std::size_t w = 0; w < xwords.size(); w++) {
+				acc ^= row[w] & xwords[w];
+			}
+			y.SetBitNoMask(r, __builtin_parityll(acc));
+		}
+	});
+}
+
+void GF2Matrix::MultiplyVectorLeft(CBitVector& y, const CBitVector& x, uint32_t nthreads) const {
+	assert(x.GetSize() * 8 >= m_nRows);
+	y.Create(m_nColumns);
+	ParallelFor(ceil_divide(m_nColumns, 8), STRIP_GRAIN, nthreads, [&] (std::size_t b0, std::size_t b1) {
+		for (std::size_t r = 0; r < m_nRows; r++) {
+			if (x.GetBitNoMask(r)) {
+				xor_bytes(y.GetArr() + b0, GetRow(r) + b0, b1 - b0);
+			}
+		}
+	});
+}
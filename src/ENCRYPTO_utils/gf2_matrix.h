@@ -0,0 +1,83 @@
+/**
+ \file 		gf2_matrix.h
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Dense matrices over GF(2)
+ */
+
+#ifndef GF2_MATRIX_H_
+#define GF2_MATRIX_H_
+
+#include "cbitvector.h"
+#include "cbitvector_view.h"
+#include "typedefs.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+	Dense matrix over GF(2), stored row by row in a CBitVector. Every row starts at a multiple of 8 bytes and bit j of a
+	row is numbered as in CBitVector::GetBitNoMask(), i.e., it is bit j % 8 of byte j / 8 counted from the LSB. The
+	padding bits at the end of each row are always zero.
+
+	Products with other matrices use the Method of Four Russians (M4RM): for every 8 rows of the right-hand side a table
+	of all 256 combinations of the rows is built in Gray code order with one row XOR per entry, and each row of the
+	left-hand side then adds one table entry per byte. Threads work on disjoint strips of columns.
+*/
+class GF2Matrix {
+public:
+	GF2Matrix();
+	/** Zero matrix of the given size */
+	GF2Matrix(std::size_t rows, std::size_t columns);
+
+	/** Resize to a zero matrix of the given size */
+	void Create(std::size_t rows, std::size_t columns);
+
+	std::size_t GetRows() const;
+	std::size_t GetColumns() const;
+	/** \return the distance of two rows in bytes, a multiple of 8 */
+	std::size_t GetRowBytes() const;
+
+	BYTE* GetRow(std::size_t i);
+	const BYTE* GetRow(std::size_t i) const;
+	/** \return a view of the columns bits of row i */
+	CBitVectorView Row(std::size_t i);
+	CBitVectorConstView Row(std::size_t i) const;
+
+	BYTE GetBit(std::size_t i, std::size_t j) const;
+	void SetBit(std::size_t i, std::size_t j, BYTE b);
+
+	void Reset();
+	bool IsEqual(const GF2Matrix& other) const;
+
+	/**
+		this = a * b, computed with M4RM.
+		\param	a			-	rows x k matrix, must not be this.
+		\param	b			-	k x columns matrix, must not be this.
+		\param	nthreads	-	Number of threads, 0 uses all hardware threads.
+	*/
+	void SetProduct(const GF2Matrix& a, const GF2Matrix& b, uint32_t nthreads = 1);
+
+	/** y = this * x, i.e., bit i of y is the inner product of row i and x. y gets GetRows() bits. */
+	void MultiplyVector(CBitVector& y, const CBitVector& x, uint32_t nthreads = 1) const;
+	/** y = x^T * this, i.e., the XOR of the rows i for which bit i of x is set. y gets GetColumns() bits. */
+	void MultiplyVectorLeft(CBitVector& y, const CBitVector& x, uint32_t nthreads = 1) const;
+
+private:
+	CBitVector m_vBits;
+	std::size_t m_nRows;
+	std::size_t m_nColumns;
+	std::size_t m_nRowBytes;
+};
+
+#endif /* GF2_MATRIX_H_ */
@@ -0,0 +1,121 @@
+/**
+ \file 		rank_select.cpp
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Rank / select index for CBitVector
+ */
+
+#include "rank_select.h"
+#include "bitkernels.h"
+#include "cbitvector.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace {
+
+constexpr std::size_t BLOCK_BYTES = 64;
+constexpr std::size_t BLOCKS_PER_SUPERBLOCK = 8;
+
+//ones in the first n < 8 bits of a byte in GetBit() order
+inline std::size_t popcount_prefix(BYTE b, std::size_t n) {
+	return __builtin_popcount(b & (BYTE) ~(0xFF >> n));
+}
+
+} // namespace
+
+
+RankSelectIndex::RankSelectIndex(const CBitVector& vec, std::size_t bits)
+	: RankSelectIndex(vec.GetArr(), bits) {
+	assert(bits <= vec.GetSize() * 8);
+}
+
+RankSelectIndex::RankSelectIndex(const BYTE* p, std::size_t bits) : m_pBits(p), m_nBits(bits) {
+	std::size_t fullbytes = bits / 8;
+	std::size_t nblocks = fullbytes / BLOCK_BYTES + 1;
+	m_vBlocks.resize(nblocks);
+	m_vSuperblocks.reserve(nblocks / BLOCKS_PER_SUPERBLOCK + 2);
+
+	uint64_t total = 0, superbase = 0;
+	for (std::size_t b = 0; b < nblocks; b++) {
+		if (b % BLOCKS_PER_SUPERBLOCK == 0) {
+			m_vSuperblocks.push_back(total);
+			superbase = total;
+		}
+		m_vBlocks[b] = total - superbase;
+		std::size_t start = b * BLOCK_BYTES;
+		total += popcount_bytes(p + start, std::min(BLOCK_BYTES, fullbytes - start));
+	}
+	if (bits % 8) {
+		total += popcount_prefix(p[fullbytes], bits % 8);
+	}
+	m_vSuperblocks.push_back(total);
+}
+
+std::size_t RankSelectIndex::Rank(std::size_t pos) const {
+	assert(pos <= m_nBits);
+	std::size_t byte = pos / 8;
+	std::size_t block = byte / BLOCK_BYTES;
+	std::size_t rank = m_vSuperblocks[block / BLOCKS_PER_SUPERBLOCK] + m_vBlocks[block];
+	rank += popcount_bytes(m_pBits + block * BLOCK_BYTES, byte - block * BLOCK_BYTES);
+	if (pos % 8) {
+		rank += popcount_prefix(m_pBits[byte], pos % 8);
+	}
+	return rank;
+}
+
+std::size_t RankSelectIndex::Select(std::size_t k) const {
+	if (k >= GetOnes()) {
+		return m_nBits;
+	}
+	//last superblock and then last block within it that start with at most k ones before them
+	std::size_t super = std::upper_bound(m_vSuperblocks.begin(), m_vSuperblocks.end() - 1, k) - m_vSuperblocks.begin() - 1;
+	k -= m_vSuperblocks[super];
+	std::size_t block = super * BLOCKS_PER_SUPERBLOCK;
+	std::size_t blockend = std::min(block + BLOCKS_PER_SUPERBLOCK, m_vBlocks.size());
+	while (block + 1 < blockend && m_vBlocks[block + 1] <= k) {
+		block++;
+	}
+	k -= m_vBlocks[block];
+
+	//scan words and then bytes, the searched one is within the indexed bits and stops the scan before their end
+	std::size_t byte = block * BLOCK_BYTES;
+	std::size_t ones;
+	uint64_t word;
+	for (std::size_t end = (m_nBits + 7) / 8; byte + sizeof(word) <= end; byte += sizeof(word)) {
+		memcpy(&word, m_pBits + byte, sizeof(word));
+		if ((ones = __builtin_popcountll(word)) > k) {
+			break;
+		}
+		k -= ones;
+	}
+	while ((ones = __builtin_popcount(m_pBits[byte])) <= k) {
+		k -= ones;
+		byte++;
+	}
+	std::size_t bit = 0;
+	for (BYTE b = m_pBits[byte];; bit++) {
+		if (b & (0x80 >> bit)) {
+			if (k == 0) {
+				break;
+			}
+			k--;
+		}
+	}
+	return byte * 8 + bit;
+}
+
+std::size_t RankSelectIndex::GetOnes() const {
+	return m_vSuperblocks.back();
+}
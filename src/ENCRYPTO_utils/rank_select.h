@@ -0,0 +1,60 @@
+/**
+ \file 		rank_select.h
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Rank / select index for CBitVector
+ */
+
+#ifndef RANK_SELECT_H_
+#define RANK_SELECT_H_
+
+#include "typedefs.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class CBitVector;
+
+/**
+	Succinct index over a bit vector that answers rank queries in constant time and select queries in logarithmic time.
+	It stores the number of ones before every superblock of 4096 bits and, relative to it, before every block of 512
+	bits, i.e., about 5% of the size of the vector. Bits are numbered as in CBitVector::GetBit(). The index refers to
+	the buffer of the vector, which must neither be modified nor reallocated while the index is in use.
+*/
+class RankSelectIndex {
+public:
+	/**
+		\param	vec		-	Vector to be indexed.
+		\param	bits	-	Number of bits from the start of vec that are indexed.
+	*/
+	RankSelectIndex(const CBitVector& vec, std::size_t bits);
+	RankSelectIndex(const BYTE* p, std::size_t bits);
+
+	/** \return the number of ones in bits [0, pos), pos is at most the number of indexed bits */
+	std::size_t Rank(std::size_t pos) const;
+
+	/** \return the position of the one with rank k, i.e., the (k+1)-th one, or the number of indexed bits if there is none */
+	std::size_t Select(std::size_t k) const;
+
+	/** \return the number of ones in the indexed bits */
+	std::size_t GetOnes() const;
+
+private:
+	const BYTE* m_pBits;
+	std::size_t m_nBits;
+	std::vector<uint64_t> m_vSuperblocks; //ones before each superblock, the last entry is the total
+	std::vector<uint16_t> m_vBlocks; //ones before each block within its superblock
+};
+
+#endif /* RANK_SELECT_H_ */
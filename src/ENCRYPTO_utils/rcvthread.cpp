@@ -21,13 +21,14 @@
 #include "typedefs.h"
 #include "constants.h"
 #include "socket.h"
+#include "crypto/record_layer.h"
 #include <cassert>
 #include <cstdlib>
 #include <iostream>
 
 
 RcvThread::RcvThread(CSocket* sock, CLock *glock)
-	:rcvlock(glock),  mysock(sock), listeners()
+	:rcvlock(glock),  mysock(sock), m_bFailed(false), m_nLocalCopyBytes(0), m_nRemoteCopyBytes(0), listeners()
 {
 	listeners[ADMIN_CHANNEL].inuse = true;
 }
@@ -58,6 +59,30 @@ void RcvThread::flush_queue(uint8_t channelid) {
 	}
 }
 
+uint64_t RcvThread::consume_fin(uint8_t channelid) {
+	std::lock_guard<std::mutex> lock(listeners[channelid].rcv_buf_mutex);
+	rcv_task& task = listeners[channelid];
+	//no fin is pending if the fin event was set because the connection failed
+	if(task.num_queued_at_fin.empty()) {
+		return task.num_queued;
+	}
+	uint64_t num_queued_at_fin = task.num_queued_at_fin.front();
+	task.num_queued_at_fin.pop();
+	return num_queued_at_fin;
+}
+
+void RcvThread::flush_queue_before_fin(uint8_t channelid, uint64_t num_queued_at_fin) {
+	std::lock_guard<std::mutex> lock(listeners[channelid].rcv_buf_mutex);
+	rcv_task& task = listeners[channelid];
+	//the front block is the (num_queued - size)-th block that was ever queued
+	while(!task.rcv_buf.empty() && task.num_queued - task.rcv_buf.size() < num_queued_at_fin) {
+		rcv_ctx* tmp = task.rcv_buf.front();
+		free(tmp->buf);
+		free(tmp);
+		task.rcv_buf.pop();
+	}
+}
+
 void RcvThread::remove_listener(uint8_t channelid) {
 	rcvlock->Lock();
 	if(listeners[channelid].inuse) {
@@ -92,6 +117,10 @@ RcvThread::add_listener(uint8_t channelid, CEvent* rcv_event, CEvent* fin_event)
 	listeners[channelid].fin_event = fin_event;
 	listeners[channelid].inuse = true;
 //		assert(listeners[channelid].rcv_buf->empty());
+	if(m_bFailed) {
+		fin_event->Set();
+		rcv_event->Set();
+	}
 
 	//std::cout << "Successfully registered on channel " << (uint32_t) channelid << std::endl;
 
@@ -109,6 +138,87 @@ std::mutex& RcvThread::get_listener_mutex(uint8_t channelid)
 	return listeners[channelid].rcv_buf_mutex;
 }
 
+bool RcvThread::post_receive(uint8_t channelid, uint8_t* buf, uint64_t nbytes) {
+	std::lock_guard<std::mutex> lock(listeners[channelid].rcv_buf_mutex);
+	if(!listeners[channelid].rcv_buf.empty()) {
+		return false;
+	}
+	assert(listeners[channelid].posted_buf == nullptr);
+	listeners[channelid].posted_buf = buf;
+	listeners[channelid].posted_bytes = nbytes;
+	listeners[channelid].posted_done = false;
+	return true;
+}
+
+RcvThread::posted_state RcvThread::check_posted_receive(uint8_t channelid) {
+	std::lock_guard<std::mutex> lock(listeners[channelid].rcv_buf_mutex);
+	rcv_task& task = listeners[channelid];
+	if(task.posted_done) {
+		task.posted_done = false;
+		return posted_state::done;
+	}
+	//the receiver thread only takes the posted buffer while the queue is empty, so queued data means it was skipped
+	if(task.posted_buf != nullptr && !task.rcv_buf.empty()) {
+		task.posted_buf = nullptr;
+		return posted_state::cancelled;
+	}
+	return posted_state::pending;
+}
+
+void RcvThread::set_record_layer(record_layer* rl) {
+	m_cRecordLayer = rl;
+}
+
+bool RcvThread::has_failed() const {
+	return m_bFailed;
+}
+
+//m_bFailed is set before the events, so a receiver that checks it and then waits is always woken up
+void RcvThread::fail() {
+	m_bFailed = true;
+	rcvlock->Lock();
+	for(size_t i = 0; i < listeners.size(); i++) {
+		if(i != ADMIN_CHANNEL && listeners[i].inuse) {
+			listeners[i].fin_event->Set();
+			listeners[i].rcv_event->Set();
+		}
+	}
+	rcvlock->Unlock();
+}
+
+bool RcvThread::receive_payload(uint8_t channelid, uint8_t* buf, uint64_t nbytes) {
+	if(nbytes > 0) {
+		mysock->Receive(buf, nbytes);
+	}
+	if(m_cRecordLayer == nullptr) {
+		return true;
+	}
+	uint8_t tag[RECORD_TAG_BYTES];
+	mysock->Receive(tag, RECORD_TAG_BYTES);
+	if(!m_cRecordLayer->open(channelid, buf, nbytes, tag)) {
+		std::cerr << "Received a message on channel " << (uint32_t) channelid << " that could not be authenticated, "
+				"stopping the receiver thread" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void RcvThread::count_copy(int buf_node, uint64_t nbytes) {
+	int node = CurrentNumaNode();
+	if(buf_node < 0 || node < 0 || buf_node == node) {
+		m_nLocalCopyBytes.fetch_add(nbytes, std::memory_order_relaxed);
+	} else {
+		m_nRemoteCopyBytes.fetch_add(nbytes, std::memory_order_relaxed);
+	}
+}
+
+uint64_t RcvThread::get_local_copy_bytes() const {
+	return m_nLocalCopyBytes;
+}
+
+uint64_t RcvThread::get_remote_copy_bytes() const {
+	return m_nRemoteCopyBytes;
+}
 
 void RcvThread::ThreadMain() {
 	uint8_t channelid;
@@ -126,9 +236,21 @@ void RcvThread::ThreadMain() {
 					" bytes length (" << rcv_len << ")" << std::endl;
 #endif
 
+			if(m_cRecordLayer != nullptr) {
+				if(rcvbytelen < RECORD_TAG_BYTES) {
+					std::cerr << "Received a message without authentication tag, stopping the receiver thread" << std::endl;
+					fail();
+					return;
+				}
+				rcvbytelen -= RECORD_TAG_BYTES;
+			}
+
 			if(channelid == ADMIN_CHANNEL) {
 				std::vector<uint8_t> tmprcvbuf(rcvbytelen);
-				mysock->Receive(tmprcvbuf.data(), rcvbytelen);
+				if(!receive_payload(channelid, tmprcvbuf.data(), rcvbytelen)) {
+					fail();
+					return;
+				}
 
 				//TODO: Right now finish, can be used for other maintenance tasks
 				//std::cout << "Got message on Admin channel, shutting down" << std::endl;
@@ -138,19 +260,60 @@ void RcvThread::ThreadMain() {
 				return;//continue;
 			}
 
+			uint8_t* posted_buf = nullptr;
+			if(rcvbytelen > 0) {
+				std::lock_guard<std::mutex> lock(listeners[channelid].rcv_buf_mutex);
+				rcv_task& task = listeners[channelid];
+				if(task.posted_buf != nullptr && task.posted_bytes == rcvbytelen && task.rcv_buf.empty()) {
+					posted_buf = task.posted_buf;
+					task.posted_buf = nullptr;
+				}
+			}
+
 			if(rcvbytelen == 0) {
+				if(!receive_payload(channelid, nullptr, 0)) {
+					fail();
+					return;
+				}
+				{
+					std::lock_guard<std::mutex> lock(listeners[channelid].rcv_buf_mutex);
+					listeners[channelid].num_queued_at_fin.push(listeners[channelid].num_queued);
+				}
 				remove_listener(channelid);
+			} else if(posted_buf != nullptr) {
+				if(!receive_payload(channelid, posted_buf, rcvbytelen)) {
+					fail();
+					return;
+				}
+				{
+					std::lock_guard<std::mutex> lock(listeners[channelid].rcv_buf_mutex);
+					listeners[channelid].posted_done = true;
+				}
+				rcvlock->Lock();
+				bool cond = listeners[channelid].inuse;
+				rcvlock->Unlock();
+
+				if(cond)
+					listeners[channelid].rcv_event->Set();
 			} else {
 				rcv_ctx* rcv_buf = (rcv_ctx*) malloc(sizeof(rcv_ctx));
 				rcv_buf->buf = (uint8_t*) malloc(rcvbytelen);
 				rcv_buf->rcvbytes = rcvbytelen;
 
-				mysock->Receive(rcv_buf->buf, rcvbytelen);
+				if(!receive_payload(channelid, rcv_buf->buf, rcvbytelen)) {
+					free(rcv_buf->buf);
+					free(rcv_buf);
+					fail();
+					return;
+				}
+				//the pages are placed when they are first written, which may be on another node than this CPU
+				rcv_buf->numa_node = NumaNodeOfAddress(rcv_buf->buf);
 				rcvlock->Lock();
 
 				{
 					std::lock_guard<std::mutex> lock(listeners[channelid].rcv_buf_mutex);
 					listeners[channelid].rcv_buf.push(rcv_buf);
+					listeners[channelid].num_queued++;
 				}
 
 				bool cond = listeners[channelid].inuse;
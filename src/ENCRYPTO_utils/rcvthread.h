@@ -22,22 +22,28 @@
 #include "constants.h"
 #include "thread.h"
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <mutex>
 #include <queue>
 
 class CSocket;
+class record_layer;
 
 struct rcv_ctx {
 	uint8_t *buf;
 	uint64_t rcvbytes;
+	//NUMA node of the first page of buf, -1 if unknown
+	int numa_node;
 };
 
 
 
 class RcvThread: public CThread {
 public:
+	enum class posted_state { pending, done, cancelled };
+
 	RcvThread(CSocket* sock, CLock* glock);
 	~RcvThread();
 
@@ -47,13 +53,38 @@ public:
 
 	void flush_queue(uint8_t channelid);
 
+	//Take the oldest end-of-channel message on channelid that was not consumed yet and return the number of
+	//blocks that had been queued on channelid until it arrived. Each fin has to be consumed exactly once.
+	uint64_t consume_fin(uint8_t channelid);
+
+	//Drop only the blocks that were queued before the fin, as returned by consume_fin, later blocks are kept
+	void flush_queue_before_fin(uint8_t channelid, uint64_t num_queued_at_fin);
+
 	void remove_listener(uint8_t channelid);
 
 	std::queue<rcv_ctx*>* add_listener(uint8_t channelid, CEvent* rcv_event, CEvent* fin_event);
 	std::mutex& get_listener_mutex(uint8_t channelid);
 
+	//Let the next message on channelid of exactly nbytes be written directly into buf. Fails if data is already queued.
+	bool post_receive(uint8_t channelid, uint8_t* buf, uint64_t nbytes);
+	//Check a posted receive. A pending post is cancelled if a message that did not fit it was queued instead.
+	posted_state check_posted_receive(uint8_t channelid);
+
+	//Open all messages with rl after its handshake(), has to be set before Start() and on both parties
+	void set_record_layer(record_layer* rl);
+
+	//True once a message could not be authenticated. The receiver thread has stopped then and the receive and fin
+	//events of all listeners are set, such that blocked receivers return.
+	bool has_failed() const;
+
 	void ThreadMain();
 
+	//Account for nbytes that the calling thread copies out of a received block written on NUMA node buf_node
+	void count_copy(int buf_node, uint64_t nbytes);
+	//Bytes copied out of received blocks on the NUMA node they were received on / on a different node
+	uint64_t get_local_copy_bytes() const;
+	uint64_t get_remote_copy_bytes() const;
+
 private:
 	//A receive task listens to a particular id and writes incoming data on that id into rcv_buf and triggers event
 	struct rcv_task {
@@ -64,10 +95,28 @@ private:
 		CEvent* fin_event;
 		bool inuse;
 		bool forward_notify_fin;
+		//buffer posted by the channel for receiving without an intermediate copy, protected by rcv_buf_mutex
+		uint8_t* posted_buf;
+		uint64_t posted_bytes;
+		bool posted_done;
+		//total number of blocks ever queued and that number for each end-of-channel message that was not
+		//consumed yet, protected by rcv_buf_mutex
+		uint64_t num_queued;
+		std::queue<uint64_t> num_queued_at_fin;
 	};
 
+	//Receive the payload of a message that was announced with nbytes bytes, false if it was not authentic
+	bool receive_payload(uint8_t channelid, uint8_t* buf, uint64_t nbytes);
+
+	//Mark the connection as failed and wake up all listeners
+	void fail();
+
 	CLock* rcvlock;
 	CSocket* mysock;
+	record_layer* m_cRecordLayer = nullptr;
+	std::atomic<bool> m_bFailed;
+	std::atomic<uint64_t> m_nLocalCopyBytes;
+	std::atomic<uint64_t> m_nRemoteCopyBytes;
 	std::array<rcv_task, MAX_NUM_COMM_CHANNELS> listeners;
 };
 
@@ -20,12 +20,17 @@
 #include "sndthread.h"
 #include "socket.h"
 #include "constants.h"
+#include "crypto/record_layer.h"
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <iostream>
 
+//sealed messages are encrypted piecewise through a staging buffer of this size
+#define SEAL_CHUNK_BYTES	(1<<20)
 
 SndThread::SndThread(CSocket* sock, CLock *glock)
-: mysock(sock), sndlock(glock), send(std::make_unique<CEvent>())
+: mysock(sock), sndlock(glock), send(std::make_unique<CEvent>()), m_bFailed(false)
 {
 }
 
@@ -49,6 +54,14 @@ void SndThread::setlock(CLock *glock) {
 void SndThread::push_task(std::unique_ptr<snd_task> task)
 {
 	sndlock->Lock();
+	if(m_bFailed) {
+		//the thread has stopped, release the caller right away
+		sndlock->Unlock();
+		if(task->eventcaller != nullptr) {
+			task->eventcaller->Set();
+		}
+		return;
+	}
 	send_tasks.push(std::move(task));
 	sndlock->Unlock();
 	send->Set();
@@ -88,11 +101,35 @@ void SndThread::add_event_snd_task(CEvent* eventcaller, uint8_t channelid, uint6
 
 }
 
+void SndThread::add_event_snd_task_nocopy(CEvent* eventcaller, uint8_t channelid, uint64_t sndbytes, const uint8_t* sndbuf, std::vector<uint8_t> tail) {
+	assert(channelid != ADMIN_CHANNEL);
+	//without an event the caller cannot know when sndbuf may be reused
+	assert(eventcaller != nullptr);
+	auto task = std::make_unique<snd_task>();
+	task->channelid = channelid;
+	task->eventcaller = eventcaller;
+	task->ext_buf = sndbuf;
+	task->ext_bytes = sndbytes;
+	task->snd_buf = std::move(tail);
+
+	push_task(std::move(task));
+}
+
 void SndThread::add_snd_task(uint8_t channelid, uint64_t sndbytes, uint8_t* sndbuf) {
 	//Call the method blocking but since callback is nullptr nobody gets notified, other functionallity is equal
 	add_event_snd_task(nullptr, channelid, sndbytes, sndbuf);
 }
 
+void SndThread::add_snd_task(uint8_t channelid, std::vector<uint8_t>&& sndbuf) {
+	assert(channelid != ADMIN_CHANNEL);
+	auto task = std::make_unique<snd_task>();
+	task->channelid = channelid;
+	task->eventcaller = nullptr;
+	task->snd_buf = std::move(sndbuf);
+
+	push_task(std::move(task));
+}
+
 void SndThread::signal_end(uint8_t channelid) {
 	add_snd_task(channelid, 0, nullptr);
 	//std::cout << "Signalling end on channel " << (uint32_t) channelid << std::endl;
@@ -109,6 +146,55 @@ void SndThread::kill_task() {
 #endif
 }
 
+void SndThread::set_record_layer(record_layer* rl) {
+	m_cRecordLayer = rl;
+}
+
+bool SndThread::has_failed() const {
+	return m_bFailed;
+}
+
+//Drop all queued tasks and release their callers, tasks that are added later are dropped by push_task
+void SndThread::fail() {
+	sndlock->Lock();
+	m_bFailed = true;
+	while(!send_tasks.empty()) {
+		if(send_tasks.front()->eventcaller != nullptr) {
+			send_tasks.front()->eventcaller->Set();
+		}
+		send_tasks.pop();
+	}
+	sndlock->Unlock();
+}
+
+bool SndThread::send_sealed(const snd_task& task) {
+	uint64_t bytelen = task.ext_bytes + task.snd_buf.size();
+	uint64_t wirelen = bytelen + RECORD_TAG_BYTES;
+	mysock->Send(&wirelen, sizeof(wirelen));
+
+	if(!m_cRecordLayer->seal_init(task.channelid, bytelen)) {
+		return false;
+	}
+	m_vSealBuf.resize(std::min<uint64_t>(bytelen, SEAL_CHUNK_BYTES));
+	const uint8_t* parts[2] = { task.ext_buf, task.snd_buf.data() };
+	uint64_t partlens[2] = { task.ext_bytes, task.snd_buf.size() };
+	for(size_t i = 0; i < 2; i++) {
+		for(uint64_t pos = 0; pos < partlens[i]; pos += SEAL_CHUNK_BYTES) {
+			uint64_t len = std::min<uint64_t>(partlens[i] - pos, SEAL_CHUNK_BYTES);
+			if(!m_cRecordLayer->seal_update(parts[i] + pos, m_vSealBuf.data(), len)) {
+				return false;
+			}
+			mysock->Send(m_vSealBuf.data(), len);
+		}
+	}
+	uint8_t tag[RECORD_TAG_BYTES];
+	if(!m_cRecordLayer->seal_final(tag)) {
+		return false;
+	}
+	mysock->Send(tag, RECORD_TAG_BYTES);
+	return true;
+}
+
 void SndThread::ThreadMain() {
 	uint8_t channelid;
 	uint32_t iters;
@@ -135,10 +221,26 @@ void SndThread::ThreadMain() {
 			sndlock->Unlock();
 			channelid = task->channelid;
 			mysock->Send(&channelid, sizeof(uint8_t));
-			uint64_t bytelen = task->snd_buf.size();
-			mysock->Send(&bytelen, sizeof(bytelen));
-			if(bytelen > 0) {
-				mysock->Send(task->snd_buf.data(), task->snd_buf.size());
+			if(m_cRecordLayer != nullptr) {
+				if(!send_sealed(*task)) {
+					//the other party cannot authenticate anything after the partial message
+					std::cerr << "Sealing a message on channel " << (uint32_t) channelid << " failed, "
+							"stopping the sender thread" << std::endl;
+					if(task->eventcaller != nullptr) {
+						task->eventcaller->Set();
+					}
+					fail();
+					return;
+				}
+			} else {
+				uint64_t bytelen = task->ext_bytes + task->snd_buf.size();
+				mysock->Send(&bytelen, sizeof(bytelen));
+				if(task->ext_bytes > 0) {
+					mysock->Send(task->ext_buf, task->ext_bytes);
+				}
+				if(task->snd_buf.size() > 0) {
+					mysock->Send(task->snd_buf.data(), task->snd_buf.size());
+				}
 			}
 
 #ifdef DEBUG_SEND_THREAD
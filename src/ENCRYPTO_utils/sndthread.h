@@ -21,10 +21,13 @@
 #define SND_THREAD_H_
 
 #include "thread.h"
+#include <atomic>
 #include <memory>
 #include <queue>
+#include <vector>
 
 class CSocket;
+class record_layer;
 
 
 class SndThread: public CThread {
@@ -45,27 +48,48 @@ public:
 
 	void add_snd_task(uint8_t channelid, uint64_t sndbytes, uint8_t* sndbuf);
 
+	//Send sndbuf without copying it, an empty sndbuf signals the end of the channel like signal_end
+	void add_snd_task(uint8_t channelid, std::vector<uint8_t>&& sndbuf);
+
 	void add_event_snd_task(CEvent* eventcaller, uint8_t channelid, uint64_t sndbytes, uint8_t* sndbuf);
 
+	//sndbuf is not copied and has to stay valid until eventcaller is set, tail is appended to the same message
+	void add_event_snd_task_nocopy(CEvent* eventcaller, uint8_t channelid, uint64_t sndbytes, const uint8_t* sndbuf, std::vector<uint8_t> tail);
+
 	void signal_end(uint8_t channelid);
 
 	void kill_task();
 
+	//Seal all messages with rl after its handshake(), has to be set before Start() and on both parties
+	void set_record_layer(record_layer* rl);
+
+	//True once a message could not be sealed. The sender thread has stopped then, the callers of all queued and
+	//later tasks are released without sending them.
+	bool has_failed() const;
+
 	void ThreadMain();
 
 private:
 	struct snd_task {
 		uint8_t channelid;
 		std::vector<uint8_t> snd_buf;
+		//optional non-owning payload that is sent in front of snd_buf
+		const uint8_t* ext_buf = nullptr;
+		uint64_t ext_bytes = 0;
 		CEvent* eventcaller;
 	};
 
 	void push_task(std::unique_ptr<snd_task> task);
+	bool send_sealed(const snd_task& task);
+	void fail();
 
 	CSocket* mysock;
 	CLock* sndlock;
 	std::unique_ptr<CEvent> send;
 	std::queue<std::unique_ptr<snd_task>> send_tasks;
+	record_layer* m_cRecordLayer = nullptr;
+	std::vector<uint8_t> m_vSealBuf;
+	std::atomic<bool> m_bFailed;
 };
 
 
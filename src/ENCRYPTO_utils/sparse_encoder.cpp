@@ -0,0 +1,157 @@
+/**
+ \file 		sparse_encoder.cpp
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Sparse GF(2) linear maps for LPN-style expansion
+ */
+
+#include "sparse_encoder.h"
+#include "cbitvector.h"
+#include "crypto/crypto.h"
+#include "thread.h"
+#include "utils.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+//Columns whose positions are generated at once, their positions and outputs stay in the L1 cache. A multiple of 8, such
+//that threads write disjoint bytes of bit outputs.
+constexpr std::size_t BLOCK_COLUMNS = 256;
+
+//Positions of the columns [first, first + ncolumns), blockspercol AES blocks of four positions each per column
+void generate_positions(crypto* crypt, AES_KEY_CTX* key, std::size_t first, std::size_t ncolumns,
+		std::size_t blockspercol, std::size_t inlen, uint32_t* pos) {
+	std::size_t nblocks = ncolumns * blockspercol;
+	uint8_t* buf = (uint8_t*) pos;
+	memset(buf, 0, nblocks * AES_BYTES);
+	for (std::size_t i = 0; i < nblocks; i++) {
+		uint64_t ctr = first * blockspercol + i;
+		memcpy(buf + i * AES_BYTES, &ctr, sizeof(ctr));
+	}
+	crypt->encrypt(key, buf, buf, nblocks * AES_BYTES);
+	for (std::size_t i = 0; i < nblocks * AES_BYTES / sizeof(uint32_t); i++) {
+		pos[i] = ((uint64_t) pos[i] * inlen) >> 32;
+	}
+}
+
+inline void xor_row(BYTE* dst, const BYTE* src, std::size_t n) {
+	std::size_t i = 0;
+	for (; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+		uint64_t a, b;
+		memcpy(&a, dst + i, sizeof(a));
+		memcpy(&b, src + i, sizeof(b));
+		a ^= b;
+		memcpy(dst + i, &a, sizeof(a));
+	}
+	for (; i < n; i++) {
+		dst[i] ^= src[i];
+	}
+}
+
+} // namespace
+
+
+SparseGF2Encoder::SparseGF2Encoder(std::size_t inlen, std::size_t outlen, std::size_t weight, crypto* crypt,
+		const uint8_t* seed)
+	: m_nInLen(inlen), m_nOutLen(outlen), m_nWeight(weight), m_nBlocksPerColumn(ceil_divide(weight, 4)), m_cCrypto(crypt) {
+	assert(inlen > 0 && inlen <= ((uint64_t) 1 << 32) && weight > 0);
+	memcpy(m_vSeed, seed, AES_BYTES);
+}
+
+std::size_t SparseGF2Encoder::GetInputLength() const {
+	return m_nInLen;
+}
+
+std::size_t SparseGF2Encoder::GetOutputLength() const {
+	return m_nOutLen;
+}
+
+std::size_t SparseGF2Encoder::GetWeight() const {
+	return m_nWeight;
+}
+
+void SparseGF2Encoder::GetColumn(std::size_t j, uint32_t* pos) const {
+	assert(j < m_nOutLen);
+	AES_KEY_CTX key;
+	uint8_t seed[AES_BYTES];
+	memcpy(seed, m_vSeed, AES_BYTES);
+	m_cCrypto->init_aes_key(&key, 128, seed);
+	std::vector<uint32_t> buf(m_nBlocksPerColumn * AES_BYTES / sizeof(uint32_t));
+	generate_positions(m_cCrypto, &key, j, 1, m_nBlocksPerColumn, m_nInLen, buf.data());
+	memcpy(pos, buf.data(), m_nWeight * sizeof(uint32_t));
+	m_cCrypto->clean_aes_key(&key);
+}
+
+//Every thread uses its own AES key, gather(c0, c1, pos) computes the outputs [c0, c1) from the positions of the columns
+template<class GATHER> void SparseGF2Encoder::EncodeBlocks(std::size_t grain, uint32_t nthreads, const GATHER& gather) const {
+	ParallelFor(m_nOutLen, grain, nthreads, [&] (std::size_t begin, std::size_t end) {
+		AES_KEY_CTX key;
+		uint8_t seed[AES_BYTES];
+		memcpy(seed, m_vSeed, AES_BYTES);
+		m_cCrypto->init_aes_key(&key, 128, seed);
+		std::vector<uint32_t> pos(BLOCK_COLUMNS * m_nBlocksPerColumn * AES_BYTES / sizeof(uint32_t));
+		for (std::size_t c0 = begin; c0 < end; c0 += BLOCK_COLUMNS) {
+			std::size_t c1 = std::min(c0 + BLOCK_COLUMNS, end);
+			generate_positions(m_cCrypto, &key, c0, c1 - c0, m_nBlocksPerColumn, m_nInLen, pos.data());
+			gather(c0, c1, pos.data());
+		}
+		m_cCrypto->clean_aes_key(&key);
+	});
+}
+
+void SparseGF2Encoder::Encode(CBitVector& y, const CBitVector& x, uint32_t nthreads) const {
+	assert(x.GetSize() * 8 >= m_nInLen);
+	y.Create(m_nOutLen);
+	const BYTE* xp = x.GetArr();
+	BYTE* yp = y.GetArr();
+	std::size_t stride = m_nBlocksPerColumn * 4;
+	EncodeBlocks(BLOCK_COLUMNS, nthreads, [&] (std::size_t c0, std::size_t c1, const uint32_t* pos) {
+		for (std::size_t i = 0; i < (c1 - c0) * stride; i++) {
+			__builtin_prefetch(xp + (pos[i] >> 3));
+		}
+		for (std::size_t j = c0; j < c1; j++) {
+			const uint32_t* p = pos + (j - c0) * stride;
+			BYTE bit = 0;
+			for (std::size_t t = 0; t < m_nWeight; t++) {
+				bit ^= xp[p[t] >> 3] >> (p[t] & 0x07);
+			}
+			yp[j >> 3] |= (bit & 0x01) << (j & 0x07);
+		}
+	});
+}
+
+void SparseGF2Encoder::EncodeRows(CBitVector& y, const CBitVector& x, std::size_t rowbytes, uint32_t nthreads) const {
+	assert(x.GetSize() >= m_nInLen * rowbytes);
+	//all rows of y are written
+	y.CreateUninitialized(m_nOutLen * rowbytes * 8);
+	const BYTE* xp = x.GetArr();
+	BYTE* yp = y.GetArr();
+	std::size_t stride = m_nBlocksPerColumn * 4;
+	EncodeBlocks(1, nthreads, [&] (std::size_t c0, std::size_t c1, const uint32_t* pos) {
+		for (std::size_t i = 0; i < (c1 - c0) * stride; i++) {
+			__builtin_prefetch(xp + pos[i] * rowbytes);
+		}
+		for (std::size_t j = c0; j < c1; j++) {
+			const uint32_t* p = pos + (j - c0) * stride;
+			BYTE* out = yp + j * rowbytes;
+			memcpy(out, xp + p[0] * rowbytes, rowbytes);
+			for (std::size_t t = 1; t < m_nWeight; t++) {
+				xor_row(out, xp + p[t] * rowbytes, rowbytes);
+			}
+		}
+	});
+}
@@ -0,0 +1,83 @@
+/**
+ \file 		sparse_encoder.h
+ \author 	ENCRYPTO Group, TU Darmstadt
+ \copyright	ABY - A Framework for Efficient Mixed-protocol Secure Two-party Computation
+			Copyright (C) 2019 ENCRYPTO Group, TU Darmstadt
+			This program is free software: you can redistribute it and/or modify
+            it under the terms of the GNU Lesser General Public License as published
+            by the Free Software Foundation, either version 3 of the License, or
+            (at your option) any later version.
+            ABY is distributed in the hope that it will be useful,
+            but WITHOUT ANY WARRANTY; without even the implied warranty of
+            MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+            GNU Lesser General Public License for more details.
+            You should have received a copy of the GNU Lesser General Public License
+            along with this program. If not, see <http://www.gnu.org/licenses/>.
+ \brief		Sparse GF(2) linear maps for LPN-style expansion
+ */
+
+#ifndef SPARSE_ENCODER_H_
+#define SPARSE_ENCODER_H_
+
+#include "constants.h"
+#include "typedefs.h"
+#include <cstddef>
+#include <cstdint>
+
+class CBitVector;
+class crypto;
+
+/**
+	Multiplication with a sparse random inlen x outlen matrix over GF(2) with weight ones per column, i.e., output j is
+	the XOR of weight inputs, as used to expand short seeds into long pseudorandom correlations. The matrix is never
+	stored: the positions of the ones of column j are the 32-bit words of the AES encryptions of the counters
+	j * ceil(weight / 4), j * ceil(weight / 4) + 1, ..., under a key that is derived from the seed, each mapped to
+	[0, inlen) by a multiply-shift. Parties that use the same seed and parameters therefore use the same matrix.
+	Positions are not distinct, a position that occurs twice cancels out.
+
+	Columns are processed in blocks whose positions are generated with a single AES call and prefetched before the
+	inputs are gathered. Blocks are split among threads that write disjoint parts of the output.
+*/
+class SparseGF2Encoder {
+public:
+	/**
+		\param	inlen	-	Number of inputs, at most 2^32.
+		\param	outlen	-	Number of outputs.
+		\param	weight	-	Number of ones per column.
+		\param	crypt	-	Crypto object whose AES implementation is used, it has to outlive the encoder.
+		\param	seed	-	AES_BYTES bytes that define the matrix.
+	*/
+	SparseGF2Encoder(std::size_t inlen, std::size_t outlen, std::size_t weight, crypto* crypt, const uint8_t* seed);
+
+	std::size_t GetInputLength() const;
+	std::size_t GetOutputLength() const;
+	std::size_t GetWeight() const;
+
+	/** Write the weight positions of the ones of column j to pos */
+	void GetColumn(std::size_t j, uint32_t* pos) const;
+
+	/**
+		y = x * A for bits numbered as in CBitVector::GetBitNoMask(), i.e., bit j of y is the XOR of the bits of x at the
+		positions of column j. y gets outlen bits.
+		\param	nthreads	-	Number of threads, 0 uses all hardware threads.
+	*/
+	void Encode(CBitVector& y, const CBitVector& x, uint32_t nthreads = 1) const;
+
+	/**
+		Same as Encode() for inputs and outputs that are rows of rowbytes bytes, e.g., 16 byte blocks of an OT
+		correlation. y gets outlen rows.
+	*/
+	void EncodeRows(CBitVector& y, const CBitVector& x, std::size_t rowbytes, uint32_t nthreads = 1) const;
+
+private:
+	template<class GATHER> void EncodeBlocks(std::size_t grain, uint32_t nthreads, const GATHER& gather) const;
+
+	std::size_t m_nInLen;
+	std::size_t m_nOutLen;
+	std::size_t m_nWeight;
+	std::size_t m_nBlocksPerColumn; //AES blocks per column
+	crypto* m_cCrypto;
+	uint8_t m_vSeed[AES_BYTES];
+};
+
+#endif /* SPARSE_ENCODER_H_ */
@@ -17,19 +17,64 @@
  */
 
 #include "thread.h"
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <condition_variable>
+#include <fstream>
+#include <iostream>
 #include <mutex>
+#include <sstream>
+#include <string>
 #include <thread>
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
-CThread::CThread() : m_bRunning(false) {
+namespace {
+// Spinning about as long as a handoff with parking costs keeps every handoff within twice its optimal latency.
+// A round trip with parking took 3us in bench/bench_event.cpp. The budgets are converted to iterations at startup,
+// as the latency of the pause instruction differs by more than 10x between CPUs.
+constexpr double SPIN_BUDGET_NS = 3000;
+// lower bound of the adaptive spin count, an event that had to park still catches immediate handoffs
+constexpr double MIN_SPIN_NS = 250;
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+	_mm_pause();
+#endif
+}
+
+double ns_per_relax() {
+	const int nrelax = 1024;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < nrelax; i++)
+		cpu_relax();
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	return std::max(elapsed.count() / nrelax, 1.0);
+}
+
+const bool SPIN_ENABLED = std::thread::hardware_concurrency() > 1;
+const double NS_PER_RELAX = SPIN_ENABLED ? ns_per_relax() : 1.0;
+const uint32_t MIN_SPIN = std::max<uint32_t>(MIN_SPIN_NS / NS_PER_RELAX, 1);
+}
+
+CThread::CThread() : m_bRunning(false), m_nNumaNode(-1) {
 }
 CThread::~CThread() {
 	assert(!m_bRunning);
 }
 
 bool CThread::Start() {
-	thread_ = std::thread([this] { ThreadMain(); });
+	//placement is applied by the new thread itself, such that everything it allocates is already placed
+	thread_ = std::thread([this] { ApplyPlacement(); ThreadMain(); });
 	m_bRunning = true;
 	return true;
 }
@@ -46,6 +91,89 @@ bool CThread::IsRunning() const {
 	return m_bRunning;
 }
 
+void CThread::SetAffinity(const std::vector<int>& cpus) {
+	assert(!m_bRunning);
+	m_vAffinity = cpus;
+}
+
+bool CThread::SetNumaNode(int node) {
+	assert(!m_bRunning);
+	//the cpulist has the form "0-3,8-11"
+	std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+	std::string range;
+	std::vector<int> cpus;
+	while(cpulist.good() && std::getline(cpulist, range, ',')) {
+		int first, last;
+		char dash;
+		std::istringstream rangestream(range);
+		if(!(rangestream >> first)) {
+			continue;
+		}
+		last = (rangestream >> dash >> last) ? last : first;
+		for(int cpu = first; cpu <= last; cpu++) {
+			cpus.push_back(cpu);
+		}
+	}
+	if(cpus.empty()) {
+		std::cerr << "NUMA node " << node << " does not exist or has no CPUs" << std::endl;
+		return false;
+	}
+	m_vAffinity = cpus;
+	m_nNumaNode = node;
+	return true;
+}
+
+int CThread::GetNumaNode() const {
+	return m_nNumaNode;
+}
+
+int CThread::CurrentNumaNode() {
+#ifdef __linux__
+	unsigned int cpu, node;
+	if(getcpu(&cpu, &node) == 0) {
+		return node;
+	}
+#endif
+	return -1;
+}
+
+int CThread::NumaNodeOfAddress(const void* addr) {
+#ifdef __linux__
+	int node;
+	if(syscall(SYS_get_mempolicy, &node, nullptr, 0, addr, MPOL_F_NODE | MPOL_F_ADDR) == 0) {
+		return node;
+	}
+#endif
+	return -1;
+}
+
+void CThread::ApplyPlacement() {
+#ifdef __linux__
+	if(!m_vAffinity.empty()) {
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		for(int cpu : m_vAffinity) {
+			CPU_SET(cpu, &cpuset);
+		}
+		if(pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+			std::cerr << "Could not set the CPU affinity of a thread" << std::endl;
+		}
+	}
+	unsigned long nodemask[16] = { 0 };
+	if(m_nNumaNode >= 0 && m_nNumaNode < (int) (8 * sizeof(nodemask))) {
+		//prefer the node for new pages but fall back to other nodes if it is full, like numactl --preferred
+		nodemask[m_nNumaNode / (8 * sizeof(unsigned long))] |= 1UL << (m_nNumaNode % (8 * sizeof(unsigned long)));
+		if(syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodemask, 8 * sizeof(nodemask)) != 0) {
+			std::cerr << "Could not set the memory policy of a thread to NUMA node " << m_nNumaNode << std::endl;
+		}
+	}
+#else
+	if(!m_vAffinity.empty() || m_nNumaNode >= 0) {
+		std::cerr << "Thread placement is only supported on Linux" << std::endl;
+	}
+#endif
+}
+
 void CLock::Lock() {
 	mutex_.lock();
 }
@@ -61,38 +189,204 @@ void CLock::unlock() {
 }
 
 
+std::atomic<uint32_t> CEvent::s_nMaxSpin(SPIN_ENABLED ? std::max<uint32_t>(SPIN_BUDGET_NS / NS_PER_RELAX, MIN_SPIN) : 0);
+
 CEvent::CEvent(bool bManualReset, bool bInitialSet)
-: m_bManual(bManualReset), m_bSet(bInitialSet)
+: m_bManual(bManualReset), m_bSet(bInitialSet), m_nWaiters(0), m_nSpin(s_nMaxSpin.load() / 4)
 {
 }
 
+void CEvent::SetSpinCount(uint32_t spincount) {
+	s_nMaxSpin = spincount;
+}
+
+uint32_t CEvent::GetSpinCount() {
+	return s_nMaxSpin;
+}
+
+bool CEvent::TryConsume() {
+	if (m_bManual)
+		return m_bSet.load();
+	bool expected = true;
+	return m_bSet.compare_exchange_strong(expected, false);
+}
+
 bool CEvent::Set() {
-	std::unique_lock<std::mutex> lock(mutex_);
-	if (m_bSet)
+	if (m_bSet.exchange(true))
 		return true;
 
-	m_bSet = true;
-	lock.unlock();
-	cv_.notify_one();
+	// a waiter increments m_nWaiters before it checks m_bSet under the mutex, hence it either sees m_bSet or is
+	// already blocked in cv_.wait() once we got the mutex
+	if (m_nWaiters.load() > 0) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+		}
+		if (m_bManual)
+			cv_.notify_all();
+		else
+			cv_.notify_one();
+	}
 	return true;
 }
 
 bool CEvent::Wait() {
-	std::unique_lock<std::mutex> lock(mutex_);
-	cv_.wait(lock, [this]{ return m_bSet; });
+	uint32_t maxspin = s_nMaxSpin.load(std::memory_order_relaxed);
+	uint32_t spin = std::min(m_nSpin.load(std::memory_order_relaxed), maxspin);
+	for (uint32_t i = 0; i < spin; i++) {
+		if (m_bSet.load(std::memory_order_relaxed) && TryConsume()) {
+			m_nSpin.store(std::min(std::max(2 * spin, MIN_SPIN), maxspin), std::memory_order_relaxed);
+			return true;
+		}
+		cpu_relax();
+	}
 
-	if (!m_bManual)
-		m_bSet = false;
+	std::unique_lock<std::mutex> lock(mutex_);
+	m_nWaiters++;
+	bool parked = false;
+	cv_.wait(lock, [this, &parked]{
+		if (TryConsume())
+			return true;
+		parked = true;
+		return false;
+	});
+	m_nWaiters--;
+	if (parked)
+		m_nSpin.store(std::max(spin / 2, MIN_SPIN), std::memory_order_relaxed);
 	return true;
 }
 
 bool CEvent::IsSet() const {
-	std::lock_guard<std::mutex> lock(mutex_);
-	return m_bSet;
+	return m_bSet.load();
 }
 
 bool CEvent::Reset() {
-	std::lock_guard<std::mutex> lock(mutex_);
 	m_bSet = false;
 	return true;
 }
+
+namespace {
+// Workers of ParallelFor, which are started on first use and kept until the program exits, since the kernels that
+// call ParallelFor often run for only tens of microseconds. One call runs on the pool at a time.
+class parallel_pool {
+public:
+	~parallel_pool() {
+		{
+			std::lock_guard<std::mutex> lock(m_mState);
+			m_bStop = true;
+		}
+		m_cvWork.notify_all();
+		for (auto& t : m_vWorkers)
+			t.join();
+	}
+
+	// Returns false if another call currently uses the pool
+	bool TryRun(std::size_t nchunks, std::size_t chunk, std::size_t n,
+			const std::function<void(std::size_t, std::size_t)>& func) {
+		std::unique_lock<std::mutex> job(m_mJob, std::try_to_lock);
+		if (!job.owns_lock())
+			return false;
+		{
+			std::unique_lock<std::mutex> lock(m_mState);
+			while (m_vWorkers.size() + 1 < nchunks)
+				m_vWorkers.emplace_back([this] { WorkerMain(); });
+			m_pFunc = &func;
+			m_nChunks = nchunks;
+			m_nChunk = chunk;
+			m_nN = n;
+			m_nNext = 0;
+			m_nGeneration++;
+		}
+		m_cvWork.notify_all();
+
+		s_bInParallelFor = true;
+		RunChunks(func, nchunks, chunk, n);
+		s_bInParallelFor = false;
+
+		//all chunks are claimed, wait for the workers that still process theirs
+		std::unique_lock<std::mutex> lock(m_mState);
+		m_cvDone.wait(lock, [this] { return m_nBusy == 0; });
+		m_pFunc = nullptr;
+		return true;
+	}
+
+	// Set on the threads that process chunks, a nested ParallelFor runs sequentially on them
+	static thread_local bool s_bInParallelFor;
+
+private:
+	void RunChunks(const std::function<void(std::size_t, std::size_t)>& func, std::size_t nchunks, std::size_t chunk,
+			std::size_t n) {
+		for (std::size_t i = m_nNext++; i < nchunks; i = m_nNext++)
+			func(i * chunk, std::min((i + 1) * chunk, n));
+	}
+
+	void WorkerMain() {
+		s_bInParallelFor = true;
+		uint64_t seen = 0;
+		std::unique_lock<std::mutex> lock(m_mState);
+		while (true) {
+			m_cvWork.wait(lock, [this, seen] { return m_bStop || (m_nGeneration != seen && m_pFunc != nullptr); });
+			if (m_bStop)
+				return;
+			seen = m_nGeneration;
+			const std::function<void(std::size_t, std::size_t)>& func = *m_pFunc;
+			std::size_t nchunks = m_nChunks, chunk = m_nChunk, n = m_nN;
+			m_nBusy++;
+			lock.unlock();
+			RunChunks(func, nchunks, chunk, n);
+			lock.lock();
+			if (--m_nBusy == 0)
+				m_cvDone.notify_one();
+		}
+	}
+
+	std::mutex m_mJob;
+	std::mutex m_mState;
+	std::condition_variable m_cvWork;
+	std::condition_variable m_cvDone;
+	std::vector<std::thread> m_vWorkers;
+	const std::function<void(std::size_t, std::size_t)>* m_pFunc = nullptr;
+	std::size_t m_nChunks = 0;
+	std::size_t m_nChunk = 0;
+	std::size_t m_nN = 0;
+	std::atomic<std::size_t> m_nNext{0};
+	uint64_t m_nGeneration = 0;
+	uint32_t m_nBusy = 0;
+	bool m_bStop = false;
+};
+
+thread_local bool parallel_pool::s_bInParallelFor = false;
+
+parallel_pool& GetParallelPool() {
+	static parallel_pool pool;
+	return pool;
+}
+}
+
+void ParallelFor(std::size_t n, std::size_t grain, uint32_t nthreads,
+		const std::function<void(std::size_t, std::size_t)>& func) {
+	if (n == 0)
+		return;
+	grain = std::max<std::size_t>(grain, 1);
+	if (nthreads == 0)
+		nthreads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::size_t ngrains = (n + grain - 1) / grain;
+	std::size_t nchunks = std::min<std::size_t>(nthreads, ngrains);
+	std::size_t chunk = ((ngrains + nchunks - 1) / nchunks) * grain;
+	nchunks = (n + chunk - 1) / chunk;
+
+	if (nchunks == 1 || parallel_pool::s_bInParallelFor) {
+		func(0, n);
+		return;
+	}
+	if (GetParallelPool().TryRun(nchunks, chunk, n, func))
+		return;
+
+	//the pool is busy with a call of another thread, use threads of our own
+	std::vector<std::thread> threads;
+	for (std::size_t begin = chunk; begin < n; begin += chunk) {
+		threads.emplace_back(func, begin, std::min(begin + chunk, n));
+	}
+	func(0, std::min(chunk, n));
+	for (auto& t : threads)
+		t.join();
+}
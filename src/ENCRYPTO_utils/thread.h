@@ -19,9 +19,14 @@
 #ifndef __THREAD_H__BY_SGCHOI
 #define __THREAD_H__BY_SGCHOI
 
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 class CThread {
 public:
@@ -32,11 +37,30 @@ public:
 	bool Wait();
 	bool IsRunning() const;
 
+	// Pin the thread to the given CPUs, has to be called before Start()
+	void SetAffinity(const std::vector<int>& cpus);
+	// Pin the thread to the CPUs of a NUMA node and let it prefer memory of that node, has to be called before Start().
+	// Returns false if the node does not exist.
+	bool SetNumaNode(int node);
+	int GetNumaNode() const;
+
+	// NUMA node of the CPU the calling thread runs on, -1 if unknown
+	static int CurrentNumaNode();
+	// NUMA node of the page that holds addr, -1 if unknown. The page has to be touched already, otherwise it is
+	// allocated by the query.
+	static int NumaNodeOfAddress(const void* addr);
+
 protected:
 	virtual void ThreadMain() = 0;
 
 	bool m_bRunning;
 	std::thread thread_;
+
+private:
+	void ApplyPlacement();
+
+	std::vector<int> m_vAffinity;
+	int m_nNumaNode;
 };
 
 class CLock {
@@ -55,6 +79,9 @@ private:
 	std::mutex mutex_;
 };
 
+// Wait() first spins for a bounded number of iterations before it parks on the condition variable, so a Set() shortly
+// after the Wait() costs neither a futex wake-up nor a context switch. The number of spin iterations adapts per event:
+// it grows when spinning was successful and shrinks when the waiter had to park anyway.
 class CEvent {
 public:
 	CEvent(bool bManualReset=false, bool bInitialSet=false);
@@ -65,11 +92,28 @@ public:
 	bool IsSet() const;
 	bool Reset();
 
+	// Upper bound on the spin iterations of all events, 0 disables spinning. Defaults to the iterations that take
+	// about 3us on this CPU, 0 on single core machines.
+	static void SetSpinCount(uint32_t spincount);
+	static uint32_t GetSpinCount();
+
 private:
+	bool TryConsume();
+
 	std::condition_variable cv_;
 	mutable std::mutex mutex_;
 	bool m_bManual;
-	bool m_bSet;
+	std::atomic<bool> m_bSet;
+	std::atomic<uint32_t> m_nWaiters;
+	std::atomic<uint32_t> m_nSpin;
+
+	static std::atomic<uint32_t> s_nMaxSpin;
 };
 
+// Split [0, n) into at most nthreads chunks whose borders are multiples of grain and call func(begin, end) for every
+// chunk. The chunks are processed by the calling thread and the threads of a pool that is kept across calls.
+// nthreads 0 uses all hardware threads, grain 0 is treated as 1. Calls from within func run sequentially.
+void ParallelFor(std::size_t n, std::size_t grain, uint32_t nthreads,
+		const std::function<void(std::size_t, std::size_t)>& func);
+
 #endif //__THREAD_H__BY_SGCHOI
@@ -1,5 +1,47 @@
 #include <gtest/gtest.h>
+#include "ENCRYPTO_utils/bitkernels.h"
 #include "ENCRYPTO_utils/cbitvector.h"
+#include "ENCRYPTO_utils/cbitvector_allocator.h"
+#include "ENCRYPTO_utils/cbitvector_expr.h"
+#include "ENCRYPTO_utils/cbitvector_view.h"
+#include "ENCRYPTO_utils/crypto/crypto.h"
+#include "ENCRYPTO_utils/fixed_bitvector.h"
+#include "ENCRYPTO_utils/gf2_matrix.h"
+#include "ENCRYPTO_utils/rank_select.h"
+#include "ENCRYPTO_utils/sparse_encoder.h"
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <unistd.h>
+#include <vector>
+
+
+namespace {
+
+// Restores the SIMD level of the kernels when a test ends, also if an assertion returned early
+class simd_level_guard {
+public:
+	simd_level_guard() : m_eLevel(get_simd_level()) {}
+	~simd_level_guard() {
+		set_simd_level(m_eLevel);
+	}
+
+private:
+	simd_level m_eLevel;
+};
+
+// All levels that the CPU supports, from scalar on
+std::vector<simd_level> supported_simd_levels() {
+	std::vector<simd_level> levels;
+	for (simd_level level : {simd_level::scalar, simd_level::avx2, simd_level::avx512}) {
+		if (level <= get_max_simd_level()) {
+			levels.push_back(level);
+		}
+	}
+	return levels;
+}
+
+}
 
 
 TEST(TestCBitVector, Create){
@@ -43,3 +85,896 @@ TEST(TestCBitVector, SetBitsPosOffset) {
 	ASSERT_EQ(read_bits(v), 0b0000001111010101);
 }
 
+
+TEST(TestCBitVector, BulkKernelsAllSIMDLevels) {
+	const std::size_t sizes[] = {0, 1, 7, 8, 31, 32, 63, 64, 65, 127, 128, 200, 1000};
+	simd_level_guard guard;
+
+	for (simd_level level : supported_simd_levels()) {
+		ASSERT_EQ(set_simd_level(level), level);
+		for (std::size_t size : sizes) {
+			// use an odd offset such that the kernels see unaligned buffers
+			std::vector<uint8_t> a(size + 3), b(size + 3);
+			for (std::size_t i = 0; i < a.size(); i++) {
+				a[i] = i * 37 + 11;
+				b[i] = i * 101 + size;
+			}
+			CBitVector v;
+			v.CreateBytes(size + 3);
+			v.Copy(a.data(), 0, a.size());
+
+			v.XORBytes(b.data() + 1, 1, size);
+			for (std::size_t i = 0; i < a.size(); i++) {
+				ASSERT_EQ(v.GetByte(i), (i >= 1 && i <= size) ? (a[i] ^ b[i]) : a[i]);
+			}
+			v.ANDBytes(b.data() + 1, 1, size);
+			for (std::size_t i = 1; i <= size; i++) {
+				ASSERT_EQ(v.GetByte(i), (a[i] ^ b[i]) & b[i]);
+			}
+			v.SetXOR(a.data() + 1, b.data() + 1, 1, size);
+			for (std::size_t i = 1; i <= size; i++) {
+				ASSERT_EQ(v.GetByte(i), a[i] ^ b[i]);
+			}
+			v.SetAND(a.data() + 1, b.data() + 1, 1, size);
+			for (std::size_t i = 1; i <= size; i++) {
+				ASSERT_EQ(v.GetByte(i), a[i] & b[i]);
+			}
+
+			CBitVector w;
+			w.CreateBytes(size + 3);
+			w.Copy(a.data(), 0, a.size());
+			CBitVector u;
+			u.CreateBytes(size + 3);
+			u.Copy(a.data(), 0, a.size());
+			ASSERT_TRUE(w.IsEqual(u));
+			w.Invert();
+			for (std::size_t i = 0; i < a.size(); i++) {
+				ASSERT_EQ(w.GetByte(i), (uint8_t) ~a[i]);
+			}
+			w.Invert();
+			w.XORByte(size + 2, 0x10);
+			ASSERT_FALSE(w.IsEqual(u));
+			ASSERT_TRUE(w.IsEqual(u, 3, (size + 2) * 8 + 3));
+			ASSERT_FALSE(w.IsEqual(u, 3, (size + 2) * 8 + 4));
+		}
+	}
+}
+
+TEST(TestCBitVector, BitRangesAtArbitraryOffsets) {
+	const std::size_t srcbits = 2000;
+	std::vector<uint8_t> src(srcbits / 8);
+	for (std::size_t i = 0; i < src.size(); i++) {
+		src[i] = i * 73 + 5;
+	}
+	auto srcbit = [&] (std::size_t i) { return (src[i / 8] >> (i % 8)) & 1; };
+	const std::size_t offsets[] = {0, 1, 3, 7, 8, 13, 64, 67};
+	const std::size_t lens[] = {1, 2, 7, 8, 9, 63, 64, 65, 200, 511, 1000};
+	simd_level_guard guard;
+
+	for (simd_level level : supported_simd_levels()) {
+		ASSERT_EQ(set_simd_level(level), level);
+		for (std::size_t ppos : offsets) {
+			for (std::size_t pos : offsets) {
+				for (std::size_t len : lens) {
+					CBitVector v, x, g;
+					v.CreateZeros(1200);
+					v.SetToOne();
+					x.CreateZeros(1200);
+					g.CreateZeros(1200);
+					for (std::size_t i = 0; i < g.GetSize(); i++) {
+						x.SetByte(i, i * 29);
+						g.SetByte(i, i * 29);
+					}
+					v.SetBitsPosOffset(src.data(), ppos, pos, len);
+					x.XORBitsPosOffset(src.data(), ppos, pos, len);
+					for (std::size_t i = 0; i < v.GetSize() * 8; i++) {
+						bool inside = i >= pos && i < pos + len;
+						ASSERT_EQ(v.GetBitNoMask(i), inside ? srcbit(ppos + i - pos) : 1);
+						ASSERT_EQ(x.GetBitNoMask(i), g.GetBitNoMask(i) ^ (inside ? srcbit(ppos + i - pos) : 0));
+					}
+
+					// GetBits zeroes the unused bits of the last byte and does not write beyond it
+					std::vector<uint8_t> out(len / 8 + 2, 0xFF);
+					v.GetBits(out.data(), pos, len);
+					for (std::size_t i = 0; i < len; i++) {
+						ASSERT_EQ((out[i / 8] >> (i % 8)) & 1, srcbit(ppos + i));
+					}
+					for (std::size_t i = len; i < ((len + 7) / 8) * 8; i++) {
+						ASSERT_EQ((out[i / 8] >> (i % 8)) & 1, 0);
+					}
+					ASSERT_EQ(out[(len + 7) / 8], 0xFF);
+				}
+			}
+		}
+	}
+}
+
+TEST(TestCBitVector, TiledTransposeMatchesSimpleTranspose) {
+	const std::size_t shapes[][2] = {{8, 8}, {24, 40}, {64, 64}, {128, 256}, {256, 128}, {96, 200}, {136, 72},
+			{1, 1}, {3, 5}, {13, 7}, {77, 77}, {100, 37}, {65, 300}, {520, 520}, {600, 264}, {264, 513}};
+	simd_level_guard guard;
+
+	for (simd_level level : supported_simd_levels()) {
+		ASSERT_EQ(set_simd_level(level), level);
+		for (uint32_t nthreads : {1, 3}) {
+			for (auto& shape : shapes) {
+				std::size_t rows = shape[0], columns = shape[1];
+				CBitVector a, b;
+				a.Create(rows * columns);
+				b.Create(rows * columns);
+				for (std::size_t i = 0; i < a.GetSize(); i++) {
+					a.SetByte(i, i * 151 + (i >> 8) * 7 + 3);
+					b.SetByte(i, a.GetByte(i));
+				}
+				a.TiledTranspose(rows, columns, nthreads);
+				b.SimpleTranspose(rows, columns);
+				ASSERT_TRUE(a.IsEqual(b)) << rows << " x " << columns;
+			}
+		}
+	}
+}
+
+TEST(TestCBitVector, AllocatorsAndMoves) {
+	AlignedAllocator aligned(4096);
+	HugePageAllocator hugepages;
+	PoolAllocator pool;
+	ArenaAllocator arena(1 << 16);
+	std::vector<CBitVectorAllocator*> allocators = {MallocAllocator::Instance(), AlignedAllocator::Instance(),
+			&aligned, &hugepages, &pool, &arena};
+
+	for (CBitVectorAllocator* allocator : allocators) {
+		for (std::size_t bits : {1, 1000, 1 << 20}) {
+			CBitVector v;
+			v.SetAllocator(allocator);
+			v.CreateZeros(bits);
+			ASSERT_EQ(v.GetAllocator(), allocator);
+			for (std::size_t i = 0; i < v.GetSize(); i++) {
+				ASSERT_EQ(v.GetByte(i), 0);
+				v.SetByte(i, i * 13);
+			}
+			if (allocator == &aligned) {
+				ASSERT_EQ(reinterpret_cast<uintptr_t>(v.GetArr()) % 4096, 0);
+			}
+
+			// a moved buffer is transferred and released to the allocator it came from
+			CBitVector w(std::move(v));
+			ASSERT_EQ(v.GetArr(), nullptr);
+			ASSERT_EQ(v.GetSize(), 0);
+			CBitVector x(100);
+			x = std::move(w);
+			for (std::size_t i = 0; i < x.GetSize(); i++) {
+				ASSERT_EQ(x.GetByte(i), static_cast<uint8_t>(i * 13));
+			}
+			ASSERT_EQ(x.GetAllocator(), CBitVector::GetDefaultAllocator());
+
+			// recycled pool buffers are zeroed again
+			x.delCBitVector();
+			CBitVector y;
+			y.SetAllocator(allocator);
+			y.CreateZeros(bits);
+			for (std::size_t i = 0; i < y.GetSize(); i++) {
+				ASSERT_EQ(y.GetByte(i), 0);
+			}
+		}
+	}
+	ASSERT_EQ(reinterpret_cast<uintptr_t>(CBitVector(8).GetArr()) % CACHE_LINE_BYTES, 0);
+}
+
+TEST(TestCBitVector, AttachAndDetachHandOff) {
+	// buffers of the default allocator are handed over to other vectors and to code that releases them with free()
+	CBitVector a(1000), b;
+	a.SetByte(3, 0x5A);
+	b.AttachBuf(a.GetArr(), a.GetSize());
+	a.DetachBuf();
+	ASSERT_EQ(a.GetArr(), nullptr);
+	ASSERT_EQ(b.GetByte(3), 0x5A);
+
+	CBitVector c(1000);
+	BYTE* p = c.GetArr();
+	c.DetachBuf();
+	p[0] = 1;
+	free(p);
+
+	BYTE* q = static_cast<BYTE*>(malloc(16));
+	q[0] = 7;
+	CBitVector d;
+	d.AttachBuf(q, 16);
+	ASSERT_EQ(d.GetByte(0), 7);
+}
+
+TEST(TestCBitVector, CapacityReuseAndGrowth) {
+	CBitVector v;
+	v.CreateBytes(1000);
+	BYTE* buf = v.GetArr();
+	v.SetToOne();
+	v.CreateBytes(300);
+	ASSERT_EQ(v.GetArr(), buf);
+	ASSERT_EQ(v.GetSize(), 304);
+	for (std::size_t i = 0; i < v.GetSize(); i++) {
+		ASSERT_EQ(v.GetByte(i), 0);
+	}
+
+	// appends reallocate a logarithmic number of times and added bytes are zero
+	std::size_t reallocations = 0;
+	std::vector<uint8_t> chunk(100, 0xA5);
+	for (std::size_t i = 0; i < 1000; i++) {
+		std::size_t capacity = v.GetCapacity();
+		v.Copy(chunk.data(), v.GetSize(), chunk.size());
+		reallocations += v.GetCapacity() != capacity;
+	}
+	ASSERT_LE(reallocations, 10);
+	ASSERT_EQ(v.GetSize(), 304 + 100000);
+	ASSERT_EQ(v.GetByte(303), 0);
+	ASSERT_EQ(v.GetByte(304 + 99999), 0xA5);
+	v.ResizeinBytes(310);
+	v.ResizeinBytes(320);
+	ASSERT_EQ(v.GetByte(309), 0xA5);
+	ASSERT_EQ(v.GetByte(310), 0);
+
+	v.ShrinkToFit();
+	ASSERT_EQ(v.GetCapacity(), 320);
+	v.Reserve(4096);
+	ASSERT_EQ(v.GetCapacity(), 4096);
+	ASSERT_EQ(v.GetSize(), 320);
+	ASSERT_EQ(v.GetByte(309), 0xA5);
+}
+
+TEST(TestCBitVector, RandomAndUninitializedCreation) {
+	uint8_t seed[AES_BYTES] = {1, 2, 3};
+	for (std::size_t bits : {1, 100, 128, 1000, 4099}) {
+		crypto c1(128, seed), c2(128, seed);
+		CBitVector v;
+		// reuse a dirty buffer, the padding has to be zeroed nevertheless
+		v.CreateBytes(1024);
+		v.SetToOne();
+		v.Create(bits, &c1);
+
+		std::vector<uint8_t> expected((bits + 7) / 8);
+		c2.gen_rnd(expected.data(), expected.size());
+		ASSERT_EQ(v.GetSize(), (bits + 127) / 128 * 16);
+		for (std::size_t i = 0; i < v.GetSize(); i++) {
+			ASSERT_EQ(v.GetByte(i), i < expected.size() ? expected[i] : 0);
+		}
+
+		CBitVector u;
+		u.CreateUninitialized(bits);
+		ASSERT_EQ(u.GetSize(), v.GetSize());
+		u.CreateZeros(bits);
+		for (std::size_t i = 0; i < u.GetSize(); i++) {
+			ASSERT_EQ(u.GetByte(i), 0);
+		}
+	}
+}
+
+TEST(TestCBitVector, ParallelRandomFill) {
+	uint8_t seed[AES_BYTES] = {1, 2, 3};
+	crypto ref(128, seed);
+	AES_KEY_CTX key;
+	ref.init_aes_key(&key, seed);
+	for (std::size_t bits : {8, 100, 128, 1000, 8 * 100003}) {
+		for (uint32_t nthreads : {1, 3, 0}) {
+			crypto c1(128, seed), c2(128, seed);
+			std::size_t nbytes = (bits + 7) / 8;
+
+			// two fills continue the counter of crypt as two sequential calls of gen_rnd do
+			CBitVector v, w;
+			v.FillRand(bits, &c1, nthreads);
+			w.FillRand(bits, &c1, nthreads);
+			std::vector<uint8_t> expected(2 * nbytes);
+			c2.gen_rnd(expected.data(), nbytes);
+			c2.gen_rnd(expected.data() + nbytes, nbytes);
+			for (std::size_t i = 0; i < v.GetSize(); i++) {
+				ASSERT_EQ(v.GetByte(i), i < nbytes ? expected[i] : 0);
+				ASSERT_EQ(w.GetByte(i), i < nbytes ? expected[nbytes + i] : 0);
+			}
+
+			// the first block is the encryption of the zero counter
+			uint8_t ctr[AES_BYTES] = {0}, block[AES_BYTES];
+			ref.encrypt(&key, block, ctr, AES_BYTES);
+			ASSERT_EQ(v.GetByte(0), block[0]);
+			if (nbytes >= 2 * AES_BYTES) {
+				ctr[0] = 1;
+				ref.encrypt(&key, block, ctr, AES_BYTES);
+				ASSERT_EQ(memcmp(v.GetArr() + AES_BYTES, block, AES_BYTES), 0);
+			}
+		}
+	}
+	ref.clean_aes_key(&key);
+}
+
+TEST(TestCBitVector, PopCountHammingRankSelect) {
+	const std::size_t bits = 20011;
+	CBitVector a, b;
+	a.Create(bits);
+	b.Create(bits);
+	for (std::size_t i = 0; i < bits; i++) {
+		a.SetBit(i, (i * 7919 % 13) < 5);
+		b.SetBit(i, (i * 104729 % 11) < 3);
+	}
+
+	simd_level_guard guard;
+	for (simd_level level : supported_simd_levels()) {
+		ASSERT_EQ(set_simd_level(level), level);
+		for (std::size_t pos : {0, 3, 8, 517, 4100}) {
+			for (std::size_t len : {0, 1, 5, 13, 64, 1000, 15000}) {
+				std::size_t ones = 0, diff = 0;
+				for (std::size_t i = pos; i < pos + len; i++) {
+					ones += a.GetBit(i);
+					diff += a.GetBit(i) != b.GetBit(i);
+				}
+				ASSERT_EQ(a.PopCount(pos, len), ones);
+				ASSERT_EQ(a.HammingDistance(b, pos, len), diff);
+			}
+		}
+	}
+
+	RankSelectIndex index(a, bits);
+	std::size_t rank = 0;
+	for (std::size_t i = 0; i < bits; i++) {
+		ASSERT_EQ(index.Rank(i), rank);
+		if (a.GetBit(i)) {
+			ASSERT_EQ(index.Select(rank), i);
+			rank++;
+		}
+	}
+	ASSERT_EQ(index.Rank(bits), rank);
+	ASSERT_EQ(index.GetOnes(), rank);
+	ASSERT_EQ(index.Select(rank), bits);
+}
+
+TEST(TestCBitVector, PackedElementBatches) {
+	const std::size_t n = 1000;
+	std::vector<uint32_t> values(n);
+	for (std::size_t i = 0; i < n; i++) {
+		values[i] = (uint32_t) (i * 2654435761u);
+	}
+
+	simd_level_guard guard;
+	for (simd_level level : supported_simd_levels()) {
+		ASSERT_EQ(set_simd_level(level), level);
+		for (std::size_t len : {1, 3, 8, 13, 17, 28, 29, 32}) {
+			uint32_t mask = len == 32 ? ~0u : (1u << len) - 1;
+			CBitVector v;
+			v.Create(n, len);
+			v.SetToOne();
+			v.SetElements(values.data() + 3, 5, n - 9);
+			for (std::size_t i = 0; i < n; i++) {
+				uint32_t expected = (i < 5 || i >= n - 4) ? mask : values[i - 2] & mask;
+				ASSERT_EQ(v.Get<uint32_t>(i), expected);
+			}
+			std::vector<uint32_t> out = v.GetElements<uint32_t>(5, n - 9);
+			for (std::size_t i = 0; i < n - 9; i++) {
+				ASSERT_EQ(out[i], values[i + 3] & mask);
+			}
+			if (len <= 16) {
+				std::vector<uint16_t> narrow = v.GetElements<uint16_t>(0, n);
+				for (std::size_t i = 0; i < n; i++) {
+					ASSERT_EQ(narrow[i], v.Get<uint16_t>(i));
+				}
+			}
+		}
+	}
+
+	// compile-time element length, unaligned first element
+	CBitVector v;
+	v.Create(n, 17);
+	v.SetElements<17>(values.data(), 3, n - 3);
+	std::vector<uint32_t> out = v.GetElements<17, uint32_t>(3, n - 3);
+	for (std::size_t i = 0; i < n - 3; i++) {
+		ASSERT_EQ(v.Get<uint32_t>(i + 3), values[i] & 0x1FFFF);
+		ASSERT_EQ(out[i], values[i] & 0x1FFFF);
+	}
+	std::vector<uint64_t> wide(n);
+	for (std::size_t i = 0; i < n; i++) {
+		wide[i] = values[i] * 0x9E3779B97F4A7C15ull;
+	}
+	v.Create(n, 61);
+	v.SetElements<61>(wide, 0);
+	std::vector<uint64_t> wideout(n);
+	v.GetElements<61>(wideout.data(), 0, n);
+	for (std::size_t i = 0; i < n; i++) {
+		ASSERT_EQ(wideout[i], wide[i] & ((1ull << 61) - 1));
+	}
+}
+
+TEST(TestCBitVector, ElementwiseArithmetic) {
+	const std::size_t n = 300;
+	simd_level_guard guard;
+	for (simd_level level : supported_simd_levels()) {
+		ASSERT_EQ(set_simd_level(level), level);
+		for (std::size_t len : {1, 7, 8, 16, 17, 32, 40, 64}) {
+			uint64_t mask = len == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << len) - 1;
+			CBitVector a, b, c;
+			a.Create(n, len);
+			b.Create(n, len);
+			c.Create(n, len);
+			std::vector<uint64_t> x(n), y(n);
+			for (std::size_t i = 0; i < n; i++) {
+				x[i] = (i + 1) * 0x9E3779B97F4A7C15ull & mask;
+				y[i] = (i + 7) * 0xC2B2AE3D27D4EB4Full & mask;
+			}
+			a.SetElements(x, 0);
+			b.SetElements(y, 0);
+
+			c.SetAdd(&a, &b);
+			for (std::size_t i = 0; i < n; i++) {
+				ASSERT_EQ(c.Get<uint64_t>(i), (x[i] + y[i]) & mask);
+			}
+			c.SetSub(&a, &b);
+			for (std::size_t i = 0; i < n; i++) {
+				ASSERT_EQ(c.Get<uint64_t>(i), (x[i] - y[i]) & mask);
+			}
+			c.SetMulScalar(&a, 0xDEADBEEFCAFEull);
+			for (std::size_t i = 0; i < n; i++) {
+				ASSERT_EQ(c.Get<uint64_t>(i), (x[i] * 0xDEADBEEFCAFEull) & mask);
+			}
+			a.Mul(&b);
+			for (std::size_t i = 0; i < n; i++) {
+				ASSERT_EQ(a.Get<uint64_t>(i), (x[i] * y[i]) & mask);
+			}
+		}
+	}
+}
+
+TEST(TestCBitVector, FusedBitwiseExpressions) {
+	const std::size_t bits = 8 * 10000 + 5;
+	uint8_t seed[AES_BYTES] = {4, 5, 6};
+	crypto c(128, seed);
+	CBitVector a(bits, &c), b(bits, &c), d(bits, &c), e(bits, &c);
+
+	auto expected = [&] (std::size_t i) -> BYTE {
+		return ((((a.GetByte(i) ^ b.GetByte(i)) & d.GetByte(i)) ^ e.GetByte(i)) | (BYTE) ~(a.GetByte(i) & e.GetByte(i)));
+	};
+	CBitVector r;
+	r = (((a ^ b) & d) ^ e) | ~(a & e);
+	ASSERT_EQ(r.GetSize(), a.GetSize());
+	for (std::size_t i = 0; i < r.GetSize(); i++) {
+		ASSERT_EQ(r.GetByte(i), expected(i));
+	}
+
+	// compound assignment and an expression that aliases the vector it is assigned to
+	CBitVector s;
+	s.Copy(a);
+	s ^= b & d;
+	s = e ^ (s | bit_operand(b.GetArr(), b.GetSize()));
+	for (std::size_t i = 0; i < s.GetSize(); i++) {
+		ASSERT_EQ(s.GetByte(i), (BYTE) (e.GetByte(i) ^ ((a.GetByte(i) ^ (b.GetByte(i) & d.GetByte(i))) | b.GetByte(i))));
+	}
+	// s is read after the first write, so the expression is evaluated in separate blocks
+	r.Copy(s);
+	s = (b & e) ^ s;
+	for (std::size_t i = 0; i < s.GetSize(); i++) {
+		ASSERT_EQ(s.GetByte(i), (BYTE) ((b.GetByte(i) & e.GetByte(i)) ^ r.GetByte(i)));
+	}
+}
+
+TEST(TestCBitVector, ExpressionsWithOverlappingViews) {
+	// views at an offset of the assigned bytes, over several blocks of the evaluation
+	const std::size_t nbytes = 3 * BIT_EXPR_BLOCK_BYTES + 100, len = nbytes - 1000;
+	uint8_t seed[AES_BYTES] = {7, 8, 9};
+	crypto c(128, seed);
+	CBitVector v(8 * nbytes, &c), w(8 * nbytes, &c), orig(8 * nbytes);
+	orig.Copy(v);
+
+	auto check = [&] (std::size_t dstpos, std::function<BYTE(std::size_t)> expected) {
+		for (std::size_t i = 0; i < nbytes; i++) {
+			BYTE b = (i >= dstpos && i < dstpos + len) ? expected(i - dstpos) : orig.GetByte(i);
+			ASSERT_EQ(v.GetByte(i), b) << "byte " << i;
+		}
+	};
+
+	// the operand starts after the assigned bytes
+	CBitVectorView(v, 0, 8 * len) ^= CBitVectorConstView(v, 8000, 8 * len) & CBitVectorConstView(w, 0, 8 * len);
+	check(0, [&] (std::size_t i) { return (BYTE) (orig.GetByte(i) ^ (orig.GetByte(1000 + i) & w.GetByte(i))); });
+
+	// the operand starts before the assigned bytes
+	v.Copy(orig);
+	CBitVectorView(v, 8000, 8 * len) ^= CBitVectorConstView(v, 0, 8 * len) & CBitVectorConstView(w, 0, 8 * len);
+	check(1000, [&] (std::size_t i) { return (BYTE) (orig.GetByte(1000 + i) ^ (orig.GetByte(i) & w.GetByte(i))); });
+
+	v.Copy(orig);
+	CBitVectorView(v, 8000, 8 * len).Assign(CBitVectorConstView(w, 0, 8 * len) | ~CBitVectorConstView(v, 0, 8 * len));
+	check(1000, [&] (std::size_t i) { return (BYTE) (w.GetByte(i) | (BYTE) ~orig.GetByte(i)); });
+
+	v.Copy(orig);
+	CBitVectorView(v, 800, 8 * len).Assign(CBitVectorConstView(v, 0, 8 * len) ^ CBitVectorConstView(v, 8000, 8 * len));
+	for (std::size_t i = 0; i < len; i++) {
+		ASSERT_EQ(v.GetByte(100 + i), (BYTE) (orig.GetByte(i) ^ orig.GetByte(1000 + i)));
+	}
+
+	// the vector is resized while a view of it is an operand
+	v.Copy(orig);
+	v = CBitVectorConstView(v, 8000, 8 * len) ^ CBitVectorConstView(w, 0, 8 * len);
+	ASSERT_EQ(v.GetSize(), len);
+	for (std::size_t i = 0; i < len; i++) {
+		ASSERT_EQ(v.GetByte(i), (BYTE) (orig.GetByte(1000 + i) ^ w.GetByte(i)));
+	}
+}
+
+TEST(TestCBitVector, ViewsSliceXorAndTranspose) {
+	const std::size_t bits = 8 * 1000;
+	uint8_t seed[AES_BYTES] = {7, 8, 9};
+	crypto c(128, seed);
+	CBitVector a(bits, &c), b(bits, &c), orig;
+	orig.Copy(a);
+
+	// slices at different bit offsets, bits outside of the view are left unchanged
+	CBitVectorView dst = CBitVectorView(a).Slice(3, 5000);
+	CBitVectorConstView src = CBitVectorConstView(b, 1000, 6000).Slice(11, 5000);
+	ASSERT_EQ(dst.GetOffset(), 3u);
+	ASSERT_EQ(src.GetOffset(), 3u);
+	dst.XOR(src);
+	for (std::size_t i = 0; i < bits; i++) {
+		BYTE expected = orig.GetBitNoMask(i);
+		if (i >= 3 && i < 5003) {
+			expected ^= b.GetBitNoMask(1011 + i - 3);
+		}
+		ASSERT_EQ(a.GetBitNoMask(i), expected);
+	}
+
+	CBitVectorConstView unaligned(b, 1, 5000);
+	a.Copy(orig);
+	dst.AND(unaligned);
+	for (std::size_t i = 0; i < bits; i++) {
+		BYTE expected = orig.GetBitNoMask(i);
+		if (i >= 3 && i < 5003) {
+			expected &= b.GetBitNoMask(i - 2);
+		}
+		ASSERT_EQ(a.GetBitNoMask(i), expected);
+	}
+	dst.AND(src);
+	dst.Copy(unaligned);
+	ASSERT_TRUE(dst.IsEqual(unaligned));
+	ASSERT_EQ(dst.PopCount(), unaligned.PopCount());
+	ASSERT_EQ(dst.Get<uint32_t>(100, 27), unaligned.Get<uint32_t>(100, 27));
+	dst.Invert();
+	ASSERT_EQ(dst.PopCount(), 5000 - unaligned.PopCount());
+	dst.Slice(10, 1).SetToOne();
+	ASSERT_EQ(a.GetBitNoMask(13), 1);
+	dst.Reset();
+	ASSERT_EQ(dst.PopCount(), 0u);
+	std::size_t outside = 0;
+	for (std::size_t i = 0; i < bits; i++) {
+		outside += (i < 3 || i >= 5003) ? orig.GetBitNoMask(i) : 0;
+	}
+	ASSERT_EQ(CBitVectorConstView(a).PopCount(), outside);
+
+	// transposing a block of rows in place and into another vector
+	CBitVector t(bits);
+	a.Copy(orig);
+	CBitVectorView(a, 1024, 64 * 64).Transpose(64);
+	CBitVectorConstView(orig, 1024, 64 * 64).TransposeTo(CBitVectorView(t, 0, 64 * 64), 64, 64);
+	ASSERT_TRUE(CBitVectorConstView(a, 1024, 64 * 64).IsEqual(CBitVectorConstView(t, 0, 64 * 64)));
+	for (std::size_t i = 0; i < 64; i++) {
+		for (std::size_t j = 0; j < 64; j++) {
+			ASSERT_EQ(t.GetBit(j * 64 + i), orig.GetBit(1024 + i * 64 + j));
+		}
+	}
+
+	// aligned views take part in expressions
+	a.Copy(orig);
+	CBitVectorView(a, 800, 1600) ^= CBitVectorConstView(b, 0, 1600) & CBitVectorConstView(orig, 3200, 1600);
+	for (std::size_t i = 0; i < 200; i++) {
+		ASSERT_EQ(a.GetByte(100 + i), (BYTE) (orig.GetByte(100 + i) ^ (b.GetByte(i) & orig.GetByte(400 + i))));
+	}
+	CBitVectorView(a, 0, 1600).Assign(~CBitVectorConstView(a, 0, 1600));
+	ASSERT_EQ(a.GetByte(5), (BYTE) ~orig.GetByte(5));
+}
+
+TEST(TestCBitVector, MappedFileStorage) {
+	char path[] = "/tmp/cbitvector_mapped_XXXXXX";
+	close(mkstemp(path));
+	const std::size_t bits = 1 << 20;
+	uint8_t seed[AES_BYTES] = {10, 11, 12};
+	crypto c(128, seed);
+	CBitVector expected(bits, &c);
+
+	// an offline phase writes two vectors, an online phase maps them back in the same order
+	{
+		MappedFileAllocator file(path, MappedFileAllocator::mode::create);
+		ASSERT_TRUE(file.IsOpen());
+		CBitVector a, b;
+		a.SetAllocator(&file);
+		b.SetAllocator(&file);
+		a.Create(bits);
+		b.Create(1000);
+		ASSERT_EQ(a.GetByte(1234), 0);
+		a.Copy(expected);
+		b.SetToOne();
+	}
+	{
+		MappedFileAllocator file(path, MappedFileAllocator::mode::open);
+		CBitVector a, b;
+		a.SetAllocator(&file);
+		b.SetAllocator(&file);
+		a.Create(bits);
+		b.Create(1000);
+		ASSERT_TRUE(a.IsEqual(expected));
+		ASSERT_EQ(b.PopCount(), b.GetSize() * 8);
+		a.Invert();
+	}
+	// private mappings see the file but do not change it
+	{
+		MappedFileAllocator file(path, MappedFileAllocator::mode::open_private);
+		CBitVector a;
+		a.SetAllocator(&file);
+		a.Create(bits);
+		ASSERT_EQ(a.GetByte(7), (BYTE) ~expected.GetByte(7));
+		a.Reset();
+		ASSERT_EQ(file.Allocate(1 << 30, false), nullptr);
+	}
+	{
+		MappedFileAllocator file(path, MappedFileAllocator::mode::open);
+		CBitVector a;
+		a.SetAllocator(&file);
+		a.Create(bits);
+		ASSERT_EQ(a.GetByte(7), (BYTE) ~expected.GetByte(7));
+	}
+	remove(path);
+	ASSERT_FALSE(MappedFileAllocator(path, MappedFileAllocator::mode::open).IsOpen());
+}
+
+TEST(TestCBitVector, ShiftsAndRotations) {
+	uint8_t seed[AES_BYTES] = {13, 14, 15};
+	crypto c(128, seed);
+	const std::size_t bits = 8 * 10000;
+	CBitVector orig(bits, &c), v;
+
+	// reference: bit i of the result is bit src(i) of orig or zero
+	auto check = [&] (std::size_t pos, std::size_t len, auto src) {
+		for (std::size_t i = 0; i < bits; i++) {
+			BYTE expected = orig.GetBitNoMask(i);
+			if (i >= pos && i < pos + len) {
+				long j = src(i - pos);
+				expected = j < 0 ? 0 : orig.GetBitNoMask(pos + j);
+			}
+			ASSERT_EQ(v.GetBitNoMask(i), expected);
+		}
+	};
+	for (std::size_t pos : {0, 3}) {
+		for (std::size_t len : {bits - pos, (std::size_t) 70001, (std::size_t) 13}) {
+			for (long k : {0L, 1L, 5L, 64L, 70L, 40000L, 69999L, 70001L, 100000L}) {
+				long l = len;
+				v.Copy(orig);
+				v.ShiftLeft(k, pos, len);
+				check(pos, len, [&] (long i) { return i - k; });
+				v.Copy(orig);
+				v.ShiftRight(k, pos, len);
+				check(pos, len, [&] (long i) { return i + k < l ? i + k : -1; });
+				v.Copy(orig);
+				v.RotateLeft(k, pos, len);
+				check(pos, len, [&] (long i) { return ((i - k) % l + l) % l; });
+				v.Copy(orig);
+				v.RotateRight(k, pos, len);
+				check(pos, len, [&] (long i) { return (i + k) % l; });
+			}
+		}
+	}
+
+	// whole vectors, rotating by a multiple of 8 moves bytes
+	v.Copy(orig);
+	v.CLShift(16);
+	for (std::size_t i = 0; i < v.GetSize(); i++) {
+		ASSERT_EQ(v.GetByte((i + 2) % v.GetSize()), orig.GetByte(i));
+	}
+	v.RotateRight(16);
+	ASSERT_TRUE(v.IsEqual(orig));
+	v.ShiftRight(bits - 1);
+	ASSERT_EQ(v.PopCount(), orig.GetBitNoMask(bits - 1));
+	v.ShiftLeft(bits);
+	ASSERT_EQ(v.PopCount(), 0u);
+}
+
+TEST(TestCBitVector, FixedSizeBitVectors) {
+	// constant expressions
+	constexpr FixedBitVector<128> one = {1}, mixed = {0xF0, 0x8000000000000000};
+	static_assert((one ^ mixed).PopCount() == 6, "");
+	static_assert((~one).PopCount() == 127 && (~FixedBitVector<70>()).PopCount() == 70, "");
+	static_assert(mixed.GetBitNoMask(127) == 1 && mixed.GetBit(3) == 1 && mixed.GetBit(7) == 0, "");
+	static_assert((one & mixed).IsZero() && (one | mixed) != mixed, "");
+
+	uint8_t seed[AES_BYTES] = {16, 17, 18};
+	crypto c(128, seed);
+	CBitVector rows(4 * 512 + 8, &c);
+
+	// rows at byte and bit offsets, and the run time vector operations against CBitVector
+	for (std::size_t pos : {0, 512, 1029}) {
+		FixedBitVector<256> a(rows, pos), b(rows, pos + 256);
+		FixedBitVector<512> w(rows, pos);
+		FixedBitVector<100> s(rows, pos + 3);
+		for (std::size_t i = 0; i < 256; i++) {
+			ASSERT_EQ(a.GetBitNoMask(i), rows.GetBitNoMask(pos + i));
+			ASSERT_EQ((a ^ b).GetBitNoMask(i), rows.GetBitNoMask(pos + i) ^ rows.GetBitNoMask(pos + 256 + i));
+			ASSERT_EQ((a & b).GetBitNoMask(i), rows.GetBitNoMask(pos + i) & rows.GetBitNoMask(pos + 256 + i));
+			ASSERT_EQ((~a | b).GetBitNoMask(i), (1 ^ rows.GetBitNoMask(pos + i)) | rows.GetBitNoMask(pos + 256 + i));
+			ASSERT_EQ(w.GetBitNoMask(i + 256), b.GetBitNoMask(i));
+		}
+		ASSERT_EQ(w.PopCount(), a.PopCount() + b.PopCount());
+		for (std::size_t i = 0; i < 100; i++) {
+			ASSERT_EQ(s.GetBitNoMask(i), rows.GetBitNoMask(pos + 3 + i));
+		}
+
+		CBitVector out(1024 + 16);
+		(a ^ b).Store(out, 7);
+		b.XORInto(out, 7);
+		ASSERT_EQ(FixedBitVector<256>(out, 7), a);
+		ASSERT_EQ(out.GetBitNoMask(6), 0);
+		ASSERT_EQ(out.GetBitNoMask(263), 0);
+	}
+
+	// blocks of crypto/Config.h
+	FixedBitVector<256> a(rows.GetArr());
+	FixedBitVector<128> lo(a.GetBlock(0)), hi(a.GetBlock(1));
+	ASSERT_EQ(memcmp(lo.GetArr(), rows.GetArr(), 16), 0);
+	ASSERT_EQ(memcmp(hi.GetArr(), rows.GetArr() + 16, 16), 0);
+	FixedBitVector<256> b;
+	b.SetBlock(1, lo.GetBlock(0));
+	b.SetBlock(0, hi.GetBlock(0));
+	BYTE bytes[32];
+	b.Store(bytes);
+	ASSERT_EQ(memcmp(bytes, rows.GetArr() + 16, 16), 0);
+	ASSERT_EQ(b.GetByte(16), rows.GetByte(0));
+}
+
+TEST(TestCBitVector, GF2MatrixProducts) {
+	uint8_t seed[AES_BYTES] = {19, 20, 21};
+	crypto c(128, seed);
+	auto random_matrix = [&] (std::size_t rows, std::size_t columns) {
+		GF2Matrix m(rows, columns);
+		CBitVector r(columns, &c);
+		for (std::size_t i = 0; i < rows; i++) {
+			r.FillRand(columns, &c);
+			m.Row(i).Copy(CBitVectorConstView(r, 0, columns));
+		}
+		return m;
+	};
+
+	for (std::size_t k : {1, 13, 200}) {
+		for (uint32_t nthreads : {1, 3}) {
+			GF2Matrix a = random_matrix(77, k), b = random_matrix(k, 1100), p;
+			p.SetProduct(a, b, nthreads);
+			ASSERT_EQ(p.GetRows(), 77u);
+			ASSERT_EQ(p.GetColumns(), 1100u);
+			for (std::size_t i = 0; i < p.GetRows(); i++) {
+				for (std::size_t j = 0; j < p.GetColumns(); j++) {
+					BYTE expected = 0;
+					for (std::size_t l = 0; l < k; l++) {
+						expected ^= a.GetBit(i, l) & b.GetBit(l, j);
+					}
+					ASSERT_EQ(p.GetBit(i, j), expected);
+				}
+				// padding bits stay zero
+				ASSERT_EQ(p.GetRow(i)[p.GetRowBytes() - 1], 0);
+			}
+
+			// products with vectors agree with the products of one-row and one-column matrices
+			CBitVector x(k, &c), y, z;
+			b.MultiplyVectorLeft(y, x, nthreads);
+			a.MultiplyVector(z, x, nthreads);
+			GF2Matrix xrow(1, k), xcol(k, 1);
+			xrow.Row(0).Copy(CBitVectorConstView(x, 0, k));
+			for (std::size_t l = 0; l < k; l++) {
+				xcol.SetBit(l, 0, x.GetBitNoMask(l));
+			}
+			GF2Matrix yrow, zcol;
+			yrow.SetProduct(xrow, b, nthreads);
+			zcol.SetProduct(a, xcol, nthreads);
+			ASSERT_TRUE(yrow.Row(0).IsEqual(CBitVectorConstView(y, 0, b.GetColumns())));
+			for (std::size_t i = 0; i < a.GetRows(); i++) {
+				ASSERT_EQ(z.GetBitNoMask(i), zcol.GetBit(i, 0));
+			}
+		}
+	}
+}
+
+TEST(TestCBitVector, SparseEncoder) {
+	uint8_t seed[AES_BYTES] = {22, 23, 24}, seed2[AES_BYTES] = {25};
+	crypto c(128, seed);
+	const std::size_t inlen = 5003, outlen = 20011;
+	CBitVector x(inlen, &c), rows(inlen * 16 * 8, &c);
+
+	for (std::size_t weight : {1, 7, 10}) {
+		SparseGF2Encoder enc(inlen, outlen, weight, &c, seed2);
+		CBitVector y, yrows;
+		enc.Encode(y, x, 1);
+		enc.EncodeRows(yrows, rows, 16, 1);
+		std::vector<uint32_t> pos(weight);
+		for (std::size_t j = 0; j < outlen; j++) {
+			enc.GetColumn(j, pos.data());
+			BYTE bit = 0;
+			uint64_t row[2] = {0, 0};
+			for (uint32_t p : pos) {
+				ASSERT_LT(p, inlen);
+				bit ^= x.GetBitNoMask(p);
+				row[0] ^= rows.Get<uint64_t>(p * 128, 64);
+				row[1] ^= rows.Get<uint64_t>(p * 128 + 64, 64);
+			}
+			ASSERT_EQ(y.GetBitNoMask(j), bit);
+			ASSERT_EQ(yrows.Get<uint64_t>(j * 128, 64), row[0]);
+			ASSERT_EQ(yrows.Get<uint64_t>(j * 128 + 64, 64), row[1]);
+		}
+
+		// the same seed gives the same map for any number of threads, y is linear in x
+		SparseGF2Encoder same(inlen, outlen, weight, &c, seed2);
+		CBitVector z, x2(inlen, &c), y2, sum;
+		same.Encode(z, x, 3);
+		ASSERT_TRUE(z.IsEqual(y));
+		same.EncodeRows(z, rows, 16, 0);
+		ASSERT_TRUE(z.IsEqual(yrows));
+		enc.Encode(y2, x2);
+		sum.Copy(x);
+		sum.XOR(&x2);
+		enc.Encode(z, sum);
+		z.XOR(&y);
+		ASSERT_TRUE(z.IsEqual(y2));
+	}
+}
+
+TEST(TestCBitVector, BitSliceAndUnslice) {
+	uint8_t seed[AES_BYTES] = {26, 27, 28};
+	crypto c(128, seed);
+	CBitVector src(64 * 3000, &c);
+	simd_level_guard guard;
+
+	for (simd_level level : supported_simd_levels()) {
+		ASSERT_EQ(set_simd_level(level), level);
+		for (std::size_t bitlen : {1, 5, 8, 31, 32, 64}) {
+			for (std::size_t n : {1, 63, 2048, 2999}) {
+				for (uint32_t nthreads : {1, 3}) {
+					CBitVector planes, back;
+					src.BitSlice(planes, bitlen, n, nthreads);
+					ASSERT_EQ(planes.GetSize(), (n * bitlen + 7) / 8);
+					for (std::size_t i = 0; i < n; i++) {
+						uint64_t e = src.Get<uint64_t>(i * bitlen, bitlen);
+						for (std::size_t b = 0; b < bitlen; b++) {
+							ASSERT_EQ(planes.GetBitNoMask(b * n + i), (e >> b) & 1) << bitlen << " " << n;
+						}
+					}
+					back.BitUnslice(planes, bitlen, n, nthreads);
+					ASSERT_EQ(back.GetSize(), (n * bitlen + 7) / 8);
+					for (std::size_t i = 0; i < n; i++) {
+						ASSERT_EQ(back.Get<uint64_t>(i * bitlen, bitlen), src.Get<uint64_t>(i * bitlen, bitlen));
+					}
+				}
+			}
+		}
+	}
+}
+
+TEST(TestCBitVector, XORSelectedRows) {
+	uint8_t seed[AES_BYTES] = {29, 30, 31};
+	crypto c(128, seed);
+	const std::size_t nsel = 5;
+	simd_level_guard guard;
+
+	for (simd_level level : supported_simd_levels()) {
+		ASSERT_EQ(set_simd_level(level), level);
+		for (std::size_t rowbytes : {1, 16, 45, 600}) {
+			for (std::size_t nrows : {1, 77, 5000}) {
+				CBitVector db(nrows * rowbytes * 8, &c), sel(nsel * nrows, &c), result;
+				// the first selection picks no row and the last one all rows
+				for (std::size_t i = 0; i < nrows; i++) {
+					sel.SetBitNoMask(i, 0);
+					sel.SetBitNoMask((nsel - 1) * nrows + i, 1);
+				}
+				for (uint32_t nthreads : {1, 3}) {
+					db.XORSelectedRows(result, rowbytes, nrows, sel, nsel, nthreads);
+					ASSERT_EQ(result.GetSize(), nsel * rowbytes);
+					for (std::size_t s = 0; s < nsel; s++) {
+						std::vector<BYTE> expected(rowbytes, 0);
+						for (std::size_t i = 0; i < nrows; i++) {
+							if (sel.GetBitNoMask(s * nrows + i)) {
+								// plain bytewise reference, xor_bytes is one of the kernels under test
+								for (std::size_t b = 0; b < rowbytes; b++) {
+									expected[b] ^= db.GetArr()[i * rowbytes + b];
+								}
+							}
+						}
+						ASSERT_EQ(std::vector<BYTE>(result.GetArr() + s * rowbytes, result.GetArr() + (s + 1) * rowbytes),
+								expected) << rowbytes << " " << nrows << " " << s;
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,575 @@
+#include <gtest/gtest.h>
+#include "ENCRYPTO_utils/cbitvector.h"
+#include "ENCRYPTO_utils/channel.h"
+#include "ENCRYPTO_utils/connection_pool.h"
+#include "ENCRYPTO_utils/constants.h"
+#include "ENCRYPTO_utils/crypto/record_layer.h"
+#include "ENCRYPTO_utils/rcvthread.h"
+#include "ENCRYPTO_utils/sndthread.h"
+#include "ENCRYPTO_utils/socket.h"
+#include "ENCRYPTO_utils/thread.h"
+#include <cstdlib>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+//Connect sock[0] and sock[1] via the loopback interface
+void connect_sockets(std::unique_ptr<CSocket> sock[2]) {
+	//GetPort() only knows the port of connected sockets, hence every connection binds the next fixed port
+	static uint16_t next_port = 17766;
+	uint16_t port = next_port++;
+	CSocket listen_socket;
+	EXPECT_TRUE(listen_socket.Bind("127.0.0.1", port));
+	EXPECT_TRUE(listen_socket.Listen());
+	std::thread client([&] {
+		sock[1] = std::make_unique<CSocket>();
+		EXPECT_TRUE(sock[1]->Connect("127.0.0.1", port));
+	});
+	sock[0] = listen_socket.Accept();
+	client.join();
+}
+
+//Both ends of a loopback connection with a send and a receive thread each
+struct loopback {
+	loopback(record_layer* rl0 = nullptr, record_layer* rl1 = nullptr) {
+		connect_sockets(sock);
+
+		record_layer* rl[2] = {rl0, rl1};
+		if(rl0 != nullptr && rl1 != nullptr) {
+			std::thread peer([&] {
+				EXPECT_TRUE(rl1->handshake(sock[1].get()));
+			});
+			EXPECT_TRUE(rl0->handshake(sock[0].get()));
+			peer.join();
+		}
+		for(int i = 0; i < 2; i++) {
+			lock[i] = std::make_unique<CLock>();
+			snd[i] = std::make_unique<SndThread>(sock[i].get(), lock[i].get());
+			rcv[i] = std::make_unique<RcvThread>(sock[i].get(), lock[i].get());
+			if(rl[i] != nullptr) {
+				snd[i]->set_record_layer(rl[i]);
+				rcv[i]->set_record_layer(rl[i]);
+			}
+		}
+	}
+
+	void start() {
+		for(int i = 0; i < 2; i++) {
+			snd[i]->Start();
+			rcv[i]->Start();
+		}
+	}
+
+	//Killing the send threads stops the receive threads of the other party
+	~loopback() {
+		snd[0].reset();
+		snd[1].reset();
+		rcv[0].reset();
+		rcv[1].reset();
+	}
+
+	std::unique_ptr<CSocket> sock[2];
+	std::unique_ptr<CLock> lock[2];
+	std::unique_ptr<SndThread> snd[2];
+	std::unique_ptr<RcvThread> rcv[2];
+};
+
+//Derive the keys of a connection between a and b without a socket
+void pair_up(record_layer& a, record_layer& b) {
+	ASSERT_TRUE(a.derive_keys(b.get_salt()));
+	ASSERT_TRUE(b.derive_keys(a.get_salt()));
+}
+
+std::vector<uint8_t> seal(record_layer& rl, uint8_t channelid, const std::vector<uint8_t>& msg) {
+	std::vector<uint8_t> sealed(msg.size() + RECORD_TAG_BYTES);
+	EXPECT_TRUE(rl.seal_init(channelid, msg.size()));
+	EXPECT_TRUE(rl.seal_update(msg.data(), sealed.data(), msg.size()));
+	EXPECT_TRUE(rl.seal_final(sealed.data() + msg.size()));
+	return sealed;
+}
+
+bool open(record_layer& rl, uint8_t channelid, std::vector<uint8_t> sealed, std::vector<uint8_t>* msg = nullptr) {
+	uint64_t nbytes = sealed.size() - RECORD_TAG_BYTES;
+	bool ok = rl.open(channelid, sealed.data(), nbytes, sealed.data() + nbytes);
+	if(msg != nullptr) {
+		msg->assign(sealed.begin(), sealed.begin() + nbytes);
+	}
+	return ok;
+}
+
+const uint8_t key0[AES_KEY_BYTES] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+const uint8_t key1[AES_KEY_BYTES] = {0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff};
+
+std::vector<uint8_t> test_message(size_t nbytes) {
+	std::vector<uint8_t> msg(nbytes);
+	for(size_t i = 0; i < nbytes; i++) {
+		msg[i] = (uint8_t) (i * 31 + 7);
+	}
+	return msg;
+}
+
+void fill_pattern(CBitVector& vec, std::size_t seed) {
+	for(std::size_t i = 0; i < vec.GetSize() * 8; i++) {
+		vec.SetBitNoMask(i, ((i * 7 + seed) % 5) < 2);
+	}
+}
+
+//Check that bits [dstpos, dstpos+bitlen) of dst equal bits [srcpos, srcpos+bitlen) of src and that all other bits of
+//dst still equal those of orig. Bits are numbered LSB first within a byte like in GetBits/SetBits.
+::testing::AssertionResult bits_received(const CBitVector& dst, const CBitVector& orig, std::size_t dstpos,
+		const CBitVector& src, std::size_t srcpos, std::size_t bitlen) {
+	for(std::size_t i = 0; i < dst.GetSize() * 8; i++) {
+		bool in_range = i >= dstpos && i < dstpos + bitlen;
+		BYTE expected = in_range ? src.GetBitNoMask(srcpos + i - dstpos) : orig.GetBitNoMask(i);
+		if(dst.GetBitNoMask(i) != expected) {
+			return ::testing::AssertionFailure() << "bit " << i << (in_range ? " (received)" : " (untouched)") << " differs";
+		}
+	}
+	return ::testing::AssertionSuccess();
+}
+
+uint64_t copied_bytes(const RcvThread& rcv) {
+	return rcv.get_local_copy_bytes() + rcv.get_remote_copy_bytes();
+}
+
+}
+
+
+TEST(TestRecordLayer, RoundTrip) {
+	record_layer a(key0, key1), b(key1, key0);
+	pair_up(a, b);
+	std::vector<uint8_t> msg = test_message(1000), rcved;
+
+	std::vector<uint8_t> sealed = seal(a, 3, msg);
+	ASSERT_NE(std::memcmp(sealed.data(), msg.data(), msg.size()), 0);
+	ASSERT_TRUE(open(b, 3, sealed, &rcved));
+	ASSERT_EQ(rcved, msg);
+
+	//the other direction uses the other key
+	ASSERT_TRUE(open(a, 5, seal(b, 5, msg), &rcved));
+	ASSERT_EQ(rcved, msg);
+
+	//empty messages still carry a tag
+	ASSERT_TRUE(open(b, 3, seal(a, 3, {})));
+}
+
+TEST(TestRecordLayer, RejectsTampering) {
+	std::vector<uint8_t> msg = test_message(100);
+	{
+		record_layer a(key0, key1), b(key1, key0);
+		pair_up(a, b);
+		std::vector<uint8_t> sealed = seal(a, 3, msg);
+		sealed[10] ^= 0x01;
+		ASSERT_FALSE(open(b, 3, sealed));
+	}
+	{
+		record_layer a(key0, key1), b(key1, key0);
+		pair_up(a, b);
+		std::vector<uint8_t> sealed = seal(a, 3, msg);
+		sealed.back() ^= 0x80;
+		ASSERT_FALSE(open(b, 3, sealed));
+	}
+	{
+		//the channel id is authenticated
+		record_layer a(key0, key1), b(key1, key0);
+		pair_up(a, b);
+		ASSERT_FALSE(open(b, 4, seal(a, 3, msg)));
+	}
+	{
+		//a party cannot open its own messages
+		record_layer a(key0, key1);
+		ASSERT_TRUE(a.derive_keys(a.get_salt()));
+		ASSERT_FALSE(open(a, 3, seal(a, 3, msg)));
+	}
+}
+
+TEST(TestRecordLayer, RejectsReplayAndReordering) {
+	std::vector<uint8_t> msg = test_message(64);
+	{
+		record_layer a(key0, key1), b(key1, key0);
+		pair_up(a, b);
+		std::vector<uint8_t> first = seal(a, 3, msg);
+		ASSERT_TRUE(open(b, 3, first));
+		ASSERT_FALSE(open(b, 3, first));
+	}
+	{
+		record_layer a(key0, key1), b(key1, key0);
+		pair_up(a, b);
+		std::vector<uint8_t> first = seal(a, 3, msg);
+		std::vector<uint8_t> second = seal(a, 3, msg);
+		ASSERT_FALSE(open(b, 3, second));
+	}
+}
+
+TEST(TestRecordLayer, FreshKeysPerConnection) {
+	//two connections with the same master keys use different keys, although both start with nonce 0
+	std::vector<uint8_t> msg = test_message(100);
+	record_layer a1(key0, key1), b1(key1, key0), a2(key0, key1), b2(key1, key0);
+	pair_up(a1, b1);
+	pair_up(a2, b2);
+	std::vector<uint8_t> sealed1 = seal(a1, 3, msg), sealed2 = seal(a2, 3, msg);
+	ASSERT_NE(sealed1, sealed2);
+	ASSERT_FALSE(open(b2, 3, sealed1));
+	ASSERT_TRUE(open(b1, 3, sealed1));
+}
+
+TEST(TestRecordLayer, LoopbackChannel) {
+	record_layer rl0(key0, key1), rl1(key1, key0);
+	loopback conn(&rl0, &rl1);
+	conn.start();
+	{
+		channel ch0(3, conn.rcv[0].get(), conn.snd[0].get());
+		channel ch1(3, conn.rcv[1].get(), conn.snd[1].get());
+		std::vector<uint8_t> msg = test_message(5000), rcved(msg.size());
+
+		ch0.send(msg.data(), msg.size());
+		ASSERT_TRUE(ch1.blocking_receive(rcved.data(), rcved.size()));
+		ASSERT_EQ(rcved, msg);
+
+		ch0.signal_end();
+		ch1.signal_end();
+		ch0.wait_for_fin();
+		ch1.wait_for_fin();
+	}
+	ASSERT_FALSE(conn.rcv[0]->has_failed());
+	ASSERT_FALSE(conn.rcv[1]->has_failed());
+	ASSERT_FALSE(conn.snd[0]->has_failed());
+	ASSERT_FALSE(conn.snd[1]->has_failed());
+}
+
+TEST(TestRecordLayer, AuthenticationFailureWakesReceivers) {
+	//the parties disagree on the key, so the first message fails to authenticate
+	record_layer rl0(key0, key1), rl1(key1, key1);
+	loopback conn(&rl0, &rl1);
+	conn.start();
+	channel ch0(3, conn.rcv[0].get(), conn.snd[0].get());
+	channel ch1(3, conn.rcv[1].get(), conn.snd[1].get());
+	channel other(4, conn.rcv[1].get(), conn.snd[1].get());
+
+	std::vector<uint8_t> msg = test_message(100), rcved(msg.size());
+	ch0.send(msg.data(), msg.size());
+	ASSERT_FALSE(ch1.blocking_receive(rcved.data(), rcved.size()));
+	ASSERT_TRUE(conn.rcv[1]->has_failed());
+	ASSERT_EQ(ch1.blocking_receive(), nullptr);
+
+	//listeners of other channels and those registered afterwards see the failure as well
+	other.wait_for_fin();
+	ASSERT_FALSE(other.is_alive());
+	channel late(5, conn.rcv[1].get(), conn.snd[1].get());
+	CBitVector vec(64);
+	ASSERT_FALSE(late.blocking_receive(vec, 0, 64));
+	late.wait_for_fin();
+}
+
+TEST(TestConnectionPool, BackToBackSessionsOnOneSlot) {
+	std::unique_ptr<CSocket> sock[2];
+	connect_sockets(sock);
+	//the other party is driven directly through its send thread, such that the data and fin of its next session
+	//on the slot deterministically arrive before this party closes the current session
+	//on destruction, the send thread of the peer has to stop before the pool waits for its receiver
+	CLock peer_lock;
+	RcvThread peer_rcv(sock[1].get(), &peer_lock);
+	std::vector<std::unique_ptr<CSocket>> pool_sockets;
+	pool_sockets.push_back(std::move(sock[0]));
+	auto pool = std::make_unique<ConnectionPool>(std::move(pool_sockets), 2);
+	auto peer_snd = std::make_unique<SndThread>(sock[1].get(), &peer_lock);
+	peer_snd->Start();
+	peer_rcv.Start();
+
+	//session ids 0 and get_max_sessions() share slot 0 with channels 0 and 1, session 1 uses channels 2 and 3
+	uint32_t next_id = pool->get_max_sessions();
+	std::unique_ptr<session> first = pool->open_session(0);
+	std::unique_ptr<session> marker = pool->open_session(1);
+	ASSERT_NE(first, nullptr);
+	ASSERT_NE(marker, nullptr);
+	ASSERT_EQ(pool->open_session(next_id), nullptr);
+
+	std::vector<uint8_t> dropped(100, 0xAA), kept(100, 0xBB), rcved(100);
+	peer_snd->add_snd_task(0, dropped.size(), dropped.data());
+	peer_snd->signal_end(0);
+	peer_snd->signal_end(1);
+	peer_snd->add_snd_task(0, kept.size(), kept.data());
+	peer_snd->signal_end(0);
+	peer_snd->signal_end(1);
+	//messages are processed in order, so everything above has arrived once the marker is received
+	peer_snd->add_snd_task(2, rcved.size(), kept.data());
+	peer_snd->signal_end(2);
+	peer_snd->signal_end(3);
+	ASSERT_TRUE(marker->get_channel(0)->blocking_receive(rcved.data(), rcved.size()));
+	marker->close();
+
+	//closing the first session drops its unread data but not the data of the next one
+	first->close();
+	std::unique_ptr<session> next = pool->open_session(next_id);
+	ASSERT_NE(next, nullptr);
+	ASSERT_TRUE(next->get_channel(0)->data_available());
+	ASSERT_TRUE(next->get_channel(0)->blocking_receive(rcved.data(), rcved.size()));
+	ASSERT_EQ(rcved, kept);
+	ASSERT_FALSE(next->get_channel(0)->data_available());
+	next->close();
+}
+
+TEST(TestConnectionPool, BackToBackSessions) {
+	std::unique_ptr<CSocket> sock[2];
+	connect_sockets(sock);
+	std::unique_ptr<ConnectionPool> pool[2];
+	for(int i = 0; i < 2; i++) {
+		std::vector<std::unique_ptr<CSocket>> pool_sockets;
+		pool_sockets.push_back(std::move(sock[i]));
+		pool[i] = std::make_unique<ConnectionPool>(std::move(pool_sockets), 2);
+	}
+	const uint32_t num_sessions = 20;
+	uint32_t stride = pool[0]->get_max_sessions();
+
+	//every session runs on slot 0, the receiving party reads only every other message
+	std::thread sender([&] {
+		for(uint32_t i = 0; i < num_sessions; i++) {
+			std::unique_ptr<session> s = pool[1]->open_session(i * stride);
+			ASSERT_NE(s, nullptr);
+			std::vector<uint8_t> msg(64, (uint8_t) i);
+			s->get_channel(0)->send(msg.data(), msg.size());
+			s->get_channel(1)->send(msg.data(), msg.size());
+			s->close();
+		}
+	});
+	for(uint32_t i = 0; i < num_sessions; i++) {
+		std::unique_ptr<session> s = pool[0]->open_session(i * stride);
+		ASSERT_NE(s, nullptr);
+		if(i % 2 == 0) {
+			std::vector<uint8_t> rcved(64);
+			ASSERT_TRUE(s->get_channel(1)->blocking_receive(rcved.data(), rcved.size()));
+			ASSERT_EQ(rcved, std::vector<uint8_t>(64, (uint8_t) i));
+		}
+		s->close();
+	}
+	sender.join();
+
+	//each pool waits for the other party to stop its receiver, like two processes would
+	std::thread teardown([&] { pool[1].reset(); });
+	pool[0].reset();
+	teardown.join();
+}
+
+TEST(TestConnectionPool, RecordLayer) {
+	//two connections, each with its own record layers from the same master keys
+	record_layer rl0a(key0, key1), rl0b(key0, key1), rl1a(key1, key0), rl1b(key1, key0);
+	std::vector<record_layer*> layers[2] = {{&rl0a, &rl0b}, {&rl1a, &rl1b}};
+	std::vector<std::unique_ptr<CSocket>> pool_sockets[2];
+	for(int i = 0; i < 2; i++) {
+		std::unique_ptr<CSocket> sock[2];
+		connect_sockets(sock);
+		pool_sockets[0].push_back(std::move(sock[0]));
+		pool_sockets[1].push_back(std::move(sock[1]));
+	}
+	//the handshakes of both parties run concurrently
+	std::unique_ptr<ConnectionPool> pool[2];
+	std::thread peer([&] { pool[1] = std::make_unique<ConnectionPool>(std::move(pool_sockets[1]), 2, layers[1]); });
+	pool[0] = std::make_unique<ConnectionPool>(std::move(pool_sockets[0]), 2, layers[0]);
+	peer.join();
+
+	//the sessions 0 and 1 use different connections
+	uint32_t second = pool[0]->get_max_sessions() / 2;
+	std::vector<uint8_t> msg = test_message(3000);
+	std::thread sender([&] {
+		for(uint32_t id : {0u, second}) {
+			std::unique_ptr<session> s = pool[1]->open_session(id);
+			ASSERT_NE(s, nullptr);
+			s->get_channel(1)->send(msg.data(), msg.size());
+			std::vector<uint8_t> rcved(msg.size());
+			ASSERT_TRUE(s->get_channel(0)->blocking_receive(rcved.data(), rcved.size()));
+			ASSERT_EQ(rcved, msg);
+			s->close();
+		}
+	});
+	for(uint32_t id : {0u, second}) {
+		std::unique_ptr<session> s = pool[0]->open_session(id);
+		ASSERT_NE(s, nullptr);
+		std::vector<uint8_t> rcved(msg.size());
+		ASSERT_TRUE(s->get_channel(1)->blocking_receive(rcved.data(), rcved.size()));
+		ASSERT_EQ(rcved, msg);
+		s->get_channel(0)->send(msg.data(), msg.size());
+		s->close();
+	}
+	sender.join();
+
+	std::thread teardown([&] { pool[1].reset(); });
+	pool[0].reset();
+	teardown.join();
+}
+
+TEST(TestChannel, BitVectorPostedReceive) {
+	loopback conn;
+	conn.start();
+	channel ch0(3, conn.rcv[0].get(), conn.snd[0].get());
+	channel ch1(3, conn.rcv[1].get(), conn.snd[1].get());
+	CBitVector src(512), dst(512), orig(512);
+	fill_pattern(src, 1);
+	fill_pattern(dst, 2);
+	fill_pattern(orig, 2);
+
+	//a buffer posted before the message arrives is written by the receiver thread without a copy
+	uint8_t* posted = dst.GetArr() + 8;
+	ASSERT_TRUE(conn.rcv[1]->post_receive(3, posted, 32));
+	ch0.send(src, 128, 256);
+	while(conn.rcv[1]->check_posted_receive(3) != RcvThread::posted_state::done) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	ASSERT_TRUE(bits_received(dst, orig, 64, src, 128, 256));
+	ASSERT_EQ(copied_bytes(*conn.rcv[1]), 0u);
+
+	//the same through the channel, whichever of the receiver and the message is first
+	orig.Copy(dst);
+	CEvent sent;
+	std::thread receiver([&] {
+		EXPECT_TRUE(ch1.blocking_receive(dst, 320, 128));
+	});
+	ch0.blocking_send(&sent, src, 0, 128);
+	receiver.join();
+	ASSERT_TRUE(bits_received(dst, orig, 320, src, 0, 128));
+
+	//a message that is already queued is copied out of its block
+	orig.Copy(dst);
+	ch0.send(src, 8, 64);
+	while(!ch1.data_available()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	uint64_t copied = copied_bytes(*conn.rcv[1]);
+	ASSERT_TRUE(ch1.blocking_receive(dst, 0, 64));
+	ASSERT_EQ(copied_bytes(*conn.rcv[1]), copied + 8);
+	ASSERT_TRUE(bits_received(dst, orig, 0, src, 8, 64));
+
+	ch0.signal_end();
+	ch1.signal_end();
+	ch0.wait_for_fin();
+	ch1.wait_for_fin();
+}
+
+TEST(TestChannel, BitVectorUnalignedReceive) {
+	loopback conn;
+	conn.start();
+	channel ch0(3, conn.rcv[0].get(), conn.snd[0].get());
+	channel ch1(3, conn.rcv[1].get(), conn.snd[1].get());
+	CBitVector src(512), dst(512), orig(512);
+	fill_pattern(src, 3);
+	fill_pattern(dst, 4);
+	fill_pattern(orig, 4);
+	CEvent sent;
+
+	//unaligned ranges are received into a temporary and written with SetBits, on both sides in any combination
+	ch0.send(src, 5, 101);
+	ASSERT_TRUE(ch1.blocking_receive(dst, 3, 101));
+	ASSERT_TRUE(bits_received(dst, orig, 3, src, 5, 101));
+
+	orig.Copy(dst);
+	ch0.blocking_send(&sent, src, 16, 77);
+	ASSERT_TRUE(ch1.blocking_receive(dst, 200, 77));
+	ASSERT_TRUE(bits_received(dst, orig, 200, src, 16, 77));
+
+	orig.Copy(dst);
+	ch0.blocking_send(&sent, src, 131, 64);
+	ASSERT_TRUE(ch1.blocking_receive(dst, 320, 64));
+	ASSERT_TRUE(bits_received(dst, orig, 320, src, 131, 64));
+
+	//a byte-aligned start with a partial last byte is copied bytewise and only the tail is masked
+	orig.Copy(dst);
+	ch0.send(src, 24, 45);
+	ASSERT_TRUE(ch1.blocking_receive(dst, 401, 45));
+	ASSERT_TRUE(bits_received(dst, orig, 401, src, 24, 45));
+
+	ch0.signal_end();
+	ch1.signal_end();
+	ch0.wait_for_fin();
+	ch1.wait_for_fin();
+}
+
+TEST(TestChannel, BitVectorReceiveSizeMismatch) {
+	loopback conn;
+	conn.start();
+	channel ch0(3, conn.rcv[0].get(), conn.snd[0].get());
+	channel ch1(3, conn.rcv[1].get(), conn.snd[1].get());
+	CBitVector src(512), dst(512), orig(512);
+	fill_pattern(src, 5);
+	fill_pattern(dst, 6);
+	fill_pattern(orig, 6);
+
+	//a message that does not fit the posted buffer cancels it and is queued instead
+	uint8_t* posted = dst.GetArr();
+	ASSERT_TRUE(conn.rcv[1]->post_receive(3, posted, 32));
+	ch0.send(src, 0, 128);
+	RcvThread::posted_state state;
+	while((state = conn.rcv[1]->check_posted_receive(3)) == RcvThread::posted_state::pending) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	ASSERT_EQ(state, RcvThread::posted_state::cancelled);
+	ASSERT_TRUE(ch1.blocking_receive(dst, 0, 128));
+	ASSERT_TRUE(bits_received(dst, orig, 0, src, 0, 128));
+
+	//a range that is sent in two messages is assembled from both, regardless of a posted buffer
+	orig.Copy(dst);
+	std::thread receiver([&] {
+		EXPECT_TRUE(ch1.blocking_receive(dst, 256, 256));
+	});
+	ch0.send(src, 0, 128);
+	ch0.send(src, 128, 128);
+	receiver.join();
+	ASSERT_TRUE(bits_received(dst, orig, 256, src, 0, 256));
+
+	//a message that is larger than the receive is split, the rest is kept for the next receive
+	orig.Copy(dst);
+	ch0.send(src, 256, 256);
+	ASSERT_TRUE(ch1.blocking_receive(dst, 0, 64));
+	ASSERT_TRUE(ch1.blocking_receive(dst, 64, 192));
+	ASSERT_TRUE(bits_received(dst, orig, 0, src, 256, 256));
+
+	ch0.signal_end();
+	ch1.signal_end();
+	ch0.wait_for_fin();
+	ch1.wait_for_fin();
+}
+
+TEST(TestChannel, CopyCounters) {
+	//pin the receiver threads to the node the test runs on, hence every copy is local
+	int node = CThread::CurrentNumaNode();
+	loopback conn;
+	for(int i = 0; i < 2; i++) {
+		if(node >= 0) {
+			ASSERT_TRUE(conn.rcv[i]->SetNumaNode(node));
+		}
+	}
+	conn.start();
+	channel ch0(3, conn.rcv[0].get(), conn.snd[0].get());
+	channel ch1(3, conn.rcv[1].get(), conn.snd[1].get());
+
+	//whole blocks, a block that is split over two receives and a receive that spans two blocks
+	std::vector<uint8_t> msg = test_message(3000), rcved(msg.size());
+	ch0.send(msg.data(), 1000);
+	ch0.send(msg.data() + 1000, 500);
+	ch0.send(msg.data() + 1500, 1500);
+	ASSERT_TRUE(ch1.blocking_receive(rcved.data(), 1000));
+	ASSERT_TRUE(ch1.blocking_receive(rcved.data() + 1000, 700));
+	ASSERT_TRUE(ch1.blocking_receive(rcved.data() + 1700, 1300));
+	ASSERT_EQ(rcved, msg);
+
+	//blocks that are handed out as they are were not copied
+	ch0.send(msg.data(), 100);
+	uint8_t* block = ch1.blocking_receive();
+	ASSERT_NE(block, nullptr);
+	free(block);
+
+	ASSERT_EQ(copied_bytes(*conn.rcv[1]), msg.size());
+	if(node >= 0) {
+		ASSERT_EQ(conn.rcv[1]->get_local_copy_bytes(), msg.size());
+		ASSERT_EQ(conn.rcv[1]->get_remote_copy_bytes(), 0u);
+	}
+	ASSERT_EQ(copied_bytes(*conn.rcv[0]), 0u);
+
+	ch0.signal_end();
+	ch1.signal_end();
+	ch0.wait_for_fin();
+	ch1.wait_for_fin();
+}
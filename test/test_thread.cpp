@@ -0,0 +1,220 @@
+#include <gtest/gtest.h>
+#include "ENCRYPTO_utils/thread.h"
+#include <atomic>
+#include <chrono>
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+//Records the placement that the thread observes for itself
+class placement_probe : public CThread {
+public:
+	~placement_probe() {
+		Wait();
+	}
+
+	std::vector<int> cpus;
+	int node = -1;
+	int page_node = -1;
+
+protected:
+	void ThreadMain() {
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		if(sched_getaffinity(0, sizeof(cpuset), &cpuset) == 0) {
+			for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+				if(CPU_ISSET(cpu, &cpuset)) {
+					cpus.push_back(cpu);
+				}
+			}
+		}
+		node = CurrentNumaNode();
+		//memory that the thread touches first is placed on its preferred node
+		std::vector<char> page(1 << 16, 1);
+		page_node = NumaNodeOfAddress(page.data());
+	}
+};
+
+std::vector<int> allowed_cpus() {
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	std::vector<int> cpus;
+	if(sched_getaffinity(0, sizeof(cpuset), &cpuset) == 0) {
+		for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if(CPU_ISSET(cpu, &cpuset)) {
+				cpus.push_back(cpu);
+			}
+		}
+	}
+	return cpus;
+}
+
+//Run func with spinning disabled, with the default spin count and with a large one
+template<typename F>
+void for_spin_counts(F func) {
+	uint32_t default_spin = CEvent::GetSpinCount();
+	for(uint32_t spin : {0u, default_spin, 4096u}) {
+		CEvent::SetSpinCount(spin);
+		func();
+	}
+	CEvent::SetSpinCount(default_spin);
+}
+
+void wait_until(const std::atomic<int>& counter, int value) {
+	while(counter.load() < value) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+}
+
+
+TEST(TestThread, SetAffinity) {
+	std::vector<int> allowed = allowed_cpus();
+	ASSERT_FALSE(allowed.empty());
+
+	//the placement is applied by the new thread and does not change the calling thread
+	placement_probe probe;
+	probe.SetAffinity({allowed.back()});
+	probe.Start();
+	probe.Wait();
+	ASSERT_EQ(probe.cpus, std::vector<int>({allowed.back()}));
+	ASSERT_EQ(allowed_cpus(), allowed);
+
+	placement_probe unpinned;
+	unpinned.Start();
+	unpinned.Wait();
+	ASSERT_EQ(unpinned.cpus, allowed);
+}
+
+TEST(TestThread, SetNumaNode) {
+	placement_probe missing;
+	ASSERT_FALSE(missing.SetNumaNode(1 << 20));
+	ASSERT_EQ(missing.GetNumaNode(), -1);
+
+	int node = CThread::CurrentNumaNode();
+	if(node < 0) {
+		GTEST_SKIP() << "the NUMA node of the CPU is unknown";
+	}
+	placement_probe probe;
+	ASSERT_TRUE(probe.SetNumaNode(node));
+	ASSERT_EQ(probe.GetNumaNode(), node);
+	probe.Start();
+	probe.Wait();
+	ASSERT_FALSE(probe.cpus.empty());
+	ASSERT_EQ(probe.node, node);
+	ASSERT_EQ(probe.page_node, node);
+}
+
+TEST(TestEvent, ManualResetWakesAll) {
+	for_spin_counts([] {
+		CEvent ev(true);
+		std::atomic<int> woken(0);
+		std::vector<std::thread> waiters;
+		for(int i = 0; i < 4; i++) {
+			waiters.emplace_back([&] {
+				ev.Wait();
+				woken++;
+			});
+		}
+		//let the waiters park
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		EXPECT_EQ(woken.load(), 0);
+		ev.Set();
+		for(auto& t : waiters) {
+			t.join();
+		}
+		ASSERT_EQ(woken.load(), 4);
+
+		//the event stays set until it is reset
+		ASSERT_TRUE(ev.IsSet());
+		ev.Wait();
+		ASSERT_TRUE(ev.IsSet());
+		ev.Reset();
+		ASSERT_FALSE(ev.IsSet());
+	});
+}
+
+TEST(TestEvent, AutoResetConsumesOnce) {
+	for_spin_counts([] {
+		CEvent ev;
+		ev.Set();
+		ev.Set();
+		ASSERT_TRUE(ev.IsSet());
+		ev.Wait();
+		ASSERT_FALSE(ev.IsSet());
+
+		CEvent initial(false, true);
+		initial.Wait();
+		ASSERT_FALSE(initial.IsSet());
+
+		//every Set() releases exactly one of the waiters
+		std::atomic<int> woken(0);
+		std::vector<std::thread> waiters;
+		for(int i = 0; i < 3; i++) {
+			waiters.emplace_back([&] {
+				ev.Wait();
+				woken++;
+			});
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		for(int i = 1; i <= 3; i++) {
+			ev.Set();
+			wait_until(woken, i);
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			EXPECT_EQ(woken.load(), i);
+			EXPECT_FALSE(ev.IsSet());
+		}
+		for(auto& t : waiters) {
+			t.join();
+		}
+	});
+}
+
+TEST(TestParallelFor, CoversRangeOnce) {
+	for(std::size_t n : {1u, 7u, 64u, 1000u}) {
+		for(std::size_t grain : {0u, 1u, 8u, 100u}) {
+			for(uint32_t nthreads : {0u, 1u, 3u, 8u}) {
+				std::vector<std::atomic<int>> hits(n);
+				ParallelFor(n, grain, nthreads, [&] (std::size_t begin, std::size_t end) {
+					ASSERT_LT(begin, end);
+					if(grain > 1) {
+						ASSERT_EQ(begin % grain, 0u);
+					}
+					for(std::size_t i = begin; i < end; i++) {
+						hits[i]++;
+					}
+				});
+				for(std::size_t i = 0; i < n; i++) {
+					ASSERT_EQ(hits[i].load(), 1) << "n " << n << " grain " << grain << " nthreads " << nthreads;
+				}
+			}
+		}
+	}
+}
+
+TEST(TestParallelFor, NestedAndConcurrentCalls) {
+	const std::size_t n = 256;
+	std::vector<std::atomic<int>> hits(n * n);
+	auto nested = [&] {
+		ParallelFor(n, 1, 4, [&] (std::size_t b0, std::size_t e0) {
+			for(std::size_t i = b0; i < e0; i++) {
+				ParallelFor(n, 16, 4, [&] (std::size_t b1, std::size_t e1) {
+					for(std::size_t j = b1; j < e1; j++) {
+						hits[i * n + j]++;
+					}
+				});
+			}
+		});
+	};
+	//the second caller finds the pool busy or idle, both has to work
+	std::thread other(nested);
+	nested();
+	other.join();
+	for(std::size_t i = 0; i < n * n; i++) {
+		ASSERT_EQ(hits[i].load(), 2);
+	}
+}